@@ -123,7 +123,7 @@ namespace couchdb
         void setViews(const std::vector<view_information> &views)
         {
             json::value obj;
-            for (auto v: views)
+            for (const auto &v: views)
                 obj[v.name] = v.to_json();
             return set_data("views", obj);
         }
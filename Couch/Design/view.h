@@ -22,6 +22,12 @@ namespace couchdb
             , documentName(documentName)
             , documentURL(documentURL)
         {}
+        view_result(json::value &&key, json::value &&value, const std::string &documentName, const std::string &documentURL)
+            : key(std::move(key))
+            , value(std::move(value))
+            , documentName(documentName)
+            , documentURL(documentURL)
+        {}
 
         json::value key;
         json::value value;
@@ -81,46 +87,57 @@ namespace couchdb
         std::string get_doc_revision() const {return revision;}
 
         // Runs the view with specified queries
-        view_results query(const view_queries &_queries) const
+        // Rows are parsed as they arrive if `parse_threads` is 1, or else on `parse_threads` threads at once
+        // once the whole response has arrived (on every hardware thread if it is 0), which suits very large results
+        view_results query(const view_queries &_queries, size_t parse_threads = 1) const
         {
-            std::string queryString;
-            for (view_query viewQuery: _queries)
-            {
-                std::string val;
-                if (viewQuery.value.is_string())
-                {
-                    if (viewQuery.useLiteralStrings)
-                        val = viewQuery.value.get_string();
-                    else
-                        val = "\"" + viewQuery.value.get_string() + "\"";
-                }
-                else
-                    val = json_to_string(viewQuery.value);
+            return query(query_string(_queries), parse_threads);
+        }
 
-                if (!queryString.empty())
-                    queryString += "&";
+        // Runs the view with the specified single query
+        // `parse_threads` is as for query(const view_queries &, size_t)
+        view_results query(const view_query &viewQuery, size_t parse_threads = 1) const
+        {
+            return query(query_string(view_queries(1, viewQuery)), parse_threads);
+        }
 
-                queryString += url_encode(viewQuery.key) + "=" + url_encode(val);
-            }
+        // Runs the view with specified queries, keeping only the document id and the parts of each row selected by `fields`
+        // The pointers in `fields` are relative to the row, such as "/key" or "/value/rev", and the rest of each row is skipped as it arrives
+        view_results query(const view_queries &_queries, const json::projection &fields) const
+        {
+            json::projection row_fields(fields);
+            row_fields.add("/id");
 
-            return query(queryString);
+            return query(query_string(_queries), 1, row_fields);
         }
 
-        // Runs the view with the specified single query
-        view_results query(const view_query &viewQuery) const
+        // Starts running the view with specified queries, and passes the results to `handler`
+        // See communication::request_async() for when and where `handler` is called
+        void query_async(const view_queries &_queries, const async_handler<view_results> &handler) const
         {
-            std::string val;
-            if (viewQuery.value.is_string())
+            const std::string db_url = get_db_url();
+            const std::shared_ptr<base> keep_alive = comm;
+
+            comm->request_async(get_query_path(query_string(_queries)), "GET", "", typename base::header_map(),
+                                [db_url, keep_alive](std::string &body)
             {
-                if (viewQuery.useLiteralStrings)
-                    val = viewQuery.value.get_string();
-                else
-                    val = "\"" + viewQuery.value.get_string() + "\"";
-            }
-            else
-                val = json_to_string(viewQuery.value);
+                view_results results;
+                const json::value response = string_to_json_rows(body.data(), body.size(), [&](json::value &row)
+                {
+                    return add_result(results, row, db_url);
+                });
+
+                if (!response.is_object() || !response["rows"].is_array())
+                    throw error(error::view_unavailable);
 
-            return query(url_encode(viewQuery.key) + "=" + url_encode(val));
+                return results;
+            }, handler);
+        }
+
+        // Starts running the view with specified queries, and returns a future for the results
+        std::future<view_results> query_async(const view_queries &_queries = view_queries()) const
+        {
+            return async_future<view_results>([&](const async_handler<view_results> &handler) {query_async(_queries, handler);});
         }
 
         // Returns the URL of the CouchDB server
@@ -155,38 +172,86 @@ namespace couchdb
         }
 
     protected:
-        view_results query(const std::string &queries) const
+        static std::string query_string(const view_queries &_queries)
         {
-            json::value response;
-            view_results results;
-            std::string url = "/" + url_encode(db) + "/" + url_encode_doc_id(document) + "/" + url_encode_view_id(id);
+            std::string queryString;
+            for (const view_query &viewQuery: _queries)
+            {
+                std::string val;
+                if (viewQuery.value.is_string())
+                {
+                    if (viewQuery.useLiteralStrings)
+                        val = viewQuery.value.get_string();
+                    else
+                        val = "\"" + viewQuery.value.get_string() + "\"";
+                }
+                else
+                    val = json_to_string(viewQuery.value);
 
-            if (revision.size() > 0)
-                url += "?rev=" + url_encode(revision);
+                if (!queryString.empty())
+                    queryString += "&";
 
-            if (queries.size() > 0)
-                url = add_url_query(url, queries);
+                queryString += url_encode(viewQuery.key) + "=" + url_encode(val);
+            }
 
-            response = comm->get_data(url);
-            if (!response.is_object())
-                throw error(error::view_unavailable);
+            return queryString;
+        }
 
-            response = response["rows"];
-            if (!response.is_array())
-                throw error(error::view_unavailable);
+        view_results query(const std::string &queries, size_t parse_threads, const json::projection &fields = json::projection()) const
+        {
+            view_results results;
+            const std::string url = get_query_path(queries), db_url = get_db_url();
 
-            for (json::value val: response)
+            auto add_row = [&](json::value &row) -> bool {return add_result(results, row, db_url);};
+
+            if (parse_threads != 1)
             {
-                if (val.is_object())
-                    results.push_back(view_result(val["key"],
-                                                  val["value"],
-                                                  val["id"].get_string(),
-                                                  get_db_url() + "/" + val["id"].get_string()));
+                json::value response = comm->get_rows_parallel(url, parse_threads);
+                if (!response.is_object() || !response["rows"].is_array())
+                    throw error(error::view_unavailable);
+
+                json::array_t &rows = response["rows"].get_array();
+                results.reserve(rows.size());
+                for (json::value &row: rows)
+                    add_row(row);
+
+                return results;
             }
 
+            // Rows are moved into the results as they are parsed, rather than building the whole response first
+            const json::value response = comm->get_rows(url, add_row, "GET", "", false, fields);
+
+            if (!response.is_object() || !response["rows"].is_array())
+                throw error(error::view_unavailable);
+
             return results;
         }
 
+        // Returns the path to run the view with a query string
+        std::string get_query_path(const std::string &queries) const
+        {
+            std::string url = getURL(true);
+
+            if (queries.size() > 0)
+                url = add_url_query(url, queries);
+
+            return url;
+        }
+
+        // Moves a row of the view into `results`, for a view of the database at `db_url`
+        static bool add_result(view_results &results, json::value &row, const std::string &db_url)
+        {
+            if (row.is_object())
+            {
+                const std::string &id = row["id"].get_string();
+                results.push_back(view_result(std::move(row["key"]),
+                                              std::move(row["value"]),
+                                              id,
+                                              db_url + "/" + id));
+            }
+            return true;
+        }
+
         std::string getURL(bool withRevision) const
         {
             std::string url = "/" + url_encode(db) + "/" + url_encode_doc_id(document) + "/" + url_encode_view_id(id);
@@ -62,29 +62,22 @@ namespace couchdb
         // Returns the data contained in this attachment
         virtual std::string get_data() const
         {
-            std::string data;
-            std::string url = "/" + url_encode(db_) + "/" + url_encode_doc_id(document_) + "/" + url_encode(id_);
-
-            if (revision_.size() > 0)
-                url += "?rev=" + url_encode(revision_);
-
-            data = comm_->get_raw_data(url);
-
-            if (data.size() > 0 && data[0] == '{')
-            {
-                // check to make sure we did not receive an error
-                json::value doc = string_to_json(data);
+            return checked_data(comm_->get_raw_data(get_data_path()));
+        }
 
-                if (doc.is_object() && doc.is_member("error") && doc.is_member("reason"))
-                {
-#ifdef CPPCOUCH_DEBUG
-                    std::cout << "Could not retrieve data for attachment \"" + id_ + "\": " + doc["reason"].get_string();
-#endif
-                    throw error(error::attachment_unavailable, doc["reason"].get_string());
-                }
-            }
+        // Starts reading the data contained in this attachment, and passes the data to `handler`
+        // See communication::request_async() for when and where `handler` is called
+        virtual void get_data_async(const async_handler<std::string> &handler) const
+        {
+            const attachment self(*this);
+            comm_->request_async(get_data_path(), "GET", "", typename base::header_map(),
+                                 [self](std::string &body) {return self.checked_data(std::move(body));}, handler);
+        }
 
-            return data;
+        // Starts reading the data contained in this attachment, and returns a future for the data
+        std::future<std::string> get_data_async() const
+        {
+            return async_future<std::string>([&](const async_handler<std::string> &handler) {get_data_async(handler);});
         }
 
         // Sets the data contained in this attachment
@@ -160,6 +153,37 @@ namespace couchdb
             return url;
         }
 
+        // Returns the path to read the data of this attachment from
+        std::string get_data_path() const
+        {
+            std::string url = "/" + url_encode(db_) + "/" + url_encode_doc_id(document_) + "/" + url_encode(id_);
+
+            if (revision_.size() > 0)
+                url += "?rev=" + url_encode(revision_);
+
+            return url;
+        }
+
+        // Returns the data of this attachment as read, or throws if it is an error response
+        std::string checked_data(std::string data) const
+        {
+            if (data.size() > 0 && data[0] == '{')
+            {
+                // check to make sure we did not receive an error
+                json::value doc = string_to_json(data);
+
+                if (doc.is_object() && doc.is_member("error") && doc.is_member("reason"))
+                {
+#ifdef CPPCOUCH_DEBUG
+                    std::cout << "Could not retrieve data for attachment \"" + id_ + "\": " + doc["reason"].get_string();
+#endif
+                    throw error(error::attachment_unavailable, doc["reason"].get_string());
+                }
+            }
+
+            return data;
+        }
+
     private:
         std::shared_ptr<base> comm_;
         std::string db_;
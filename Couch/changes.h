@@ -34,6 +34,9 @@ namespace couchdb
 
         virtual void changes_feed_opened() {}
         virtual void change_occured(const json::value &change) = 0;
+        // Fires instead of change_occured() for changes with the usual layout (see change_row in responses.h),
+        // so a subclass can handle them without a JSON value. By default, the change is converted and passed to change_occured()
+        virtual void change_row_occured(const change_row &change) {change_occured(change.to_json());}
         virtual void changes_feed_closed() {}
 
         bool try_lock() {return mutex_.try_lock();}
@@ -203,8 +206,14 @@ namespace couchdb
 
             if (!line.empty())
             {
+                change_row change;
+                const bool decoded = decode_change(line.data(), line.size(), change);
+
                 std::lock_guard<std::mutex> lock(signaller.mutex());
-                signaller.change_occured(string_to_json(line));
+                if (decoded)
+                    signaller.change_row_occured(change);
+                else
+                    signaller.change_occured(string_to_json(line));
             }
         }
 
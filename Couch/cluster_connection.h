@@ -107,11 +107,11 @@ namespace couchdb
             if (!response.is_object())
                 throw error(error::bad_response);
 
-            response = response["all_nodes"];
+            response = std::move(response["all_nodes"]);
             if (!response.is_array())
                 throw error(error::bad_response);
 
-            for (auto n: response.get_array())
+            for (const json::value &n: response.get_array())
                 result.push_back(n.get_string());
 
             return result;
@@ -125,11 +125,11 @@ namespace couchdb
             if (!response.is_object())
                 throw error(error::bad_response);
 
-            response = response["all_nodes"];
+            response = std::move(response["all_nodes"]);
             if (!response.is_array())
                 throw error(error::bad_response);
 
-            for (auto n: response.get_array())
+            for (const json::value &n: response.get_array())
                 result.push_back(std::make_shared<node_type>(node_type(this->node_local_port_, n.get_string(), this->comm)));
 
             return result;
@@ -143,11 +143,11 @@ namespace couchdb
             if (!response.is_object())
                 throw error(error::bad_response);
 
-            response = response["cluster_nodes"];
+            response = std::move(response["cluster_nodes"]);
             if (!response.is_array())
                 throw error(error::bad_response);
 
-            for (auto n: response.get_array())
+            for (const json::value &n: response.get_array())
                 result.push_back(n.get_string());
 
             return result;
@@ -161,11 +161,11 @@ namespace couchdb
             if (!response.is_object())
                 throw error(error::bad_response);
 
-            response = response["cluster_nodes"];
+            response = std::move(response["cluster_nodes"]);
             if (!response.is_array())
                 throw error(error::bad_response);
 
-            for (auto n: response.get_array())
+            for (const json::value &n: response.get_array())
                 result.push_back(std::make_shared<node_type>(node_type(this->node_local_port_, n.get_string(), this->comm)));
 
             return result;
@@ -4,8 +4,13 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <functional>
+#include <utility>
+#include <exception>
 
 #include "shared.h"
+#include "responses.h"
 #include "user.h"
 
 #define CPPCOUCH_DEFAULT_URL "http://localhost:5984"
@@ -21,6 +26,12 @@ namespace couchdb
      * not generally used by anything other than the API itself.
      *
      * This class handles the HTTP network requests sent to CouchDB, as well as errors.
+     *
+     * A communication object may be shared by several threads, which can make requests through it at once.
+     * Every request has its own response buffer, and takes a copy of the settings (server URL, credentials,
+     * session cookie, etc.) when it starts, under a lock that is released before the request is sent.
+     * The session cookie is updated under the same lock, and cached responses are kept in a sharded
+     * response_cache. The http_client must then also allow requests from several threads at once.
      */
 
     inline std::string local() {return CPPCOUCH_DEFAULT_URL;}
@@ -43,6 +54,7 @@ namespace couchdb
 
         typedef std::map<std::string, std::string> header_map;
 
+        // The settings requests are made with
         class state
         {
             friend class communication;
@@ -69,24 +81,64 @@ namespace couchdb
             {}
 
         private:
-            void set_url(const std::string &url)
-            {
-                if (url == url_)
-                    return;
-
-                cached_responses_.clear();
-            }
-
             http_client_timeout_duration_t timeout_;
             http_client_timeout_mode_t timeout_mode_;
             std::string url_;
-            std::string buffer_;
 
             user user_;
             auth_type auth_type_;
             std::string cookie_;
+        };
+
+        /* response_cache class - Raw responses of cacheable requests, by full URL.
+         *
+         * The URLs are split between shards with a lock each, so threads looking up different URLs
+         * rarely wait for each other. Bodies are shared, so a lookup only copies a pointer while the lock is held.
+         */
+        class response_cache
+        {
+        public:
+            typedef std::shared_ptr<const std::string> body_type;
+
+            // Returns the cached body for `url`, or null if there is none
+            body_type find(const std::string &url) const
+            {
+                const shard &s = shard_for(url);
+                std::lock_guard<std::mutex> lock(s.mutex);
+
+                auto it = s.responses.find(url);
+                return it != s.responses.end()? it->second: body_type();
+            }
+
+            void insert(const std::string &url, const body_type &body)
+            {
+                shard &s = shard_for(url);
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.responses[url] = body;
+            }
+
+            void clear()
+            {
+                for (shard &s: shards_)
+                {
+                    std::lock_guard<std::mutex> lock(s.mutex);
+                    s.responses.clear();
+                }
+            }
+
+        private:
+            static const size_t shard_count = 16;
+
+            struct shard
+            {
+                mutable std::mutex mutex;
+                std::map<std::string, body_type> responses;
+            };
+
+            const shard &shard_for(const std::string &url) const {return shards_[std::hash<std::string>()(url) % shard_count];}
+            shard &shard_for(const std::string &url) {return shards_[std::hash<std::string>()(url) % shard_count];}
 
-            std::map<std::string, std::string> cached_responses_; // Map of URL -> raw responses
+            shard shards_[shard_count];
         };
 
         communication(http_client _network = http_client(), const std::string &url = std::string(), const user &_user = user(), auth_type auth = auth_none, http_client_timeout_duration_t timeout = http_client_timeout_duration_t())
@@ -97,8 +149,16 @@ namespace couchdb
 
         // Save and restore the current state
         // State objects are not modifiable except by this class
-        const state &get_current_state() const {return d;}
-        void set_current_state(const state &_state) {d = _state;}
+        state get_current_state() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return d;
+        }
+        void set_current_state(const state &_state)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            d = _state;
+        }
 
         json::value get_data(const std::string &url, const std::string &method = "GET",
                            const std::string &data = "", bool cacheable = false)
@@ -113,10 +173,120 @@ namespace couchdb
             return get_data(url, method, data, headers, cacheable);
         }
 
+#ifdef JSON_PMR
+        // Parses the response into `resource` (for example, a std::pmr::monotonic_buffer_resource tied to the request)
+        // The resource must outlive the returned value
+        json::value get_data(json::memory_resource *resource, const std::string &url, const std::string &method = "GET",
+                           const std::string &data = "", const header_map &headers = header_map(), bool cacheable = false)
+        {
+            std::string body;
+            get_raw_data(body, url, method, data, headers, cacheable);
+            return string_to_json(body.data(), body.size(), resource);
+        }
+#endif
+
+        // Like get_data(), but parses in borrowed mode, so strings in the response refer into the response body
+        // instead of being copied. The body is kept alive by the returned value
+        json::borrowed_value get_borrowed_data(const std::string &url, const std::string &method = "GET",
+                                               const std::string &data = "", bool cacheable = false)
+        {
+            std::shared_ptr<std::string> body = std::make_shared<std::string>();
+            get_raw_data(*body, url, method, data, header_map(), cacheable);
+            return string_to_borrowed_json(body);
+        }
+
+        // Like get_data(), but only indexes the response, and decodes its members when they are read
+        // Suited to responses of which only a few members are needed. The body is kept alive by the returned value
+        json::lazy_value get_lazy_data(const std::string &url, const std::string &method = "GET",
+                                       const std::string &data = "", bool cacheable = false)
+        {
+            std::shared_ptr<std::string> body = std::make_shared<std::string>();
+            get_raw_data(*body, url, method, data, header_map(), cacheable);
+            return string_to_lazy_json(body);
+        }
+
+        // Like get_data(), but first tries `decode` (one of the fixed-layout decoders in responses.h) on the response,
+        // which fills in `decoded` without building a JSON value
+        // Returns true if it succeeded. Otherwise the response did not have the expected layout,
+        // so it is parsed generically into `fallback` instead, and `decoded` is reset
+        template<typename T>
+        bool get_decoded_data(const std::string &url, bool (*decode)(const char *, size_t, T &), T &decoded, json::value &fallback,
+                              const std::string &method = "GET", const std::string &data = "", bool cacheable = false)
+        {
+            std::string body;
+            get_raw_data(body, url, method, data, header_map(), cacheable);
+            return decode_body(body, decode, decoded, fallback);
+        }
+
+        // Tries `decode` on a response body, as get_decoded_data() does
+        template<typename T>
+        static bool decode_body(const std::string &body, bool (*decode)(const char *, size_t, T &), T &decoded, json::value &fallback)
+        {
+            if (decode(body.data(), body.size(), decoded))
+                return true;
+
+            decoded = T();
+            fallback = string_to_json(body);
+            return false;
+        }
+
+#ifdef CPPCOUCH_TYPED_DOCUMENTS
+        // Like get_data(), but reads the response straight into `result`, a struct described with JSON_MAPPING
+        // Returns false if the response is not valid JSON or does not match the mapping, and throws error::bad_response if it is not valid UTF-8
+        template<typename T>
+        bool get_typed_data(const std::string &url, T &result, const std::string &method = "GET",
+                            const std::string &data = "", bool cacheable = false)
+        {
+            std::string body;
+            get_raw_data(body, url, method, data, header_map(), cacheable);
+
+            try {json::from_json_typed(body, result, validate_response_utf8);}
+            catch (const json::utf8_error &) {throw invalid_utf8_response();}
+            catch (json::error) {return false;}
+
+            return true;
+        }
+#endif
+
+        // Like get_data(), but parses the elements of the response's "rows" array on `threads` threads at once
+        // (or one per hardware thread if `threads` is zero), once the whole response has arrived
+        // Suited to very large view results and '/_all_docs' listings
+        json::value get_rows_parallel(const std::string &url, size_t threads, const std::string &method = "GET",
+                                      const std::string &data = "", bool cacheable = false)
+        {
+            std::string body;
+            get_raw_data(body, url, method, data, header_map(), cacheable);
+            return string_to_json_parallel(body.data(), body.size(), threads);
+        }
+
+        // Like get_data(), but passes each element of the response's "rows" array to `callback` as it is parsed,
+        // so the whole response is never built at once
+        // Returns the response without its rows
+        // Unless the response is cacheable, the rows are parsed as the response arrives from the network
+        // If `fields` is not empty, only the parts of each row it selects are built
+        json::value get_rows(const std::string &url, const json::rows_handler::callback_type &callback,
+                             const std::string &method = "GET", const std::string &data = "", bool cacheable = false,
+                             const json::projection &fields = json::projection())
+        {
+            if (cacheable)
+            {
+                std::string body;
+                get_raw_data(body, url, method, data, header_map(), cacheable);
+                return string_to_json_rows(body.data(), body.size(), callback, fields);
+            }
+
+            json::rows_handler handler(callback, fields);
+            if (!get_streamed_data(url, method, data, header_map(), handler))
+                return json::value();
+
+            return std::move(handler.header());
+        }
+
         std::string get_raw_data(const std::string &url, const std::string &method = "GET", const header_map &headers = header_map(), const std::string &data = "", bool cacheable = false)
         {
-            get_raw_data(url, method, data, headers, cacheable);
-            return d.buffer_;
+            std::string body;
+            get_raw_data(body, url, method, data, headers, cacheable);
+            return body;
         }
 
         http_client_response_handle_t get_raw_data_response(const std::string &url, const std::string &method = "GET", const header_map &headers = header_map(), const std::string &data = "")
@@ -124,33 +294,91 @@ namespace couchdb
             return get_raw_data_response(url, method, data, headers);
         }
 
+        // Starts a request and returns at once. When it completes, `convert` is called with the response body (a std::string
+        // it may take), and `handler` with an async_result holding what `convert` returned, or the exception that the request
+        // or `convert` failed with
+        // Both are called on the thread that completes the request, which is the event loop of the http_client if it has one,
+        // so they must not block. This object must outlive the request. Responses are not cached
+        template<typename Convert, typename Handler>
+        void request_async(const std::string &url, const std::string &method, const std::string &data,
+                           const header_map &headers, Convert convert, Handler handler)
+        {
+            typedef decltype(convert(std::declval<std::string &>())) result_type;
+
+            const state s = get_current_state();
+            const std::string full_url = s.url_ + url;
+
+#ifdef CPPCOUCH_DEBUG
+            std::cout << "Starting request: " << full_url << " [" << method << "]" << std::endl;
+#endif
+#ifdef CPPCOUCH_FULL_DEBUG
+            std::cout << "Sending buffer: " << data << std::endl;
+#endif
+
+            client.async_request(full_url, s.timeout_, s.timeout_mode_, request_headers(data, headers, s), method, data,
+                                 [this, full_url, method, convert, handler](int statusCode,
+                                                                            header_map &response_headers,
+                                                                            std::string &body,
+                                                                            bool statusCodeError,
+                                                                            const std::string &errorDescription)
+            {
+#ifdef CPPCOUCH_DEBUG
+                std::cout << method << " " << full_url << " response: " << statusCode << std::endl;
+#endif
+                handler(capture_async_result<result_type>([&]() -> result_type
+                {
+                    process_response(full_url, method, statusCode, statusCodeError, errorDescription, body, response_headers);
+                    return convert(body);
+                }));
+            });
+        }
+
+        // Starts a request for JSON data, and passes the parsed response to `handler` as request_async() does
+        void get_data_async(const std::string &url, const std::string &method, const std::string &data,
+                            const header_map &headers, const async_handler<json::value> &handler)
+        {
+            request_async(url, method, data, headers, [](std::string &body) {return string_to_json(body);}, handler);
+        }
+
+        // Starts a request for JSON data, and returns a future for the parsed response
+        std::future<json::value> get_data_async(const std::string &url, const std::string &method = "GET",
+                                                const std::string &data = "", const header_map &headers = header_map())
+        {
+            return async_future<json::value>([&](const async_handler<json::value> &handler)
+            {
+                get_data_async(url, method, data, headers, handler);
+            });
+        }
+
         // Timeout in milliseconds
-        http_client_timeout_duration_t get_timeout() const {return d.timeout_;}
-        void set_timeout(http_client_timeout_duration_t timeout) {d.timeout_ = timeout;}
+        http_client_timeout_duration_t get_timeout() const {std::lock_guard<std::mutex> lock(mutex_); return d.timeout_;}
+        void set_timeout(http_client_timeout_duration_t timeout) {std::lock_guard<std::mutex> lock(mutex_); d.timeout_ = timeout;}
 
-        http_client_timeout_mode_t get_timeout_mode() const {return d.timeout_mode_;}
-        void set_timeout_mode(http_client_timeout_mode_t mode) {d.timeout_mode_ = mode;}
+        http_client_timeout_mode_t get_timeout_mode() const {std::lock_guard<std::mutex> lock(mutex_); return d.timeout_mode_;}
+        void set_timeout_mode(http_client_timeout_mode_t mode) {std::lock_guard<std::mutex> lock(mutex_); d.timeout_mode_ = mode;}
 
         // The base URL every request is referring to
-        std::string get_server_url() const {return d.url_;}
-        void set_server_url(const std::string &url) {d.set_url(url);}
+        // Cached responses are kept by full URL, so they stay valid when the URL changes
+        std::string get_server_url() const {std::lock_guard<std::mutex> lock(mutex_); return d.url_;}
+        void set_server_url(const std::string &url) {std::lock_guard<std::mutex> lock(mutex_); d.url_ = url;}
 
         // Clear the internal response cache
-        void clear_cache() {d.cached_responses_.clear();}
+        void clear_cache() {cache_.clear();}
 
         // The credentials used for authentication
-        user get_user() const {return d.user_;}
+        user get_user() const {std::lock_guard<std::mutex> lock(mutex_); return d.user_;}
         void set_user(const user &_user)
         {
+            std::lock_guard<std::mutex> lock(mutex_);
             d.user_ = _user;
             d.cookie_.clear();
         }
 
         // The type of authentication
-        auth_type get_auth_type() const {return d.auth_type_;}
+        auth_type get_auth_type() const {std::lock_guard<std::mutex> lock(mutex_); return d.auth_type_;}
         std::string get_auth_type_readable() const
         {
-            switch (d.auth_type_)
+            switch (get_auth_type())
             {
                 case auth_basic: return "Basic";
                 case auth_cookie: return "Cookie";
@@ -158,7 +386,7 @@ namespace couchdb
                 default: return "None";
             }
         }
-        void set_auth_type(auth_type type) {d.auth_type_ = type;}
+        void set_auth_type(auth_type type) {std::lock_guard<std::mutex> lock(mutex_); d.auth_type_ = type;}
         void set_auth_type(const std::string &type)
         {
             std::string lower(ascii_string_tools::to_lower_copy(type));
@@ -174,25 +402,24 @@ namespace couchdb
         json::value get_data(const std::string &url, const std::string &method,
                            const std::string &data, const header_map &headers, bool cacheable)
         {
-            get_raw_data(url, method, data, headers, cacheable);
-            return string_to_json(d.buffer_);
+            std::string body;
+            get_raw_data(body, url, method, data, headers, cacheable);
+            return string_to_json(body);
         }
 
-        void get_raw_data(const std::string &url_, std::string method,
+        // Sends a request, and stores the response in `body`, which must be empty
+        void get_raw_data(std::string &body, const std::string &url_, std::string method,
                         const std::string &data, const header_map &headers, bool cacheable)
         {
-            std::string url = d.url_ + url_;
-            header_map new_headers;
+            const state s = get_current_state();
+            std::string url = s.url_ + url_;
 
-            if (d.cached_responses_.find(url_) != d.cached_responses_.end())
+            if (typename response_cache::body_type cached = cache_.find(url))
             {
-                d.buffer_ = d.cached_responses_[url_];
+                body = *cached;
                 return;
             }
 
-            for (auto it: headers)
-                new_headers[ascii_string_tools::to_lower_copy(it.first)] = it.second;
-
 #ifdef CPPCOUCH_DEBUG
             std::cout << "Getting data: " << url << " [" << method << "]" << std::endl;
 #endif
@@ -200,129 +427,101 @@ namespace couchdb
             std::cout << "Sending buffer: " << data << std::endl;
 #endif
 
-            d.buffer_.clear();
+            header_map new_headers = request_headers(data, headers, s);
+
             bool statusCodeError = false;
             std::string errorDescription;
             int statusCode = 200;
 
-            if (new_headers.find("content-type") == new_headers.end())
-                new_headers["content-type"] = "application/json";
-            if (new_headers.find("accept") == new_headers.end())
-                new_headers["accept"] = "application/json";
-            if (new_headers.find("content-length") == new_headers.end())
-                new_headers["content-length"] = std::to_string(data.size());
+            statusCode = client(url, s.timeout_, s.timeout_mode_, new_headers, method, data, body, statusCodeError, errorDescription);
 
-            switch (d.auth_type_)
-            {
-                case auth_basic:
-                    new_headers["authorization"] = d.user_.to_basic_auth();
-                    break;
-                case auth_cookie:
-                    new_headers["cookie"] = d.cookie_;
-                    break;
-                default:
-                    break;
-            }
+            process_response(url, method, statusCode, statusCodeError, errorDescription, body, new_headers);
 
-            statusCode = client(url, d.timeout_, d.timeout_mode_, new_headers, method, data, d.buffer_, statusCodeError, errorDescription);
+            if (cacheable) // Cache response if possible
+                cache_.insert(url, std::make_shared<const std::string>(body));
 
-            if (statusCodeError && statusCode == 0)
-            {
 #ifdef CPPCOUCH_DEBUG
-                std::cout << method << " " << url << " failed with error: " << errorDescription << std::endl;
-                std::cout << method << " " << url << " status code: 400" << std::endl;
+            std::cout << method << " " << url << " response: " << statusCode << std::endl;
+            //for (Network::Http::Headers::const_iterator i = response.headers().begin(); i != response.headers().end(); ++i)
+            //    std::cout << i->first << ": " << i->second << std::endl;
 #endif
-                throw error(error::communication_error, errorDescription, method + ' ' + url, 400, d.buffer_);
-            }
-            else if (statusCodeError)
-            {
-                bool throw_error = true;
-                error::error_type err = error::communication_error;
+#ifdef CPPCOUCH_FULL_DEBUG
+            std::cout << "Raw buffer: " << body << std::endl;
+#endif
+        }
 
-                switch (statusCode)
-                {
-                    case E_Unauthorized:
-                    case E_Forbidden:
-                        err = error::forbidden;
-                        break;
-                    case E_Conflict:
-                        err = error::document_conflict;
-                        break;
-                    case E_Gone:
-                    case E_NotFound:
-                        err = error::content_not_found;
-                        break;
-                    default:
-                        if (statusCode / 100 == 4)
-                            throw_error = false;
-                        break;
-                }
+        // Like get_raw_data(), but feeds the response body through a push parser to `handler` while it is being received,
+        // instead of buffering it. Only the start of the body is kept, for error reports
+        // Returns false if the response was not valid JSON
+        bool get_streamed_data(const std::string &url_, std::string method,
+                               const std::string &data, const header_map &headers, json::event_handler &handler)
+        {
+            const size_t max_buffer_size = 4096;
+            const state s = get_current_state();
+            std::string url = s.url_ + url_;
 
 #ifdef CPPCOUCH_DEBUG
-                std::cout << method << " " << url << " failed with error: " << errorDescription << std::endl;
-                std::cout << method << " " << url << " status code: " << statusCode << std::endl;
+            std::cout << "Streaming data: " << url << " [" << method << "]" << std::endl;
+#endif
+#ifdef CPPCOUCH_FULL_DEBUG
+            std::cout << "Sending buffer: " << data << std::endl;
 #endif
-                if (throw_error)
-                    throw error(err, errorDescription, method + ' ' + url, statusCode, d.buffer_);
-            }
 
-            if (new_headers.find("set-cookie") != new_headers.end()) // Parse out cookie
+            header_map new_headers = request_headers(data, headers, s);
+
+            std::string buffer;
+            bool statusCodeError = false;
+            std::string errorDescription;
+            int statusCode = 200;
+
+            json::push_parser parser(handler);
+            parser.validate_utf8(validate_response_utf8);
+            std::exception_ptr failure; // Exceptions are kept out of the network implementation until it returns
+
+            statusCode = client.stream_response(url, s.timeout_, s.timeout_mode_, new_headers, method, data,
+                                                [&](const char *body, size_t length)
             {
-                std::vector<std::string> split;
-                bool found = false;
+                if (buffer.size() < max_buffer_size)
+                    buffer.append(body, std::min(length, max_buffer_size - buffer.size()));
 
-                d.cookie_ = new_headers["set-cookie"];
-                split = ascii_string_tools::split(d.cookie_, ';');
+                if (failure)
+                    return;
 
-                for (std::string attr: split)
-                {
-                    ascii_string_tools::trim(attr);
-                    if (attr.find("AuthSession") == 0)
-                    {
-                        d.cookie_ = attr;
-                        found = true;
-                        break;
-                    }
-                }
+                try {parser.feed(body, length);}
+                catch (...) {failure = std::current_exception();}
+            }, statusCodeError, errorDescription);
 
-                if (!found)
-                    d.cookie_.clear();
-            }
+            process_response(url, method, statusCode, statusCodeError, errorDescription, buffer, new_headers);
 
-            if (cacheable) // Cache response if possible
-                d.cached_responses_[url_] = d.buffer_;
+            try
+            {
+                if (failure)
+                    std::rethrow_exception(failure);
+                parser.finish();
+            }
+            catch (const json::utf8_error &)
+            {
+                throw invalid_utf8_response();
+            }
+            catch (const json::error &)
+            {
+                return false;
+            }
 
 #ifdef CPPCOUCH_DEBUG
             std::cout << method << " " << url << " response: " << statusCode << std::endl;
-            //for (Network::Http::Headers::const_iterator i = response.headers().begin(); i != response.headers().end(); ++i)
-            //    std::cout << i->first << ": " << i->second << std::endl;
-#endif
-#ifdef CPPCOUCH_FULL_DEBUG
-            std::cout << "Raw buffer: " << d.buffer_ << std::endl;
 #endif
+            return parser.stopped() || parser.values() > 0;
         }
 
-        http_client_response_handle_t get_raw_data_response(const std::string &url_, std::string method,
-                        const std::string &data, const header_map &headers)
+        // Builds the full set of request headers from the user-specified `headers`, and the credentials in `s`
+        static header_map request_headers(const std::string &data, const header_map &headers, const state &s)
         {
-            http_client_response_handle_t handle = client.invalid_handle();
-            std::string url = d.url_ + url_;
             header_map new_headers;
 
             for (auto it: headers)
                 new_headers[ascii_string_tools::to_lower_copy(it.first)] = it.second;
 
-#ifdef CPPCOUCH_DEBUG
-            std::cout << "Getting data: " << url << " [" << method << "]" << std::endl;
-#endif
-#ifdef CPPCOUCH_FULL_DEBUG
-            std::cout << "Sending buffer: " << data << std::endl;
-#endif
-
-            bool statusCodeError = false;
-            std::string errorDescription;
-            int statusCode = 200;
-
             if (new_headers.find("content-type") == new_headers.end())
                 new_headers["content-type"] = "application/json";
             if (new_headers.find("accept") == new_headers.end())
@@ -330,27 +529,33 @@ namespace couchdb
             if (new_headers.find("content-length") == new_headers.end())
                 new_headers["content-length"] = std::to_string(data.size());
 
-            switch (d.auth_type_)
+            switch (s.auth_type_)
             {
                 case auth_basic:
-                    new_headers["authorization"] = d.user_.to_basic_auth();
+                    new_headers["authorization"] = s.user_.to_basic_auth();
                     break;
                 case auth_cookie:
-                    new_headers["cookie"] = d.cookie_;
+                    new_headers["cookie"] = s.cookie_;
                     break;
                 default:
                     break;
             }
 
-            statusCode = client.get_response_handle(url, d.timeout_, d.timeout_mode_, new_headers, method, data, handle, statusCodeError, errorDescription);
+            return new_headers;
+        }
 
+        // Throws if the request failed, with `body` as the response, and picks up the session cookie from the response headers
+        void process_response(const std::string &url, const std::string &method, int statusCode,
+                              bool statusCodeError, const std::string &errorDescription,
+                              const std::string &body, header_map &new_headers)
+        {
             if (statusCodeError && statusCode == 0)
             {
 #ifdef CPPCOUCH_DEBUG
                 std::cout << method << " " << url << " failed with error: " << errorDescription << std::endl;
                 std::cout << method << " " << url << " status code: 400" << std::endl;
 #endif
-                throw error(error::communication_error, errorDescription, method + ' ' + url, 400, d.buffer_);
+                throw error(error::communication_error, errorDescription, method + ' ' + url, 400, body);
             }
             else if (statusCodeError)
             {
@@ -381,45 +586,67 @@ namespace couchdb
                 std::cout << method << " " << url << " status code: " << statusCode << std::endl;
 #endif
                 if (throw_error)
-                    throw error(err, errorDescription, method + ' ' + url, statusCode, d.buffer_);
+                    throw error(err, errorDescription, method + ' ' + url, statusCode, body);
             }
 
             if (new_headers.find("set-cookie") != new_headers.end()) // Parse out cookie
             {
                 std::vector<std::string> split;
-                bool found = false;
+                std::string cookie;
 
-                d.cookie_ = new_headers["set-cookie"];
-                split = ascii_string_tools::split(d.cookie_, ';');
+                split = ascii_string_tools::split(new_headers["set-cookie"], ';');
 
                 for (std::string attr: split)
                 {
                     ascii_string_tools::trim(attr);
                     if (attr.find("AuthSession") == 0)
                     {
-                        d.cookie_ = attr;
-                        found = true;
+                        cookie = attr;
                         break;
                     }
                 }
 
-                if (!found)
-                    d.cookie_.clear();
+                std::lock_guard<std::mutex> lock(mutex_);
+                d.cookie_.swap(cookie);
             }
+        }
+
+        http_client_response_handle_t get_raw_data_response(const std::string &url_, std::string method,
+                        const std::string &data, const header_map &headers)
+        {
+            http_client_response_handle_t handle = client.invalid_handle();
+            const state s = get_current_state();
+            std::string url = s.url_ + url_;
+
+#ifdef CPPCOUCH_DEBUG
+            std::cout << "Getting data: " << url << " [" << method << "]" << std::endl;
+#endif
+#ifdef CPPCOUCH_FULL_DEBUG
+            std::cout << "Sending buffer: " << data << std::endl;
+#endif
+
+            header_map new_headers = request_headers(data, headers, s);
+
+            bool statusCodeError = false;
+            std::string errorDescription;
+            int statusCode = 200;
+
+            statusCode = client.get_response_handle(url, s.timeout_, s.timeout_mode_, new_headers, method, data, handle, statusCodeError, errorDescription);
+
+            process_response(url, method, statusCode, statusCodeError, errorDescription, std::string(), new_headers);
 
 #ifdef CPPCOUCH_DEBUG
             std::cout << method << " " << url << " response: " << statusCode << std::endl;
             //for (Network::Http::Headers::const_iterator i = response.headers().begin(); i != response.headers().end(); ++i)
             //    std::cout << i->first << ": " << i->second << std::endl;
-#endif
-#ifdef CPPCOUCH_FULL_DEBUG
-            std::cout << "Raw buffer: " << d.buffer_ << std::endl;
 #endif
             return handle;
         }
 
         http_client client;
+        mutable std::mutex mutex_; // Guards d
         state d;
+        response_cache cache_;
     };
 }
 
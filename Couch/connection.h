@@ -85,12 +85,12 @@ namespace couchdb
             if (!response.is_object())
                 throw error(error::bad_response);
 
-            response = response["uuids"];
+            response = std::move(response["uuids"]);
             if (!response.is_array())
                 throw error(error::bad_response);
 
             std::vector<std::string> uuids;
-            for (auto val: response.get_array())
+            for (const json::value &val: response.get_array())
                 uuids.push_back(val.get_string());
 
             return uuids;
@@ -105,7 +105,7 @@ namespace couchdb
                 throw error(error::database_unavailable);
 
             std::vector<std::string> dbs;
-            for (auto item: response.get_array())
+            for (const json::value &item: response.get_array())
             {
                 if (item.get_string().find('_') != 0 && item.get_string().find("shards/") != 0)
                     dbs.push_back(item.get_string());
@@ -122,7 +122,7 @@ namespace couchdb
                 throw error(error::database_unavailable);
 
             std::vector<std::string> dbs;
-            for (auto item: response.get_array())
+            for (const json::value &item: response.get_array())
                 dbs.push_back(item.get_string());
 
             return dbs;
@@ -137,7 +137,7 @@ namespace couchdb
                 throw error(error::database_unavailable);
 
             std::vector<database_type> dbs;
-            for (auto item: response.get_array())
+            for (const json::value &item: response.get_array())
             {
                 if (item.get_string().find('_') != 0 && item.get_string().find("shards/") != 0)
                     dbs.push_back(database_type(comm, item.get_string()));
@@ -154,7 +154,7 @@ namespace couchdb
                 throw error(error::database_unavailable);
 
             std::vector<database_type> dbs;
-            for (auto item: response.get_array())
+            for (const json::value &item: response.get_array())
                 dbs.push_back(database_type(comm, item.get_string()));
 
             return dbs;
@@ -167,6 +167,21 @@ namespace couchdb
             return database_type(comm, db);
         }
 
+        // Starts checking for the database with the given name, and passes the database to `handler`
+        // See communication::request_async() for when and where `handler` is called
+        virtual void get_db_async(const std::string &db, const async_handler<database_type> &handler)
+        {
+            const std::shared_ptr<base> keep_alive = comm;
+            comm->request_async("/" + url_encode(db), "HEAD", "", typename base::header_map(),
+                                [keep_alive, db](std::string &) {return database_type(keep_alive, db);}, handler);
+        }
+
+        // Starts checking for the database with the given name, and returns a future for the database
+        std::future<database_type> get_db_async(const std::string &db)
+        {
+            return async_future<database_type>([&](const async_handler<database_type> &handler) {get_db_async(db, handler);});
+        }
+
         // Returns true if the database exists
         virtual bool db_exists(const std::string &db)
         {
@@ -340,8 +355,8 @@ namespace couchdb
             if (!response.is_object() || !response["rows"].is_array())
                 throw error(error::bad_response);
 
-            response = response["rows"];
-            for (auto row: response.get_array())
+            response = std::move(response["rows"]);
+            for (const json::value &row: response.get_array())
             {
                 std::string prefix = "org.couchdb.user:";
                 std::string name = row["id"].get_string();
@@ -0,0 +1,310 @@
+#ifndef CPPCOUCH_COROUTINE_H
+#define CPPCOUCH_COROUTINE_H
+
+#include "connection.h"
+
+#if __cplusplus < 202002L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#error coroutine.h requires C++20
+#endif
+
+#include <coroutine>
+#include <optional>
+#include <type_traits>
+
+namespace couchdb
+{
+    /* Coroutines - co_await-able forms of the asynchronous operations, and a task type to write coroutines with.
+     *
+     * Awaiting an operation suspends the coroutine until its request completes, then resumes it on the thread that
+     * completed the request, which is the event loop of the http_client if it has one (see communication::request_async()).
+     * A chain of requests thus reads sequentially, without holding a thread for each chain:
+     *
+     *     couchdb::task<couchdb::attachment<client>> annotate(couchdb::database<client> db, std::string id)
+     *     {
+     *         couchdb::document<client> doc = co_await couchdb::coro::get_doc(db, id);
+     *         doc = co_await couchdb::coro::set_data(doc, json::object_t());
+     *         co_return co_await couchdb::coro::create_attachment(doc, "note.txt", "text/plain", "checked");
+     *     }
+     *
+     *     std::future<couchdb::attachment<client>> result = couchdb::spawn(annotate(db, "doc"));
+     *
+     * Since a coroutine continues on the event loop after its first request, it must not block there, as with a
+     * synchronous operation or by waiting on a future that the same loop completes
+     */
+
+    /* async_awaitable class - Awaits an asynchronous operation, which is started by passing a handler to `start`
+     * once the awaiting coroutine is suspended. The co_await expression returns the result of the operation,
+     * or throws the exception it failed with
+     */
+
+    template<typename T>
+    class async_awaitable
+    {
+    public:
+        typedef std::function<void (const async_handler<T> &)> start_type;
+
+        explicit async_awaitable(start_type start) : start_(std::move(start)) {}
+
+        bool await_ready() const noexcept {return false;}
+
+        void await_suspend(std::coroutine_handle<> awaiting)
+        {
+            // The operation may resume the coroutine, and so destroy this awaitable, before `start` returns
+            const start_type start = std::move(start_);
+
+            start([this, awaiting](async_result<T> &&result)
+            {
+                result_.emplace(std::move(result));
+                awaiting.resume();
+            });
+        }
+
+        T await_resume() {return std::move(result_->get());}
+
+    private:
+        start_type start_;
+        std::optional<async_result<T>> result_;
+    };
+
+    template<typename T> class task;
+
+    // The parts of the promise of a task that do not depend on its result type
+    struct task_promise_base
+    {
+        // Resumes the coroutine awaiting the finished task, if any
+        struct final_awaiter
+        {
+            bool await_ready() const noexcept {return false;}
+            template<typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept {return finished.promise().continuation;}
+            void await_resume() const noexcept {}
+        };
+
+        // Tasks do not start until awaited
+        std::suspend_always initial_suspend() const noexcept {return {};}
+        final_awaiter final_suspend() const noexcept {return {};}
+
+        void unhandled_exception() {error = std::current_exception();}
+
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+        std::exception_ptr error;
+    };
+
+    template<typename T>
+    struct task_promise : task_promise_base
+    {
+        task<T> get_return_object() {return task<T>(std::coroutine_handle<task_promise>::from_promise(*this));}
+
+        template<typename U>
+        void return_value(U &&value) {result.emplace(std::forward<U>(value));}
+
+        // Returns the value the task returned, or rethrows the exception it failed with
+        T get()
+        {
+            if (error)
+                std::rethrow_exception(error);
+            return std::move(*result);
+        }
+
+        std::optional<T> result;
+    };
+
+    template<>
+    struct task_promise<void> : task_promise_base
+    {
+        task<void> get_return_object();
+
+        void return_void() {}
+
+        void get()
+        {
+            if (error)
+                std::rethrow_exception(error);
+        }
+    };
+
+    /* task class - A coroutine returning T, which starts when it is awaited, or when passed to spawn().
+     * A task may only be awaited once
+     */
+
+    template<typename T>
+    class task
+    {
+    public:
+        typedef task_promise<T> promise_type;
+
+        explicit task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+        task(task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+        task &operator=(task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle_)
+                    handle_.destroy();
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+        ~task()
+        {
+            if (handle_)
+                handle_.destroy();
+        }
+
+        task(const task &) = delete;
+        task &operator=(const task &) = delete;
+
+        bool await_ready() const noexcept {return false;}
+
+        // Runs the task until it first suspends, and resumes `awaiting` once it finishes
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+        {
+            handle_.promise().continuation = awaiting;
+            return handle_;
+        }
+
+        T await_resume() {return handle_.promise().get();}
+
+    private:
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    inline task<void> task_promise<void>::get_return_object() {return task<void>(std::coroutine_handle<task_promise>::from_promise(*this));}
+
+    // A coroutine that runs on its own once called, used by spawn()
+    struct detached_task
+    {
+        struct promise_type
+        {
+            detached_task get_return_object() const noexcept {return {};}
+            std::suspend_never initial_suspend() const noexcept {return {};}
+            std::suspend_never final_suspend() const noexcept {return {};}
+            void return_void() const noexcept {}
+            void unhandled_exception() const noexcept {std::terminate();}
+        };
+    };
+
+    // Runs `t` to completion, and sets `promise` to its outcome
+    template<typename T>
+    detached_task run_task(task<T> t, std::promise<T> promise)
+    {
+        try
+        {
+            if constexpr (std::is_void<T>::value)
+            {
+                co_await t;
+                promise.set_value();
+            }
+            else
+                promise.set_value(co_await t);
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+        }
+    }
+
+    // Starts a task on the calling thread, and returns a future for its result
+    // The task runs until it first awaits an operation, and then continues on the thread that completes the operation
+    template<typename T>
+    std::future<T> spawn(task<T> t)
+    {
+        std::promise<T> promise;
+        std::future<T> future = promise.get_future();
+
+        run_task(std::move(t), std::move(promise));
+        return future;
+    }
+
+    // co_await-able forms of the asynchronous operations, which each await the `_async` operation of the same name
+    // The objects they are called on are copied, so need not outlive the operations (connections and databases are taken
+    // by value, since their operations are not const)
+    namespace coro
+    {
+        template<typename http_client>
+        async_awaitable<database<http_client>> get_db(connection<http_client> conn, const std::string &db)
+        {
+            return async_awaitable<database<http_client>>([conn = std::move(conn), db](const async_handler<database<http_client>> &handler) mutable
+            {
+                conn.get_db_async(db, handler);
+            });
+        }
+
+        template<typename http_client>
+        async_awaitable<document<http_client>> get_doc(database<http_client> db, const std::string &id, const std::string &rev = "")
+        {
+            return async_awaitable<document<http_client>>([db = std::move(db), id, rev](const async_handler<document<http_client>> &handler) mutable
+            {
+                db.get_doc_async(id, rev, handler);
+            });
+        }
+
+        template<typename http_client>
+        async_awaitable<document<http_client>> create_doc(database<http_client> db, const json::value &data /* Object */,
+                                                          const std::string &id = "")
+        {
+            return async_awaitable<document<http_client>>([db = std::move(db), data, id](const async_handler<document<http_client>> &handler) mutable
+            {
+                db.create_doc_async(data, id, handler);
+            });
+        }
+
+        template<typename http_client>
+        async_awaitable<json::value> bulk_update_raw(database<http_client> db, const json::value &docs /* Array */,
+                                                     const json::value &request = json::object_t() /* Object */)
+        {
+            return async_awaitable<json::value>([db = std::move(db), docs, request](const async_handler<json::value> &handler) mutable
+            {
+                db.bulk_update_raw_async(docs, request, handler);
+            });
+        }
+
+        template<typename http_client>
+        async_awaitable<json::value> get_data(const document<http_client> &doc, const queries &_queries = queries())
+        {
+            return async_awaitable<json::value>([doc, _queries](const async_handler<json::value> &handler)
+            {
+                doc.get_data_async(_queries, handler);
+            });
+        }
+
+        template<typename http_client>
+        async_awaitable<document<http_client>> set_data(const document<http_client> &doc, const json::value &data)
+        {
+            return async_awaitable<document<http_client>>([doc, data](const async_handler<document<http_client>> &handler)
+            {
+                doc.set_data_async(data, handler);
+            });
+        }
+
+        template<typename http_client>
+        async_awaitable<attachment<http_client>> create_attachment(const document<http_client> &doc, const std::string &attachmentId,
+                                                                   const std::string &contentType, const std::string &data)
+        {
+            return async_awaitable<attachment<http_client>>([doc, attachmentId, contentType, data](const async_handler<attachment<http_client>> &handler)
+            {
+                doc.create_attachment_async(attachmentId, contentType, data, handler);
+            });
+        }
+
+        template<typename http_client>
+        async_awaitable<std::string> get_data(const attachment<http_client> &att)
+        {
+            return async_awaitable<std::string>([att](const async_handler<std::string> &handler)
+            {
+                att.get_data_async(handler);
+            });
+        }
+
+        template<typename http_client>
+        async_awaitable<view_results> query(const view<http_client> &v, const view_queries &_queries = view_queries())
+        {
+            return async_awaitable<view_results>([v, _queries](const async_handler<view_results> &handler)
+            {
+                v.query_async(_queries, handler);
+            });
+        }
+    }
+}
+
+#endif // CPPCOUCH_COROUTINE_H
@@ -15,5 +15,11 @@
 #include "changes.h"
 #include "uuid.h"
 
+// co_await-able operations are available under C++20
+#if (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)) && defined(__cpp_impl_coroutine)
+#include "coroutine.h"
+#define CPPCOUCH_COROUTINES
+#endif
+
 #endif // CPPCOUCH_H
 
@@ -198,25 +198,56 @@ namespace couchdb
         // Returns the response from CouchDB (which should be an array)
         virtual json::value bulk_update_raw(const json::value &docs /* Array */, const json::value &request = json::object_t() /* Object */)
         {
-            json::value obj(request);
+            return post_bulk_docs(bulk_request_body(docs, request));
+        }
 
-            if (!obj.is_object())
-                obj = json::object_t();
-            obj["docs"] = docs;
+        // Starts a raw '/_bulk_docs' request, as bulk_update_raw() makes, and passes the response from CouchDB to `handler`
+        virtual void bulk_update_raw_async(const json::value &docs /* Array */, const json::value &request /* Object */,
+                                           const async_handler<json::value> &handler)
+        {
+            comm_->request_async(get_bulk_docs_path(), "POST", bulk_request_body(docs, request), typename base::header_map(),
+                                 [](std::string &body)
+            {
+                std::vector<write_result> results;
+                json::value response;
+                const bool decoded = base::decode_body(body, decode_write_results, results, response);
+                return bulk_docs_response(decoded, results, response);
+            }, handler);
+        }
 
-            std::string doc_data = json_to_string(obj);
+        // Starts a raw '/_bulk_docs' request, and returns a future for the response from CouchDB
+        std::future<json::value> bulk_update_raw_async(const json::value &docs /* Array */, const json::value &request = json::object_t() /* Object */)
+        {
+            return async_future<json::value>([&](const async_handler<json::value> &handler) {bulk_update_raw_async(docs, request, handler);});
+        }
 
-            json::value response = comm_->get_data("/" + url_encode(get_db_name()) + "/_bulk_docs", "POST", doc_data);
-            if (!response.is_array())
-                return response;
+        // Like bulk_update_raw(), but leaves out each document whose json::canonical_hash() is the same as the hash
+        // at its position in `original_hashes` (taken when the documents were read), so unchanged documents are not rewritten
+        // Returns the response from CouchDB for the documents that were written, which is empty if none were
+        virtual json::value bulk_update_changed(const json::value &docs /* Array */, const std::vector<uint64_t> &original_hashes,
+                                                const json::value &request = json::object_t() /* Object */)
+        {
+            std::string doc_data;
+            json::writer writer(doc_data);
+            size_t changed = 0;
 
-            for (auto item: response.get_array())
+            write_bulk_request_start(writer, request);
+            doc_data.push_back('[');
+            for (size_t i = 0; i < docs.size(); ++i)
             {
-                if (item.is_object() && !item["ok"].get_bool())
-                    throw error(item["error"] == "conflict"? error::document_not_creatable: error::forbidden);
+                if (i < original_hashes.size() && json::canonical_hash(docs[i]) == original_hashes[i])
+                    continue;
+
+                if (changed++)
+                    doc_data.push_back(',');
+                writer.write(docs[i]);
             }
+            doc_data.append("]}", 2);
 
-            return response;
+            if (changed == 0)
+                return json::array_t();
+
+            return post_bulk_docs(doc_data);
         }
 
         // Inserts several documents at one time in the current database
@@ -231,19 +262,37 @@ namespace couchdb
             return bulk_update_raw(docs, request);
         }
 
+#ifdef CPPCOUCH_TYPED_DOCUMENTS
+        // Inserts several documents, structs described with JSON_MAPPING, at one time in the current database
+        // The documents are serialized directly as they are, so their '_rev' members should be left empty
+        // Returns the response from CouchDB (which should be an array)
+        template<typename T>
+        typename std::enable_if<json::is_mapped<T>::value, json::value>::type
+            bulk_insert(const std::vector<T> &docs, const json::value &request = json::object_t() /* Object */)
+        {
+            std::string doc_data;
+            json::writer writer(doc_data);
+
+            write_bulk_request_start(writer, request);
+            json::write_typed(writer, docs).str().push_back('}');
+
+            return post_bulk_docs(doc_data);
+        }
+#endif
+
         // Deletes several documents at one time in the current database
         // Returns the response from CouchDB (which should be an array)
         virtual json::value bulk_delete(const std::vector<document_type> &docs, const json::value &request = json::object_t() /* Object */)
         {
             json::value arr;
 
-            for (auto d: docs)
+            for (const auto &d: docs)
             {
                 json::value obj;
                 obj["_id"] = d.get_doc_id();
                 obj["_rev"] = d.get_doc_revision();
                 obj["_deleted"] = true;
-                arr.push_back(obj);
+                arr.push_back(std::move(obj));
             }
 
             return bulk_update_raw(arr, request);
@@ -271,7 +320,7 @@ namespace couchdb
         }
 
         // Returns the number of documents in the database
-        virtual bool get_is_compacting() {return get_info()["compact_running"].get_bool();}
+        virtual bool get_is_compacting() {return get_lazy_info()["compact_running"].get_bool();}
 
         // Returns the unencoded name of the database
         virtual std::string get_db_name() const {return name_;}
@@ -295,106 +344,52 @@ namespace couchdb
         }
 
         // Returns the number of documents in the database
-        virtual size_t get_doc_count() {return get_info()["doc_count"].get_int();}
+        virtual size_t get_doc_count() {return get_lazy_info()["doc_count"].get_int();}
 
         // Returns the number of deleted documents in the database
-        virtual size_t get_deleted_doc_count() {return get_info()["doc_del_count"].get_int();}
+        virtual size_t get_deleted_doc_count() {return get_lazy_info()["doc_del_count"].get_int();}
 
         // Lists all normal documents (excludes design documents)
-        virtual std::vector<document_type> list_docs()
+        // If `parse_threads` is not 1, the listing is parsed on that many threads at once (or on every hardware thread if it is 0),
+        // which suits very large databases
+        virtual std::vector<document_type> list_docs(size_t parse_threads = 1)
         {
-            json::value response = comm_->get_data("/" + url_encode(name_) + "/_all_docs");
-            if (!response.is_object())
-                throw error(error::database_unavailable);
-
             std::vector<document_type> docs;
 
-            if (response["total_rows"].get_int() > 0)
+            for_each_all_docs_row([&](json::string_ref id, json::string_ref rev)
             {
-                const json::value &rows = response["rows"];
-                if (!rows.is_array())
-                    throw error(error::database_unavailable);
-
-                for (auto row: rows.get_array())
-                {
-                    if (!row.is_object())
-                        throw error(error::database_unavailable);
-
-                    if (row["id"].get_string().find("_design/") != 0) // Ignore design documents
-                    {
-                        const json::value &value = row["value"];
-                        if (!value.is_object())
-                            throw error(error::database_unavailable);
-
-                        docs.push_back(document_type(comm_, name_, row["id"].get_string(), value["rev"].get_string()));
-                    }
-                }
-            }
+                if (!id.starts_with("_design/")) // Ignore design documents
+                    docs.push_back(document_type(comm_, name_, id, rev));
+            }, parse_threads);
 
             return docs;
         }
 
         // Lists all documents, normal or design
-        virtual std::vector<document_type> list_all_docs()
+        // `parse_threads` is as for list_docs()
+        virtual std::vector<document_type> list_all_docs(size_t parse_threads = 1)
         {
-            json::value response = comm_->get_data("/" + url_encode(name_) + "/_all_docs");
-            if (!response.is_object())
-                throw error(error::database_unavailable);
-
             std::vector<document_type> docs;
 
-            if (response["total_rows"].get_int() > 0)
+            for_each_all_docs_row([&](json::string_ref id, json::string_ref rev)
             {
-                const json::value &rows = response["rows"];
-                if (!rows.is_array())
-                    throw error(error::database_unavailable);
-
-                for (auto row: rows.get_array())
-                {
-                    if (!row.is_object())
-                        throw error(error::database_unavailable);
-
-                    const json::value &value = row["value"];
-                    if (!value.is_object())
-                        throw error(error::database_unavailable);
-
-                    docs.push_back(document_type(comm_, name_, row["id"].get_string(), value["rev"].get_string()));
-                }
-            }
+                docs.push_back(document_type(comm_, name_, id, rev));
+            }, parse_threads);
 
             return docs;
         }
 
         // Lists all design documents
-        virtual std::vector<design_document_type> list_design_docs()
+        // `parse_threads` is as for list_docs()
+        virtual std::vector<design_document_type> list_design_docs(size_t parse_threads = 1)
         {
-            json::value response = comm_->get_data("/" + url_encode(name_) + "/_all_docs");
-            if (!response.is_object())
-                throw error(error::database_unavailable);
-
             std::vector<design_document_type> docs;
 
-            if (response["total_rows"].get_int() > 0)
+            for_each_all_docs_row([&](json::string_ref id, json::string_ref rev)
             {
-                const json::value &rows = response["rows"];
-                if (!rows.is_array())
-                    throw error(error::database_unavailable);
-
-                for (auto row: rows.get_array())
-                {
-                    if (!row.is_object())
-                        throw error(error::database_unavailable);
-
-                    if (row["id"].get_string().find("_design/") == 0) // Only allow design documents
-                    {
-                        const json::value &value = row["value"];
-                        if (!value.is_object())
-                            throw error(error::database_unavailable);
-
-                        docs.push_back(design_document_type(comm_, name_, row["id"].get_string(), value["rev"].get_string()));
-                    }
-                }
-            }
+                if (id.starts_with("_design/")) // Only allow design documents
+                    docs.push_back(design_document_type(comm_, name_, id, rev));
+            }, parse_threads);
 
             return docs;
         }
@@ -402,23 +397,24 @@ namespace couchdb
         // Returns a document with given id, and optional revision
         virtual document_type get_doc(const std::string &id, const std::string &rev = "")
         {
-            std::string url = "/" + url_encode(name_) + "/" + url_encode_doc_id(id);
-            if (rev.size() > 0)
-                url += "?rev=" + url_encode(rev);
-
-            json::value response = comm_->get_data(url);
-            if (!response.is_object())
-                throw error(error::document_unavailable);
+            return doc_from_response(comm_->get_lazy_data(get_doc_path(id, rev)), id, rev);
+        }
 
-            if (!response.is_member("_id"))
+        // Starts reading a document with given id, and optional revision, and passes the document to `handler`
+        // See communication::request_async() for when and where `handler` is called
+        virtual void get_doc_async(const std::string &id, const std::string &rev, const async_handler<document_type> &handler)
+        {
+            const database self(*this);
+            comm_->request_async(get_doc_path(id, rev), "GET", "", typename base::header_map(), [self, id, rev](std::string &body)
             {
-#ifdef CPPCOUCH_DEBUG
-                std::cout << "Document " + id + " (v" + rev + ") not found: " + response["reason"].get_string();
-#endif
-                throw error(error::database_unavailable, response["reason"].get_string());
-            }
+                return self.doc_from_response(string_to_lazy_json(std::make_shared<const std::string>(std::move(body))), id, rev);
+            }, handler);
+        }
 
-            return document_type(comm_, name_, response["_id"].get_string(), response["_rev"].get_string());
+        // Starts reading a document with given id, and optional revision, and returns a future for the document
+        std::future<document_type> get_doc_async(const std::string &id, const std::string &rev = "")
+        {
+            return async_future<document_type>([&](const async_handler<document_type> &handler) {get_doc_async(id, rev, handler);});
         }
 
         // Creates a document with given body
@@ -443,38 +439,49 @@ namespace couchdb
 
                     attachmentData["data"] = item.get_data();
                     attachmentData["content_type"] = item.get_content_type();
-                    attachmentObj[item.get_doc_id()] = attachmentData;
+                    attachmentObj[item.get_doc_id()] = std::move(attachmentData);
                 }
 
-                data["_attachments"] = attachmentObj;
+                data["_attachments"] = std::move(attachmentObj);
             }
 
-            std::string method, url;
+            return create_doc_from_body(json_to_string(data), id);
+        }
 
-            if (id.size() > 0)
-            {
-                url = "/" + url_encode(name_) + "/" + url_encode(id);
-                method = "PUT";
-            }
-            else
-            {
-                url = "/" + url_encode(name_) + "/";
-                method = "POST";
-            }
+#ifdef CPPCOUCH_TYPED_DOCUMENTS
+        // Creates a document from a struct described with JSON_MAPPING, which is serialized directly into the request
+        // If id is empty, an automatically generated id will be given to the document
+        template<typename T>
+        typename std::enable_if<json::is_mapped<T>::value, document_type>::type
+            create_doc(const T &data, const std::string &id = "")
+        {
+            std::string body;
+            json::writer writer(body);
+            json::write_typed(writer, data);
 
-            json::value response = comm_->get_data(url, method, json_to_string(data));
-            if (!response.is_object())
-                throw error(error::document_not_creatable);
+            return create_doc_from_body(body, id);
+        }
+#endif
 
-            if (!response.is_member("id"))
+        // Starts creating a document with given body, and passes the new document to `handler`
+        // If id is empty, an automatically generated id will be given to the document
+        virtual void create_doc_async(const json::value &data /* Object */, const std::string &id, const async_handler<document_type> &handler)
+        {
+            const database self(*this);
+            comm_->request_async(get_create_doc_path(id), id.empty()? "POST": "PUT", json_to_string(data), typename base::header_map(),
+                                 [self](std::string &body)
             {
-#ifdef CPPCOUCH_DEBUG
-                std::cout << "Document could not be created: " + response["reason"].get_string();
-#endif
-                throw error(error::document_not_creatable, response["reason"].get_string());
-            }
+                write_result result;
+                json::value response;
+                const bool decoded = base::decode_body(body, decode_write_result, result, response);
+                return self.created_doc(decoded, result, response);
+            }, handler);
+        }
 
-            return document_type(comm_, name_, response["id"].get_string(), response["rev"].get_string());
+        // Starts creating a document with given body, and returns a future for the new document
+        std::future<document_type> create_doc_async(const json::value &data /* Object */, const std::string &id = "")
+        {
+            return async_future<document_type>([&](const async_handler<document_type> &handler) {create_doc_async(data, id, handler);});
         }
 
         // Ensures a document exists and returns it
@@ -517,7 +524,7 @@ namespace couchdb
             if (rev.size() > 0)
                 url += "?rev=" + url_encode(rev);
 
-            json::value response = comm_->get_data(url);
+            const json::lazy_value response = comm_->get_lazy_data(url);
             if (!response.is_object())
                 throw error(error::document_unavailable);
 
@@ -554,10 +561,10 @@ namespace couchdb
 
                     attachmentData["data"] = item.get_data();
                     attachmentData["content_type"] = item.get_content_type();
-                    attachmentObj[item.get_doc_id()] = attachmentData;
+                    attachmentObj[item.get_doc_id()] = std::move(attachmentData);
                 }
 
-                data["_attachments"] = attachmentObj;
+                data["_attachments"] = std::move(attachmentObj);
             }
 
             std::string method, url;
@@ -617,6 +624,186 @@ namespace couchdb
         virtual std::string get_db_url() const {return comm_->get_server_url() + "/" + url_encode(name_);}
 
     protected:
+        // Creates a document with a serialized body
+        document_type create_doc_from_body(const std::string &body, const std::string &id)
+        {
+            write_result result;
+            json::value response;
+            const bool decoded = comm_->get_decoded_data(get_create_doc_path(id), decode_write_result, result, response,
+                                                         id.empty()? "POST": "PUT", body);
+            return created_doc(decoded, result, response);
+        }
+
+        // Returns the path to PUT a document with given id to, or to POST a document to if id is empty
+        std::string get_create_doc_path(const std::string &id) const
+        {
+            return "/" + url_encode(name_) + "/" + url_encode(id);
+        }
+
+        // Returns the document written by a document PUT or POST, given its response as read by communication::get_decoded_data()
+        document_type created_doc(bool decoded, write_result &result, const json::value &response) const
+        {
+            if (!decoded)
+            {
+                if (!response.is_object())
+                    throw error(error::document_not_creatable);
+
+                result = write_result(response);
+            }
+
+            if (result.id.empty())
+            {
+#ifdef CPPCOUCH_DEBUG
+                std::cout << "Document could not be created: " + result.reason;
+#endif
+                throw error(error::document_not_creatable, result.reason);
+            }
+
+            return document_type(comm_, name_, result.id, result.rev);
+        }
+
+        // Returns the path of a document with given id, and optional revision
+        std::string get_doc_path(const std::string &id, const std::string &rev) const
+        {
+            std::string url = "/" + url_encode(name_) + "/" + url_encode_doc_id(id);
+            if (rev.size() > 0)
+                url += "?rev=" + url_encode(rev);
+
+            return url;
+        }
+
+        // Returns the document described by the response to reading a document with given id and revision
+        document_type doc_from_response(const json::lazy_value &response, const std::string &id, const std::string &rev) const
+        {
+            if (!response.is_object())
+                throw error(error::document_unavailable);
+
+            if (!response.is_member("_id"))
+            {
+#ifdef CPPCOUCH_DEBUG
+                std::cout << "Document " + id + " (v" + rev + ") not found: " + response["reason"].get_string();
+#else
+                (void) id, (void) rev;
+#endif
+                throw error(error::database_unavailable, response["reason"].get_string());
+            }
+
+            return document_type(comm_, name_, response["_id"].get_string(), response["_rev"].get_string());
+        }
+
+        // Writes the start of a '/_bulk_docs' request, up to the documents: `{request...,"docs":`
+        static void write_bulk_request_start(json::writer &writer, const json::value &request)
+        {
+            writer.str().push_back('{');
+            for (auto it = request.get_object().begin(); it != request.get_object().end(); ++it)
+            {
+                if (it->first == "docs")
+                    continue;
+
+                writer.write_string(it->first).str().push_back(':');
+                writer.write(it->second).str().push_back(',');
+            }
+            writer.write_string("docs", 4).str().push_back(':');
+        }
+
+        // Returns the serialized '/_bulk_docs' request {request..., "docs": docs}
+        static std::string bulk_request_body(const json::value &docs, const json::value &request)
+        {
+            // Serialize directly, rather than copying every document into a new request object
+            std::string doc_data;
+            json::writer writer(doc_data);
+
+            doc_data.reserve(json::writer::estimate_size(request) + json::writer::estimate_size(docs) + 8);
+            write_bulk_request_start(writer, request);
+            writer.write(docs).str().push_back('}');
+
+            return doc_data;
+        }
+
+        // Returns the path of '/_bulk_docs' for this database
+        std::string get_bulk_docs_path() const {return "/" + url_encode(name_) + "/_bulk_docs";}
+
+        // Posts a serialized '/_bulk_docs' request, and throws if any of the documents failed to be written
+        json::value post_bulk_docs(const std::string &doc_data)
+        {
+            std::vector<write_result> results;
+            json::value response;
+            const bool decoded = comm_->get_decoded_data(get_bulk_docs_path(), decode_write_results, results, response, "POST", doc_data);
+            return bulk_docs_response(decoded, results, response);
+        }
+
+        // Returns the response to a '/_bulk_docs' request, given as read by communication::get_decoded_data(),
+        // and throws if any of the documents failed to be written
+        static json::value bulk_docs_response(bool decoded, const std::vector<write_result> &results, json::value &response)
+        {
+            if (decoded)
+            {
+                response = json::array_t();
+                for (const write_result &result: results)
+                {
+                    if (!result.ok)
+                        throw error(result.error == "conflict"? error::document_not_creatable: error::forbidden);
+                    response.push_back(result.to_json());
+                }
+
+                return response;
+            }
+
+            if (!response.is_array())
+                return response;
+
+            for (const auto &item: response.get_array())
+            {
+                if (item.is_object() && !item["ok"].get_bool())
+                    throw error(item["error"] == "conflict"? error::document_not_creatable: error::forbidden);
+            }
+
+            return response;
+        }
+
+        // Returns CouchDB's information about the database, for reading single members
+        json::lazy_value get_lazy_info()
+        {
+            const json::lazy_value response = comm_->get_lazy_data("/" + url_encode(name_));
+            if (!response.is_object() || !response.is_member("db_name"))
+                throw error(error::database_unavailable);
+
+            return response;
+        }
+
+        // Passes the id and revision of every row of '/_all_docs' to `callback`, as json::string_ref values
+        // The listing is parsed on `parse_threads` threads if that is not 1, or else read with decode_all_docs() if possible,
+        // and otherwise parsed generically
+        template<typename Callback>
+        void for_each_all_docs_row(Callback callback, size_t parse_threads)
+        {
+            const std::string url = "/" + url_encode(name_) + "/_all_docs";
+            all_docs_result listing;
+            json::value response;
+
+            if (parse_threads != 1)
+                response = comm_->get_rows_parallel(url, parse_threads);
+            else if (comm_->get_decoded_data(url, decode_all_docs, listing, response))
+            {
+                for (const all_docs_row &row: listing.rows)
+                    callback(json::string_ref(row.id), json::string_ref(row.rev));
+                return;
+            }
+
+            const json::value &rows = response["rows"];
+            if (!response.is_object() || (response["total_rows"].get_int() > 0 && !rows.is_array()))
+                throw error(error::database_unavailable);
+
+            for (const json::value &row: rows.get_array())
+            {
+                const json::value *value = row.find("value");
+                if (!value || !value->is_object())
+                    throw error(error::database_unavailable);
+
+                callback(row["id"].get_string_ref(), (*value)["rev"].get_string_ref());
+            }
+        }
+
         std::shared_ptr<base> comm_;
         std::string name_;
     };
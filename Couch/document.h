@@ -69,16 +69,16 @@ namespace couchdb
         // Returns a document referencing the latest revision of this document, with a valid '_rev' value
         virtual document get_latest_revision() const
         {
-            json::value response = comm_->get_data("/" + url_encode(db_) + "/_all_docs?key=" + url_encode("\"" + id_ + "\""));
+            const json::lazy_value response = comm_->get_lazy_data("/" + url_encode(db_) + "/_all_docs?key=" + url_encode("\"" + id_ + "\""));
             if (!response.is_object())
                 throw error(error::document_unavailable);
 
             int numRows = response["total_rows"].get_int();
-            const json::value &rows = response["rows"];
+            const json::lazy_value rows = response["rows"];
 
-            if (numRows > 0 && rows.is_array() && rows.size())
+            if (numRows > 0 && rows.is_array() && rows.begin() != rows.end())
             {
-                const json::value &docObj = rows[static_cast<size_t>(0)];
+                const json::lazy_value docObj = rows[static_cast<size_t>(0)];
                 if (!docObj.is_object() || !docObj["value"].is_object())
                     throw error(error::document_unavailable);
 
@@ -145,7 +145,7 @@ namespace couchdb
             if (!array.is_array())
                 throw error(error::document_unavailable);
 
-            for (auto rev: array.get_array())
+            for (const json::value &rev: array.get_array())
             {
                 if (rev.is_object())
                     revisions.push_back(revision(rev["rev"].get_string(), rev["status"].get_string()));
@@ -157,41 +157,44 @@ namespace couchdb
         // Returns the body of the document with given queries
         virtual json::value get_data(const queries &_queries = queries()) const
         {
-            json::value obj = comm_->get_data(add_url_queries(get_doc_url_path(true), _queries));
-            if (!obj.is_object())
-                throw error(error::document_unavailable);
+            return checked_body(comm_->get_data(add_url_queries(get_doc_url_path(true), _queries)));
+        }
 
-            if (!obj.is_member("_id") && !obj.is_member("_rev") &&
-                    obj.is_member("error") && obj.is_member("reason"))
-            {
-#ifdef CPPCOUCH_DEBUG
-                std::cout << "Document \"" + id_ + "\" not found: " + obj["reason"].get_string();
-#endif
-                throw error(error::document_unavailable, obj["reason"].get_string());
-            }
+        // Starts reading the body of the document with given queries, and passes the body to `handler`
+        // See communication::request_async() for when and where `handler` is called
+        virtual void get_data_async(const queries &_queries, const async_handler<json::value> &handler) const
+        {
+            const document self(*this);
+            comm_->request_async(add_url_queries(get_doc_url_path(true), _queries), "GET", "", typename base::header_map(),
+                                 [self](std::string &body) {return self.checked_body(string_to_json(body));}, handler);
+        }
 
-            return obj;
+        // Starts reading the body of the document with given queries, and returns a future for the body
+        std::future<json::value> get_data_async(const queries &_queries = queries()) const
+        {
+            return async_future<json::value>([&](const async_handler<json::value> &handler) {get_data_async(_queries, handler);});
         }
 
         // Returns the body of the document with given queries
         // If include_revision_in_request is false, the most up-to-date revision is used
         virtual json::value get_data(bool include_revision_in_request, const queries &queries = queries()) const
         {
-            json::value obj = comm_->get_data(add_url_queries(get_doc_url_path(include_revision_in_request), queries));
-            if (!obj.is_object())
-                throw error(error::document_unavailable);
+            return checked_body(comm_->get_data(add_url_queries(get_doc_url_path(include_revision_in_request), queries)));
+        }
 
-            if (!obj.is_member("_id") && !obj.is_member("_rev") &&
-                    obj.is_member("error") && obj.is_member("reason"))
-            {
-#ifdef CPPCOUCH_DEBUG
-                std::cout << "Document \"" + id_ + "\" not found: " + obj["reason"].get_string();
-#endif
-                throw error(error::document_unavailable, obj["reason"].get_string());
-            }
+#ifdef CPPCOUCH_TYPED_DOCUMENTS
+        // Returns the body of the document with given queries, read straight into a struct described with JSON_MAPPING
+        // For example: `person p = doc.get_data<person>();`
+        template<typename T>
+        typename std::enable_if<json::is_mapped<T>::value, T>::type get_data(const queries &_queries = queries()) const
+        {
+            T result;
+            if (!comm_->get_typed_data(add_url_queries(get_doc_url_path(true), _queries), result))
+                throw error(error::document_unavailable);
 
-            return obj;
+            return result;
         }
+#endif
 
         // Returns the body of the document with conflict resolution
         virtual json::value get_data_with_conflict_resolver(DocumentConflictResolver callback, const queries &_queries = queries())
@@ -215,20 +218,20 @@ namespace couchdb
             if (!data.is_object())
                 throw error(error::document_unavailable);
 
-            json::value conflicts = data["_conflicts"];
+            json::value conflicts = std::move(data["_conflicts"]);
             if (!conflicts.is_array())
                 throw error(error::document_unavailable);
 
             conflicts.push_back(data["_rev"].get_string());
 
             // Get the content of each conflict
-            for (auto conflict: conflicts.get_array())
+            for (const json::value &conflict: conflicts.get_array())
                 docs.push_back(document(comm_, db_, id_, conflict.get_string()).get_data(_queries));
 
             //if there are conflicts
             if (docs.size() > 1)
             {
-                json::value result = data;
+                json::value result = std::move(data);
                 result.erase("_conflicts");
 
                 // Attempt to resolve
@@ -262,72 +265,108 @@ namespace couchdb
         // Sets the body of the document with given fields,
         // and updates this document to point to the new revision
         // IMPORTANT: No other document objects will be updated to the new revision
+        // If the new body is the same as the current one, nothing is written and this document points to the current revision
         virtual document &set_data(json::value data)
         {
             json::value response = comm_->get_data(get_doc_url_path(true));
-            if (!response.is_object())
-                throw error(error::document_unavailable);
-
-            if (!data.is_object())
-                data = json::value();
 
-            for (auto it = response.get_object().begin(); it != response.get_object().end(); ++it)
+            // Writing an identical body would only add a revision with no changes
+            if (!merge_current_body(data, response))
             {
-                std::string key = it->first;
-                if ((key == "_id" || key == "_rev") || // Reserved field? These cannot be modified, so we need to make sure they don't change
-                    (key.find('_') == 0 && !data.is_member(key))) // Non-included reserved field, we should include it (reserved fields are those beginning with an underscore '_')
-                    data[key] = response[key];
+                revision_ = data["_rev"].get_string();
+                return *this;
             }
 
-            response = comm_->get_data(get_doc_url_path(false), "PUT", json_to_string(data));
-            if (!response.is_object())
-                throw error(error::document_unavailable);
+            write_result result;
+            const bool decoded = comm_->get_decoded_data(get_doc_url_path(false), decode_write_result, result, response, "PUT", json_to_string(data));
+            revision_ = written_revision(decoded, result, response);
 
-            if (!response.is_member("id"))
+            return *this;
+        }
+
+        // Starts setting the body of the document with given fields, as set_data() does, and passes a document
+        // pointing to the new revision to `handler`
+        // IMPORTANT: This document is not updated to the new revision
+        virtual void set_data_async(json::value data, const async_handler<document> &handler) const
+        {
+            const document self(*this);
+            const std::shared_ptr<json::value> body = std::make_shared<json::value>(std::move(data));
+
+            comm_->request_async(get_doc_url_path(true), "GET", "", typename base::header_map(), [body](std::string &response)
             {
-#ifdef CPPCOUCH_DEBUG
-                std::cout << "Document could not be created: " + response["reason"].get_string();
-#endif
-                throw error(error::document_unavailable, response["reason"].get_string());
-            }
+                json::value current = string_to_json(response);
+                return merge_current_body(*body, current);
+            }, [self, body, handler](async_result<bool> &&changed)
+            {
+                if (changed.failed())
+                    return handler(async_result<document>(changed.error()));
 
-            revision_ = response["rev"].get_string();
+                if (!changed.get())
+                {
+                    document written(self);
+                    written.revision_ = (*body)["_rev"].get_string();
+                    return handler(async_result<document>(std::move(written)));
+                }
 
-            return *this;
+                self.comm_->request_async(self.get_doc_url_path(false), "PUT", json_to_string(*body), typename base::header_map(),
+                                          [self](std::string &response)
+                {
+                    write_result result;
+                    json::value fallback;
+                    const bool decoded = base::decode_body(response, decode_write_result, result, fallback);
+
+                    document written(self);
+                    written.revision_ = written_revision(decoded, result, fallback);
+                    return written;
+                }, handler);
+            });
+        }
+
+        // Starts setting the body of the document with given fields, and returns a future for a document pointing to the new revision
+        std::future<document> set_data_async(json::value data) const
+        {
+            return async_future<document>([&](const async_handler<document> &handler) {set_data_async(std::move(data), handler);});
         }
 
         // Adds an attachment with given attachment id, content-type, and data
         // The attachment id must not be empty
         virtual attachment_type create_attachment(const std::string &attachmentId, const std::string &contentType, const std::string &data)
         {
-            if (attachmentId.empty())
-                throw error(error::attachment_not_creatable, "No attachment identifier specified");
-
-            std::string url = get_doc_url_path(false) + "/" + url_encode_attachment_id(attachmentId);
-            if (revision_.size() > 0)
-                url += "?rev=" + url_encode(revision_);
-
             typename base::header_map headers;
             headers["Content-Type"] = contentType;
 
-            json::value response = comm_->get_data(url, headers, "PUT", data);
-            if (!response.is_object())
-                throw error(error::document_unavailable);
+            json::value response = comm_->get_data(get_new_attachment_path(attachmentId), headers, "PUT", data);
+            revision_ = created_attachment_revision(response, attachmentId);
 
-            if (response.is_member("error") && response.is_member("reason"))
-            {
-#ifdef CPPCOUCH_DEBUG
-                std::cout << "Could not create attachment \"" + attachmentId + "\": " + response["reason"].get_string();
-#endif
-                throw error(error::attachment_not_creatable, response["reason"].get_string());
-            }
+            return attachment_type(comm_, db_, id_, attachmentId, revision_, contentType, data.size());
+        }
 
-            revision_ = response["rev"].get_string();
+        // Starts adding an attachment, as create_attachment() does, and passes the new attachment to `handler`
+        // IMPORTANT: This document is not updated to the new revision, which is the revision of the attachment
+        virtual void create_attachment_async(const std::string &attachmentId, const std::string &contentType, const std::string &data,
+                                             const async_handler<attachment_type> &handler) const
+        {
+            const document self(*this);
+            const size_t size = data.size();
+            typename base::header_map headers;
+            headers["Content-Type"] = contentType;
 
-            if (!response["ok"].get_bool())
-                throw error(error::attachment_not_creatable);
+            comm_->request_async(get_new_attachment_path(attachmentId), "PUT", data, headers,
+                                 [self, attachmentId, contentType, size](std::string &body)
+            {
+                const std::string revision = created_attachment_revision(string_to_json(body), attachmentId);
+                return attachment_type(self.comm_, self.db_, self.id_, attachmentId, revision, contentType, size);
+            }, handler);
+        }
 
-            return attachment_type(comm_, db_, id_, attachmentId, revision_, contentType, data.size());
+        // Starts adding an attachment, and returns a future for the new attachment
+        std::future<attachment_type> create_attachment_async(const std::string &attachmentId, const std::string &contentType,
+                                                             const std::string &data) const
+        {
+            return async_future<attachment_type>([&](const async_handler<attachment_type> &handler)
+            {
+                create_attachment_async(attachmentId, contentType, data, handler);
+            });
         }
 
         // Ensures an attachment exists and returns it
@@ -365,7 +404,7 @@ namespace couchdb
                 throw error(error::attachment_unavailable, "The document has no attachments");
             }
 
-            response = response["_attachments"];
+            response = std::move(response["_attachments"]);
             if (!response.is_object() || !response.is_member(attachmentId))
             {
 #ifdef CPPCOUCH_DEBUG
@@ -374,7 +413,7 @@ namespace couchdb
                 throw error(error::attachment_unavailable);
             }
 
-            response = response[attachmentId];
+            response = std::move(response[attachmentId]);
             if (!response.is_object())
                 throw error(error::attachment_unavailable);
 
@@ -519,6 +558,106 @@ namespace couchdb
             return url;
         }
 
+        // Returns the body of the document as read, or throws if it is an error response
+        json::value checked_body(json::value obj) const
+        {
+            if (!obj.is_object())
+                throw error(error::document_unavailable);
+
+            if (!obj.is_member("_id") && !obj.is_member("_rev") &&
+                    obj.is_member("error") && obj.is_member("reason"))
+            {
+#ifdef CPPCOUCH_DEBUG
+                std::cout << "Document \"" + id_ + "\" not found: " + obj["reason"].get_string();
+#endif
+                throw error(error::document_unavailable, obj["reason"].get_string());
+            }
+
+            return obj;
+        }
+
+        // Completes `data` as the new body of the document, taking the reserved fields it leaves out from `current`,
+        // the current body, which is moved from
+        // Returns false if the new body is the same as the current one
+        static bool merge_current_body(json::value &data, json::value &current)
+        {
+            if (!current.is_object())
+                throw error(error::document_unavailable);
+
+            // Copied now, since the members of the current body are moved into the new body below
+            const json::value original = current;
+
+            if (!data.is_object())
+                data = json::value();
+
+            for (auto it = current.get_object().begin(); it != current.get_object().end(); ++it)
+            {
+                const std::string &key = it->first;
+                if ((key == "_id" || key == "_rev") || // Reserved field? These cannot be modified, so we need to make sure they don't change
+                    (key.find('_') == 0 && !data.is_member(key))) // Non-included reserved field, we should include it (reserved fields are those beginning with an underscore '_')
+                    data[key] = std::move(it->second);
+            }
+
+            return data != original;
+        }
+
+        // Returns the new revision from the response to a document PUT, given as read by communication::get_decoded_data()
+        static std::string written_revision(bool decoded, write_result &result, const json::value &response)
+        {
+            if (!decoded)
+            {
+                if (!response.is_object())
+                    throw error(error::document_unavailable);
+
+                result = write_result(response);
+            }
+
+            if (result.id.empty())
+            {
+#ifdef CPPCOUCH_DEBUG
+                std::cout << "Document could not be created: " + result.reason;
+#endif
+                throw error(error::document_unavailable, result.reason);
+            }
+
+            return result.rev;
+        }
+
+        // Returns the path to PUT a new attachment with given id to
+        std::string get_new_attachment_path(const std::string &attachmentId) const
+        {
+            if (attachmentId.empty())
+                throw error(error::attachment_not_creatable, "No attachment identifier specified");
+
+            std::string url = get_doc_url_path(false) + "/" + url_encode_attachment_id(attachmentId);
+            if (revision_.size() > 0)
+                url += "?rev=" + url_encode(revision_);
+
+            return url;
+        }
+
+        // Returns the new revision of the document from the response to an attachment PUT
+        static std::string created_attachment_revision(const json::value &response, const std::string &attachmentId)
+        {
+            if (!response.is_object())
+                throw error(error::document_unavailable);
+
+            if (response.is_member("error") && response.is_member("reason"))
+            {
+#ifdef CPPCOUCH_DEBUG
+                std::cout << "Could not create attachment \"" + attachmentId + "\": " + response["reason"].get_string();
+#else
+                (void) attachmentId;
+#endif
+                throw error(error::attachment_not_creatable, response["reason"].get_string());
+            }
+
+            if (!response["ok"].get_bool())
+                throw error(error::attachment_not_creatable);
+
+            return response["rev"].get_string();
+        }
+
         std::shared_ptr<base> comm_;
         std::string db_;
         std::string id_;
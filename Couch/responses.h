@@ -0,0 +1,487 @@
+#ifndef CPPCOUCH_RESPONSES_H
+#define CPPCOUCH_RESPONSES_H
+
+#include "shared.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace couchdb
+{
+    /* Response structures - Plain structures for the fixed-layout responses CouchDB sends most often,
+     * and decoders that read each layout straight into its structure, without building a json::value first.
+     *
+     * A decoder returns false if the text is not exactly the layout it expects (an unknown or missing member,
+     * a member of another type, a string with escape sequences, etc.), and the caller should then fall back
+     * to the generic parser. The decoders never throw.
+     */
+
+    // The result of writing a single document, as returned by a document PUT or POST, or in the array from '/_bulk_docs'
+    // Either `ok` is set along with `id` and `rev`, or `error` and `reason` describe why the write failed
+    struct write_result
+    {
+        write_result() : ok(false) {}
+
+        // Reads the result from a generically parsed response
+        explicit write_result(const json::value &result)
+            : ok(result["ok"].get_bool())
+            , id(result["id"].get_string())
+            , rev(result["rev"].get_string())
+            , error(result["error"].get_string())
+            , reason(result["reason"].get_string())
+        {}
+
+        // Returns the result as CouchDB sent it
+        json::value to_json() const
+        {
+            json::value result = json::object_t();
+
+            if (ok)
+                result["ok"] = true;
+            if (!id.empty())
+                result["id"] = id;
+            if (!rev.empty())
+                result["rev"] = rev;
+            if (!ok)
+            {
+                result["error"] = error;
+                result["reason"] = reason;
+            }
+
+            return result;
+        }
+
+        bool ok;
+        std::string id;
+        std::string rev;
+        std::string error;
+        std::string reason;
+    };
+
+    // A row of '/_all_docs', without an included document
+    struct all_docs_row
+    {
+        std::string id;
+        std::string key;
+        std::string rev;
+    };
+
+    // The response of '/_all_docs'
+    struct all_docs_result
+    {
+        all_docs_result() : total_rows(0), offset(0) {}
+
+        json::int_t total_rows;
+        json::int_t offset;
+        std::vector<all_docs_row> rows;
+    };
+
+    // A single line of a continuous '/_changes' feed, without an included document
+    struct change_row
+    {
+        change_row() : deleted(false) {}
+
+        // Returns the change as CouchDB sent it
+        json::value to_json() const
+        {
+            json::value result = json::object_t(), changes = json::array_t();
+
+            for (const std::string &rev: revs)
+            {
+                json::value change;
+                change["rev"] = rev;
+                changes.push_back(std::move(change));
+            }
+
+            result["seq"] = seq;
+            result["id"] = id;
+            result["changes"] = std::move(changes);
+            if (deleted)
+                result["deleted"] = true;
+
+            return result;
+        }
+
+        json::value seq; // An integer before CouchDB 2.0, and a string since
+        std::string id;
+        std::vector<std::string> revs;
+        bool deleted;
+    };
+
+    // Reads the tokens of a fixed-layout response, for use by the decoders below
+    // Every read skips leading whitespace first, and returns false if the expected token is not next
+    class fixed_layout_reader
+    {
+    public:
+        fixed_layout_reader(const char *str, size_t length) : p_(str), end_(str + length) {}
+
+        // Consumes `c` if it is the next character
+        bool consume(char c)
+        {
+            skip_whitespace();
+            if (p_ == end_ || *p_ != c)
+                return false;
+
+            ++p_;
+            return true;
+        }
+
+        // Reads a string that contains no escape sequences, setting `str` to its contents within the text
+        // Checks for valid UTF-8 unless CPPCOUCH_NO_UTF8_VALIDATION is defined, as the generic parser does
+        bool read_string(const char *&str, size_t &length)
+        {
+            if (!consume('"'))
+                return false;
+
+            for (const char *p = p_; p != end_; ++p)
+            {
+                if (*p == '"')
+                {
+                    if (validate_response_utf8 && !json::is_valid_utf8(p_, p - p_))
+                        return false;
+
+                    str = p_;
+                    length = p - p_;
+                    p_ = p + 1;
+                    return true;
+                }
+                else if (*p == '\\' || static_cast<unsigned char>(*p) < 0x20)
+                    return false;
+            }
+
+            return false;
+        }
+
+        bool read_string(std::string &str)
+        {
+            const char *s;
+            size_t length;
+            if (!read_string(s, length))
+                return false;
+
+            str.assign(s, length);
+            return true;
+        }
+
+        // Reads an object member name and the colon that follows it
+        bool read_key(const char *&key, size_t &length) {return read_string(key, length) && consume(':');}
+
+        bool read_bool(bool &b)
+        {
+            skip_whitespace();
+            if (end_ - p_ >= 4 && memcmp(p_, "true", 4) == 0)
+                b = true, p_ += 4;
+            else if (end_ - p_ >= 5 && memcmp(p_, "false", 5) == 0)
+                b = false, p_ += 5;
+            else
+                return false;
+
+            return true;
+        }
+
+        // Reads an integer, failing on numbers with a fraction or exponent
+        bool read_int(json::int_t &i)
+        {
+            skip_whitespace();
+
+            const char *start = p_, *p = p_;
+            if (p != end_ && *p == '-')
+                ++p;
+            while (p != end_ && *p >= '0' && *p <= '9')
+                ++p;
+
+            if (p != end_ && (*p == '.' || *p == 'e' || *p == 'E'))
+                return false;
+            if (!json::parse_int(start, p, i))
+                return false;
+
+            p_ = p;
+            return true;
+        }
+
+        // Returns true if only whitespace remains
+        bool at_end()
+        {
+            skip_whitespace();
+            return p_ == end_;
+        }
+
+        // Returns true if the member name `key` of length `length` is `name`
+        template<size_t N>
+        static bool key_is(const char *key, size_t length, const char (&name)[N])
+        {
+            return length == N - 1 && memcmp(key, name, N - 1) == 0;
+        }
+
+    private:
+        void skip_whitespace()
+        {
+            while (p_ != end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' || *p_ == '\t'))
+                ++p_;
+        }
+
+        const char *p_;
+        const char *end_;
+    };
+
+    // Reads a single write result object
+    inline bool read_write_result(fixed_layout_reader &reader, write_result &result)
+    {
+        bool has_ok = false;
+        const char *key;
+        size_t length;
+
+        result = write_result();
+        if (!reader.consume('{'))
+            return false;
+
+        do
+        {
+            if (!reader.read_key(key, length))
+                return false;
+
+            if (fixed_layout_reader::key_is(key, length, "ok"))
+            {
+                if (!reader.read_bool(result.ok))
+                    return false;
+                has_ok = true;
+            }
+            else if (fixed_layout_reader::key_is(key, length, "id"))
+            {
+                if (!reader.read_string(result.id))
+                    return false;
+            }
+            else if (fixed_layout_reader::key_is(key, length, "rev"))
+            {
+                if (!reader.read_string(result.rev))
+                    return false;
+            }
+            else if (fixed_layout_reader::key_is(key, length, "error"))
+            {
+                if (!reader.read_string(result.error))
+                    return false;
+            }
+            else if (fixed_layout_reader::key_is(key, length, "reason"))
+            {
+                if (!reader.read_string(result.reason))
+                    return false;
+            }
+            else
+                return false;
+        } while (reader.consume(','));
+
+        if (!reader.consume('}'))
+            return false;
+
+        // Exactly one of the success or failure layouts must have been read
+        if (has_ok)
+            return result.ok && !result.id.empty() && !result.rev.empty() && result.error.empty();
+        return !result.error.empty();
+    }
+
+    // Reads an '/_all_docs' row, which must have an id, a string key, and a value containing only a revision
+    inline bool read_all_docs_row(fixed_layout_reader &reader, all_docs_row &row)
+    {
+        bool has_id = false, has_key = false, has_rev = false;
+        const char *key;
+        size_t length;
+
+        if (!reader.consume('{'))
+            return false;
+
+        do
+        {
+            if (!reader.read_key(key, length))
+                return false;
+
+            if (fixed_layout_reader::key_is(key, length, "id"))
+            {
+                if (!reader.read_string(row.id))
+                    return false;
+                has_id = true;
+            }
+            else if (fixed_layout_reader::key_is(key, length, "key"))
+            {
+                if (!reader.read_string(row.key))
+                    return false;
+                has_key = true;
+            }
+            else if (fixed_layout_reader::key_is(key, length, "value"))
+            {
+                if (!reader.consume('{') ||
+                    !reader.read_key(key, length) ||
+                    !fixed_layout_reader::key_is(key, length, "rev") ||
+                    !reader.read_string(row.rev) ||
+                    !reader.consume('}'))
+                    return false;
+                has_rev = true;
+            }
+            else
+                return false;
+        } while (reader.consume(','));
+
+        return reader.consume('}') && has_id && has_key && has_rev;
+    }
+
+    // Decodes the response to a single document write, either `{"ok":true,"id":...,"rev":...}` or `{"error":...,"reason":...}`
+    inline bool decode_write_result(const char *str, size_t length, write_result &result)
+    {
+        fixed_layout_reader reader(str, length);
+        return read_write_result(reader, result) && reader.at_end();
+    }
+
+    // Decodes the array of write results returned by '/_bulk_docs'
+    inline bool decode_write_results(const char *str, size_t length, std::vector<write_result> &results)
+    {
+        fixed_layout_reader reader(str, length);
+
+        results.clear();
+        if (!reader.consume('['))
+            return false;
+
+        if (!reader.consume(']'))
+        {
+            do
+            {
+                results.emplace_back();
+                if (!read_write_result(reader, results.back()))
+                    return false;
+            } while (reader.consume(','));
+
+            if (!reader.consume(']'))
+                return false;
+        }
+
+        return reader.at_end();
+    }
+
+    // Decodes a plain '/_all_docs' listing, where every row has the layout `{"id":...,"key":...,"value":{"rev":...}}`
+    inline bool decode_all_docs(const char *str, size_t length, all_docs_result &result)
+    {
+        fixed_layout_reader reader(str, length);
+        bool has_total_rows = false, has_rows = false;
+        const char *key;
+        size_t key_length;
+
+        result = all_docs_result();
+        if (!reader.consume('{'))
+            return false;
+
+        do
+        {
+            if (!reader.read_key(key, key_length))
+                return false;
+
+            if (fixed_layout_reader::key_is(key, key_length, "total_rows"))
+            {
+                if (!reader.read_int(result.total_rows))
+                    return false;
+                has_total_rows = true;
+            }
+            else if (fixed_layout_reader::key_is(key, key_length, "offset"))
+            {
+                if (!reader.read_int(result.offset))
+                    return false;
+            }
+            else if (fixed_layout_reader::key_is(key, key_length, "rows"))
+            {
+                if (!reader.consume('['))
+                    return false;
+
+                if (!reader.consume(']'))
+                {
+                    do
+                    {
+                        result.rows.emplace_back();
+                        if (!read_all_docs_row(reader, result.rows.back()))
+                            return false;
+                    } while (reader.consume(','));
+
+                    if (!reader.consume(']'))
+                        return false;
+                }
+                has_rows = true;
+            }
+            else
+                return false;
+        } while (reader.consume(','));
+
+        return reader.consume('}') && reader.at_end() && has_total_rows && has_rows;
+    }
+
+    // Decodes a line of a continuous '/_changes' feed with the layout `{"seq":...,"id":...,"changes":[{"rev":...},...]}`,
+    // optionally followed by `"deleted":true`
+    inline bool decode_change(const char *str, size_t length, change_row &change)
+    {
+        fixed_layout_reader reader(str, length);
+        bool has_seq = false, has_id = false, has_changes = false;
+        const char *key;
+        size_t key_length;
+
+        change = change_row();
+        if (!reader.consume('{'))
+            return false;
+
+        do
+        {
+            if (!reader.read_key(key, key_length))
+                return false;
+
+            if (fixed_layout_reader::key_is(key, key_length, "seq"))
+            {
+                const char *seq;
+                size_t seq_length;
+                json::int_t i;
+
+                if (reader.read_string(seq, seq_length))
+                    change.seq = json::string_t(seq, seq_length);
+                else if (reader.read_int(i))
+                    change.seq = i;
+                else
+                    return false;
+                has_seq = true;
+            }
+            else if (fixed_layout_reader::key_is(key, key_length, "id"))
+            {
+                if (!reader.read_string(change.id))
+                    return false;
+                has_id = true;
+            }
+            else if (fixed_layout_reader::key_is(key, key_length, "changes"))
+            {
+                if (!reader.consume('['))
+                    return false;
+
+                if (!reader.consume(']'))
+                {
+                    do
+                    {
+                        change.revs.emplace_back();
+                        if (!reader.consume('{') ||
+                            !reader.read_key(key, key_length) ||
+                            !fixed_layout_reader::key_is(key, key_length, "rev") ||
+                            !reader.read_string(change.revs.back()) ||
+                            !reader.consume('}'))
+                            return false;
+                    } while (reader.consume(','));
+
+                    if (!reader.consume(']'))
+                        return false;
+                }
+                has_changes = true;
+            }
+            else if (fixed_layout_reader::key_is(key, key_length, "deleted"))
+            {
+                if (!reader.read_bool(change.deleted))
+                    return false;
+            }
+            else
+                return false;
+        } while (reader.consume(','));
+
+        return reader.consume('}') && reader.at_end() && has_seq && has_id && has_changes;
+    }
+}
+
+#endif // CPPCOUCH_RESPONSES_H
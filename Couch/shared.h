@@ -2,11 +2,26 @@
 #define CPPCOUCH_SHARED_H
 
 #include "../String/string_tools.h"
+
 #include <json.h>
+#include <json_scanner.h>
+
+// Typed documents (structs described with JSON_MAPPING) are supported under C++17
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <json_mapping.h>
+#define CPPCOUCH_TYPED_DOCUMENTS
+#endif
 #include <sstream>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <functional>
+#include <future>
+#include <exception>
+
+#if defined(CPPCOUCH_JSON_SCANNER) && !defined(CPPCOUCH_JSON_SCANNER_THRESHOLD)
+#define CPPCOUCH_JSON_SCANNER_THRESHOLD 65536
+#endif
 
 namespace couchdb
 {
@@ -20,6 +35,7 @@ namespace couchdb
 
     /* http_client_base class - Provides a base class for the network implementation.
      * All overloads must implement the specified API.
+     * The API may be called by several threads at once, if the communication object using it is shared between threads.
      */
     template<typename http_url_type_t, typename http_client_timeout_duration_t = int, typename http_client_timeout_mode_t = int, typename http_client_response_handle_t = int>
     struct http_client_base
@@ -38,6 +54,14 @@ namespace couchdb
         //         ...
         //     };
         typedef http_client_base<duration_type, mode_type> type;
+        // Receives a response body piece by piece, as passed to stream_response()
+        typedef std::function<void (const char *data, size_t length)> body_handler_type;
+        // Receives the outcome of async_request(), which is the return value and outputs of operator()
+        typedef std::function<void (int status,
+                                    std::map<std::string, std::string> &headers,
+                                    std::string &response_buffer,
+                                    bool network_error,
+                                    const std::string &error_description)> completion_handler_type;
         // Define the following to true if you want caching enabled
         virtual bool allow_cached_responses() const = 0;
         // Define the following to the invalid response handle (i.e. NULL, perhaps)
@@ -106,6 +130,53 @@ namespace couchdb
                                         bool &network_error,
                                         std::string &error_description) = 0;
 
+        /* Identical to operator(), except that the body of the response is passed to `body_handler` in pieces
+         * as it arrives, instead of being collected into a buffer. `body_handler` may be called any number of times.
+         *
+         * The default implementation reads the whole response with operator() and passes it on at once.
+         * Implementations should override this to let the response be processed while it is still being received.
+         */
+        virtual int stream_response(const std::string &url,
+                                    http_client_timeout_duration_t timeout,
+                                    http_client_timeout_mode_t timeout_mode,
+                                    std::map<std::string, std::string> &headers,
+                                    const std::string &method,
+                                    const std::string &data,
+                                    const body_handler_type &body_handler,
+                                    bool &network_error,
+                                    std::string &error_description)
+        {
+            std::string response_buffer;
+            int status = (*this)(url, timeout, timeout_mode, headers, method, data, response_buffer, network_error, error_description);
+            if (!response_buffer.empty())
+                body_handler(response_buffer.data(), response_buffer.size());
+            return status;
+        }
+
+        /* Identical to operator(), except that it returns once the request is started, and the outputs of operator()
+         * are passed to `handler` when the response has arrived. `handler` must be called exactly once, and may be called
+         * on another thread.
+         * `handler` should only start further requests with async_request(), since an implementation that calls it on
+         * an event loop thread cannot wait on that thread for a synchronous response, and fails such a request instead.
+         *
+         * The default implementation calls operator() and then `handler` before returning.
+         * Implementations with an event loop should override this, so a single thread can keep many requests in flight.
+         */
+        virtual void async_request(const std::string &url,
+                                   http_client_timeout_duration_t timeout,
+                                   http_client_timeout_mode_t timeout_mode,
+                                   const std::map<std::string, std::string> &headers,
+                                   const std::string &method,
+                                   const std::string &data,
+                                   const completion_handler_type &handler)
+        {
+            std::map<std::string, std::string> response_headers(headers);
+            std::string response_buffer, error_description;
+            bool network_error = false;
+            int status = (*this)(url, timeout, timeout_mode, response_headers, method, data, response_buffer, network_error, error_description);
+            handler(status, response_headers, response_buffer, network_error, error_description);
+        }
+
         /* Read a line from a response handle.
          * Either blocks until a line is available, or returns an empty line if no lines are available
          * (It doesn't matter which, it just helps the managing thread to shut the feed down sooner
@@ -346,6 +417,64 @@ namespace couchdb
         std::string str;
     };
 
+    /* async_result class - The outcome of an asynchronous operation, either its result or the exception it failed with.
+     */
+
+    template<typename T>
+    class async_result
+    {
+    public:
+        explicit async_result(T &&result) : result_(new T(std::move(result))) {}
+        explicit async_result(std::exception_ptr error) : error_(error) {}
+
+        // Returns true if the operation failed
+        bool failed() const {return error_ != nullptr;}
+        // Returns the exception the operation failed with, or null if it succeeded
+        std::exception_ptr error() const {return error_;}
+
+        // Returns the result, or rethrows the exception the operation failed with
+        T &get()
+        {
+            if (error_)
+                std::rethrow_exception(error_);
+            return *result_;
+        }
+
+    private:
+        std::unique_ptr<T> result_;
+        std::exception_ptr error_;
+    };
+
+    // Receives the outcome of an asynchronous operation
+    template<typename T>
+    using async_handler = std::function<void (async_result<T> &&result)>;
+
+    // Returns the outcome of calling `f`
+    template<typename T, typename F>
+    async_result<T> capture_async_result(F f)
+    {
+        try {return async_result<T>(f());}
+        catch (...) {return async_result<T>(std::current_exception());}
+    }
+
+    // Starts an asynchronous operation by passing `start` a handler for its outcome, and returns a future for the outcome
+    template<typename T, typename Start>
+    std::future<T> async_future(Start start)
+    {
+        std::shared_ptr<std::promise<T>> promise = std::make_shared<std::promise<T>>();
+        std::future<T> future = promise->get_future();
+
+        start(async_handler<T>([promise](async_result<T> &&result)
+        {
+            if (result.failed())
+                promise->set_exception(result.error());
+            else
+                promise->set_value(std::move(result.get()));
+        }));
+
+        return future;
+    }
+
     //general function to encode a URL
     inline std::string url_encode(const std::string &url)
     {
@@ -470,18 +599,125 @@ namespace couchdb
         return ret;
     }
 
+    // Response bodies are checked for valid UTF-8 as they are parsed, unless CPPCOUCH_NO_UTF8_VALIDATION is defined
+#ifdef CPPCOUCH_NO_UTF8_VALIDATION
+    static const bool validate_response_utf8 = false;
+#else
+    static const bool validate_response_utf8 = true;
+#endif
+
+    // Returns the error thrown for a response body that is not valid UTF-8
+    inline error invalid_utf8_response()
+    {
+        return error(error::bad_response, "The server returned a response that is not valid UTF-8");
+    }
+
+    // Converts string to JSON value
+    // Returns a null value if it is not valid JSON, and throws error::bad_response if it is not valid UTF-8
+    inline json::value string_to_json(const char *str, size_t length)
+    {
+        try
+        {
+            json::value v;
+#ifdef CPPCOUCH_JSON_SCANNER
+            // Large responses (view results, _all_docs listings, etc.) are parsed with the structural scanner
+            if (length >= CPPCOUCH_JSON_SCANNER_THRESHOLD)
+                json::structural_index(str, length).validate_utf8(validate_response_utf8).parse(v);
+            else
+#endif
+                json::parser(str, length).validate_utf8(validate_response_utf8).parse_all(v);
+            return v;
+        }
+        catch (const json::utf8_error &) {throw invalid_utf8_response();}
+        catch (json::error) {return json::value();}
+    }
+
+#ifdef JSON_PMR
+    // Converts string to JSON value, allocating its arrays and objects from `resource`
+    inline json::value string_to_json(const char *str, size_t length, json::memory_resource *resource)
+    {
+        try
+        {
+            json::value v(resource);
+#ifdef CPPCOUCH_JSON_SCANNER
+            if (length >= CPPCOUCH_JSON_SCANNER_THRESHOLD)
+                json::structural_index(str, length).validate_utf8(validate_response_utf8).parse(v);
+            else
+#endif
+                json::parser(str, length).validate_utf8(validate_response_utf8).parse_all(v);
+            return v;
+        }
+        catch (const json::utf8_error &) {throw invalid_utf8_response();}
+        catch (json::error) {return json::value(resource);}
+    }
+#endif
+
     // Converts string to JSON value
     inline json::value string_to_json(const std::string &str)
     {
-        try {return json::from_json(str);}
+        return string_to_json(str.data(), str.size());
+    }
+
+    // Converts a response body to a JSON value whose strings are borrowed from the body, rather than copied out of it
+    // Returns a null value if it is not valid JSON, and throws error::bad_response if it is not valid UTF-8
+    inline json::borrowed_value string_to_borrowed_json(const std::shared_ptr<const std::string> &str)
+    {
+        try {return json::borrowed_value(str, validate_response_utf8);}
+        catch (const json::utf8_error &) {throw invalid_utf8_response();}
+        catch (json::error) {return json::borrowed_value();}
+    }
+
+    // Indexes a response body for lazy access, so only the members that are read are decoded
+    // Returns a null value if it is not valid JSON
+    // Strings are checked for valid UTF-8 as they are read, and reading one that is not throws json::utf8_error
+    inline json::lazy_value string_to_lazy_json(const std::shared_ptr<const std::string> &str)
+    {
+        try {return json::lazy_value(str, validate_response_utf8);}
+        catch (json::error) {return json::lazy_value();}
+    }
+
+    // Converts a response containing a "rows" array (such as a view or _all_docs) to a JSON value,
+    // parsing the rows on `threads` threads at once (or one per hardware thread if `threads` is zero)
+    // Returns a null value if it is not valid JSON, and throws error::bad_response if it is not valid UTF-8
+    inline json::value string_to_json_parallel(const char *str, size_t length, size_t threads)
+    {
+        try
+        {
+            json::value v;
+            json::structural_index(str, length).validate_utf8(validate_response_utf8).parse_parallel(v, "rows", threads);
+            return v;
+        }
+        catch (const json::utf8_error &) {throw invalid_utf8_response();}
         catch (json::error) {return json::value();}
     }
 
+    // Parses a response containing a "rows" array (such as a view or _all_docs), passing each row to `callback`
+    // in turn instead of building the whole response
+    // If `fields` is not empty, only the parts of each row it selects are built
+    // Returns the response without its rows, or null if it is not valid JSON, and throws error::bad_response if it is not valid UTF-8
+    inline json::value string_to_json_rows(const char *str, size_t length, const json::rows_handler::callback_type &callback,
+                                           const json::projection &fields = json::projection())
+    {
+        json::rows_handler handler(callback, fields);
+
+        try {json::parser(str, length).validate_utf8(validate_response_utf8).parse_all_events(handler);}
+        catch (const json::utf8_error &) {throw invalid_utf8_response();}
+        catch (json::error) {return json::value();}
+
+        return std::move(handler.header());
+    }
+
     // Converts JSON value to string
     inline std::string json_to_string(const json::value &val)
     {
         return json::to_json(val);
     }
+
+    // Appends JSON value to string, so the string's storage can be reused
+    inline std::string &json_to_string(const json::value &val, std::string &out)
+    {
+        return json::to_json(val, out);
+    }
 }
 
 #endif // CPPCOUCH_SHARED_H
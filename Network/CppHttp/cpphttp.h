@@ -56,6 +56,14 @@
 
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #ifdef BOOST_WINDOWS
 # include <windows.h>
@@ -1314,7 +1322,10 @@ namespace CppHttp
                 , upload_progress_callback()
                 , download_progress_callback()
                 , partial_response_type(ResponseWhole)
+                , buffer_response_body(true)
                 , in_progress(false)
+                , own_io_serv(new boost::asio::io_service)
+                , io_serv(*own_io_serv)
                 , resolver_(io_serv)
 #ifdef ENABLE_SSL
                 , sock_ctx()
@@ -1348,7 +1359,10 @@ namespace CppHttp
                 , upload_progress_callback()
                 , download_progress_callback()
                 , partial_response_type(ResponseWhole)
+                , buffer_response_body(true)
                 , in_progress(false)
+                , own_io_serv(new boost::asio::io_service)
+                , io_serv(*own_io_serv)
                 , resolver_(io_serv)
 #ifdef ENABLE_SSL
                 , sock_ctx()
@@ -1383,7 +1397,10 @@ namespace CppHttp
                 , upload_progress_callback()
                 , download_progress_callback()
                 , partial_response_type(ResponseWhole)
+                , buffer_response_body(true)
                 , in_progress(false)
+                , own_io_serv(new boost::asio::io_service)
+                , io_serv(*own_io_serv)
                 , resolver_(io_serv)
 #ifdef ENABLE_SSL
                 , sock_ctx()
@@ -1404,6 +1421,46 @@ namespace CppHttp
             {
                 connect(request);
             }
+            // Creates a connection that runs on `service`, which is shared with other connections and run by its owner
+            // The blocking wait_for_*(), run*() and poll*() functions must not be used with such a connection,
+            // and it must not be destroyed until the handlers it has started on `service` have run
+            Connection(boost::asio::io_service &service, const boost::posix_time::time_duration &timeout = boost::posix_time::pos_infin)
+                : do_not_poll(false)
+                , connect_callback(DefaultConnectHandler)
+                , disconnect_callback()
+                , request_callback()
+                , response_callback()
+                , partial_response_callback()
+                , destructor_callback()
+#ifdef ENABLE_SSL
+                , verify_callback()
+#endif
+                , upload_progress_callback()
+                , download_progress_callback()
+                , partial_response_type(ResponseWhole)
+                , buffer_response_body(true)
+                , in_progress(false)
+                , own_io_serv()
+                , io_serv(service)
+                , resolver_(io_serv)
+#ifdef ENABLE_SSL
+                , sock_ctx()
+                , sock_secure(false)
+                , ssock()
+#endif
+                , sock()
+                , running_(false)
+                , reconnect_if_aborted(false)
+                , reconnecting_(false)
+                , connect_work()
+                , connection_work()
+                , transaction_work()
+                , timeout_mode_(TimeoutPerOperation)
+                , timeout_(timeout)
+                , deadline_(io_serv)
+                , deadline_running_(false)
+            {
+            }
             ~Connection()
             {
                 disconnectImmediately();
@@ -1650,11 +1707,16 @@ namespace CppHttp
             }
             // Stops the asynchronous jobs in this connection
             // Can be invoked in any handler
+            // Does nothing if the connection runs on a shared io_service, which only its owner may stop
             void stop()
             {
-                io_serv.stop();
+                if (own_io_serv)
+                    io_serv.stop();
             }
 
+            // Returns true if the connection runs on a shared io_service
+            bool sharesIoService() const {return !own_io_serv;}
+
             const std::string &host() const {return host_;}
             const std::string &topLevelDomain() const {return topLevel_;}
             const std::string &service() const {return service_;}
@@ -1925,6 +1987,40 @@ namespace CppHttp
             // Whether the connection is busy, e.g. processing a request/response transfer.
             bool busy() const {return in_progress;}
 
+            // Whether an idle connection may be used for another request: it must still be open, and the server must
+            // not have closed its end (or, for an unsecured connection, sent anything) since the last response.
+            // Must be called from the thread running the io_service
+            bool reusable()
+            {
+                if (!connected() || busy())
+                    return false;
+
+                bool secure = false;
+                tcp::socket *socket = sock.get();
+#ifdef ENABLE_SSL
+                if (ssock)
+                {
+                    socket = &ssock->next_layer();
+                    secure = true;
+                }
+#endif
+
+                // Peek without blocking: nothing to read means the connection is alive and idle
+                boost::system::error_code err, ignored_ec;
+                char c;
+                socket->non_blocking(true, err);
+                if (err)
+                    return false;
+                size_t length = socket->receive(boost::asio::buffer(&c, 1), tcp::socket::message_peek, err);
+                socket->non_blocking(false, ignored_ec);
+
+                if (err == boost::asio::error::would_block)
+                    return true;
+
+                // Data on an idle secured connection may be TLS session messages, which the next read will handle
+                return secure && !err && length > 0;
+            }
+
             // Clears the error raised in the connection. The error is only cleared
             // automatically when initiating a new connection.
             void clearError() {ec = boost::system::error_code(); emessage.clear();}
@@ -1938,6 +2034,7 @@ namespace CppHttp
             DisconnectHandler disconnectHandler() const {return disconnect_callback;}
             RequestHandler requestHandler() const {return request_callback;}
             ResponseHandler responseHandler() const {return response_callback;}
+            ResponseHandler headersHandler() const {return headers_callback;}
             ResponseHandler partialResponseHandler() const {return partial_response_callback;}
             ResponseType partialResponseType() const {return partial_response_type;}
             DestructorHandler destructorHandler() const {return destructor_callback;}
@@ -1950,6 +2047,8 @@ namespace CppHttp
             void setDisconnectHandler(DisconnectHandler handler) {disconnect_callback = handler;}
             void setRequestHandler(RequestHandler handler) {request_callback = handler;}
             void setResponseHandler(ResponseHandler handler) {response_callback = handler;}
+            // The headers handler is called with the status and headers of the response, before its body is read
+            void setHeadersHandler(ResponseHandler handler) {headers_callback = handler;}
             void setPartialResponseHandler(ResponseHandler handler) {partial_response_callback = handler;}
             void setPartialResponseType(ResponseType type) {partial_response_type = type;}
             void setDestructorHandler(DestructorHandler handler) {destructor_callback = handler;}
@@ -1959,6 +2058,11 @@ namespace CppHttp
             void setVerifyHandler(VerifyHandler handler) {verify_callback = handler;}
 #endif
 
+            // Set/get whether the response body is collected into response().body() (the default)
+            // Disable this when the body is consumed by a partial response handler or an output stream as it arrives
+            void setBufferResponseBody(bool buffer) {buffer_response_body = buffer;}
+            bool bufferResponseBody() const {return buffer_response_body;}
+
             // Set/get timeout interval and mode
             // The settings go into effect immediately after the current timeout cycle ends
             void setTimeout(boost::posix_time::time_duration timeout) {timeout_ = timeout;}
@@ -2662,6 +2766,13 @@ namespace CppHttp
                         trailer_iterator = response_.headers().find("trailer");
                     }
 
+                    if (!headers_callback.empty())
+                    {
+                        do_not_poll = true;
+                        headers_callback(*this, response_, ec);
+                        do_not_poll = false;
+                    }
+
                     // Handle cases where there should be no message body
                     total_size = chunk_size = 0;
                     if (method == "HEAD" || (method == "CONNECT" && response_.group() == 2) ||
@@ -2804,10 +2915,10 @@ namespace CppHttp
                     boost::asio::streambuf::const_buffers_type bufs = response_buf.data();
                     std::string chunk = std::string(boost::asio::buffers_begin(bufs),
                                                     boost::asio::buffers_begin(bufs) + chunk_size);
-                    if (request_.ostream() == NULL)
-                        response_.body() += chunk;
-                    else
+                    if (request_.ostream() != NULL)
                         *request_.ostream() << chunk;
+                    else if (buffer_response_body)
+                        response_.body() += chunk;
 
                     total_size += chunk_size;
 
@@ -2998,10 +3109,10 @@ namespace CppHttp
                         std::string chunk = std::string(boost::asio::buffers_begin(bufs),
                                                         boost::asio::buffers_begin(bufs) + size);
 
-                        if (request_.ostream() == NULL)
-                            response_.body() += chunk;
-                        else
+                        if (request_.ostream() != NULL)
                             *request_.ostream() << chunk;
+                        else if (buffer_response_body)
+                            response_.body() += chunk;
 
                         response_buf.consume((size_t) size);
                         chunk_size -= size;
@@ -3073,10 +3184,10 @@ namespace CppHttp
                     boost::asio::streambuf::const_buffers_type bufs = response_buf.data();
                     std::string chunk = std::string(boost::asio::buffers_begin(bufs),
                                                     boost::asio::buffers_begin(bufs) + response_buf.size());
-                    if (request_.ostream() == NULL)
-                        response_.body() += chunk;
-                    else
+                    if (request_.ostream() != NULL)
                         *request_.ostream() << chunk;
+                    else if (buffer_response_body)
+                        response_.body() += chunk;
 
                     total_size += response_buf.size();
                     response_buf.consume(response_buf.size());
@@ -3212,6 +3323,7 @@ namespace CppHttp
             DisconnectHandler disconnect_callback;
             RequestHandler request_callback;
             ResponseHandler response_callback;
+            ResponseHandler headers_callback;
             ResponseHandler partial_response_callback;
             DestructorHandler destructor_callback;
 #ifdef ENABLE_SSL
@@ -3220,6 +3332,7 @@ namespace CppHttp
             UploadProgressHandler upload_progress_callback;
             DownloadProgressHandler download_progress_callback;
             ResponseType partial_response_type;
+            bool buffer_response_body; // Whether the response body is collected into response().body()
 
             std::string topLevel_; // Contains "scheme://host[:port]"
             std::string host_; // Contains host (server) name or address
@@ -3241,7 +3354,8 @@ namespace CppHttp
             Headers::iterator lcase_trailer_iterator;
 
             // Local network/buffer objects
-            boost::asio::io_service io_serv;
+            std::unique_ptr<boost::asio::io_service> own_io_serv; // Null if the io_service is shared
+            boost::asio::io_service &io_serv;
             tcp::resolver resolver_;
 #ifdef ENABLE_SSL
             std::shared_ptr<boost::asio::ssl::context> sock_ctx;
@@ -3271,6 +3385,559 @@ namespace CppHttp
 
         typedef std::shared_ptr<Connection> ConnectionPtr;
 
+        class EventLoop;
+
+        /* ConnectionPool class - Keeps the connections of the event loops of a ConnectionManager open between requests.
+         *
+         * Connections are pooled by server: the scheme, host, and port, with the default port filled in. A request takes
+         * the most recently used idle connection to its server, or else opens a new one, or else, if its server already has
+         * the maximum number of connections, waits for one to be returned. Idle connections are closed after the idle timeout.
+         *
+         * The pool may be used from any thread, but each connection is only used on the thread of its event loop.
+         */
+        class ConnectionPool : public boost::noncopyable
+        {
+            struct IdleConnection
+            {
+                IdleConnection(const std::shared_ptr<EventLoop> &loop, ConnectionPtr c)
+                    : loop(loop)
+                    , c(c)
+                    , since(boost::posix_time::microsec_clock::universal_time())
+                {}
+
+                std::weak_ptr<EventLoop> loop;
+                ConnectionPtr c;
+                boost::posix_time::ptime since;
+            };
+
+        public:
+            // Starts a request on the event loop `loop`, with the idle connection `c`, or a new connection if `c` is null
+            typedef boost::function<void (const std::shared_ptr<EventLoop> &loop, ConnectionPtr c)> Start;
+
+            struct Statistics
+            {
+                Statistics() : hits(0), misses(0), waits(0), evictions(0), open(0), idle(0) {}
+
+                size_t hits; // Requests sent on an idle connection
+                size_t misses; // Requests sent on a new connection (hits + misses is the number of requests sent)
+                size_t waits; // Requests that waited for a connection, because their server had the maximum number of connections
+                size_t evictions; // Idle connections closed, because they timed out or the server had closed them
+                size_t open; // Connections open, opening, or waited for
+                size_t idle; // Connections open and idle
+            };
+
+            ConnectionPool() : max_per_host_(0), idle_timeout_(boost::posix_time::seconds(30)) {}
+
+            // Returns the server a URL is pooled by, as "scheme://host:port", in lowercase
+            static std::string key(const Uri &url)
+            {
+                const std::string scheme = boost::to_lower_copy(url.scheme());
+                int port = url.port();
+                if (port < 0)
+                    port = scheme == "https"? 443: scheme == "http"? 80: -1;
+
+                return scheme + "://" + boost::to_lower_copy(url.host()) + ":" + (port < 0? scheme: boost::lexical_cast<std::string>(port));
+            }
+
+            // Limits the number of connections to each server, or removes the limit if zero (the default)
+            // Lowering the limit does not close connections already open
+            void setMaxConnectionsPerHost(size_t max)
+            {
+                std::vector<Waiter> started;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    max_per_host_ = max;
+                    for (auto it = hosts_.begin(); it != hosts_.end(); ++it)
+                        while (!it->second.waiting.empty() && hasRoom(it->second))
+                            started.push_back(openFor(it->second));
+                }
+
+                for (size_t i = 0; i < started.size(); ++i)
+                    started[i].start(started[i].loop, ConnectionPtr());
+            }
+            size_t maxConnectionsPerHost() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return max_per_host_;
+            }
+
+            // Sets how long a connection may stay idle before it is closed, or pos_infin to keep idle connections open
+            // The default is 30 seconds. A new timeout takes effect on each event loop once it next returns a connection
+            void setIdleTimeout(const boost::posix_time::time_duration &timeout)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                idle_timeout_ = timeout;
+            }
+            boost::posix_time::time_duration idleTimeout() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return idle_timeout_;
+            }
+
+            Statistics statistics() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                Statistics stats = stats_;
+                for (auto it = hosts_.begin(); it != hosts_.end(); ++it)
+                {
+                    stats.open += it->second.open;
+                    stats.idle += it->second.idle.size();
+                }
+                return stats;
+            }
+
+            // Calls `start` for a request to the server `key`, with an idle connection and its event loop if there is one,
+            // or else with a null connection and `loop` if a new connection may be opened,
+            // or else later, once a connection to the server is returned or closed
+            void checkout(const std::string &key, const std::shared_ptr<EventLoop> &loop, const Start &start)
+            {
+                std::shared_ptr<EventLoop> idle_loop;
+                ConnectionPtr c;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    Host &host = hosts_[key];
+
+                    while (!host.idle.empty() && !c)
+                    {
+                        idle_loop = host.idle.back().loop.lock();
+                        if (idle_loop)
+                            c = host.idle.back().c;
+                        else
+                            --host.open; // The event loop was shut down
+                        host.idle.pop_back();
+                    }
+
+                    if (!c)
+                    {
+                        if (!hasRoom(host))
+                        {
+                            ++stats_.waits;
+                            host.waiting.push_back(Waiter(loop, start));
+                            return;
+                        }
+
+                        ++host.open;
+                        idle_loop = loop;
+                    }
+                }
+
+                start(idle_loop, c);
+            }
+
+            // Records how a request was sent by the event loop: on an idle connection, or on a new one
+            // `replaced` is true if an idle connection was closed instead of used, because the server had closed it
+            void started(bool hit, bool replaced)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++(hit? stats_.hits: stats_.misses);
+                if (replaced)
+                    ++stats_.evictions;
+            }
+
+            // Returns a connection to the server `key` after a request, from the thread of its event loop `loop`,
+            // which passes it to a waiting request, or keeps it idle
+            // Returns true if it is kept idle
+            bool checkin(const std::string &key, const std::shared_ptr<EventLoop> &loop, ConnectionPtr c)
+            {
+                Waiter waiter;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    Host &host = hosts_[key];
+
+                    if (host.waiting.empty())
+                    {
+                        host.idle.push_back(IdleConnection(loop, c));
+                        return true;
+                    }
+
+                    waiter = host.waiting.front();
+                    host.waiting.pop_front();
+                }
+
+                waiter.start(loop, c);
+                return false;
+            }
+
+            // Forgets a connection to the server `key` that was closed, which lets a waiting request open another
+            void discard(const std::string &key)
+            {
+                Waiter waiter;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    Host &host = hosts_[key];
+
+                    if (host.open > 0)
+                        --host.open;
+                    if (host.waiting.empty() || !hasRoom(host))
+                        return;
+
+                    waiter = openFor(host);
+                }
+
+                waiter.start(waiter.loop, ConnectionPtr());
+            }
+
+            // Removes and returns the idle connections of the event loop `loop` that have timed out
+            // `next` is set to the time until the next of its idle connections times out, or to not_a_date_time if it has none
+            std::vector<ConnectionPtr> takeExpired(const EventLoop *loop, boost::posix_time::time_duration &next)
+            {
+                const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+                std::vector<ConnectionPtr> expired;
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                next = boost::posix_time::not_a_date_time;
+                for (auto it = hosts_.begin(); it != hosts_.end(); ++it)
+                {
+                    std::vector<IdleConnection> &idle = it->second.idle;
+                    for (size_t i = 0; i < idle.size(); )
+                    {
+                        std::shared_ptr<EventLoop> idle_loop = idle[i].loop.lock();
+                        if (idle_loop.get() != loop)
+                        {
+                            ++i;
+                            continue;
+                        }
+
+                        const boost::posix_time::time_duration remaining = idle[i].since + idle_timeout_ - now;
+                        if (remaining.is_negative() || remaining.ticks() == 0)
+                        {
+                            expired.push_back(idle[i].c);
+                            idle.erase(idle.begin() + i);
+                            --it->second.open;
+                            ++stats_.evictions;
+                        }
+                        else
+                        {
+                            if (next.is_not_a_date_time() || remaining < next)
+                                next = remaining;
+                            ++i;
+                        }
+                    }
+                }
+
+                return expired;
+            }
+
+            // Forgets every connection and waiting request, which must be done once the event loops are shut down
+            void clear()
+            {
+                std::map<std::string, Host> hosts;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    hosts.swap(hosts_);
+                }
+            }
+
+        private:
+            struct Waiter
+            {
+                Waiter() {}
+                Waiter(const std::shared_ptr<EventLoop> &loop, const Start &start) : loop(loop), start(start) {}
+
+                std::shared_ptr<EventLoop> loop;
+                Start start;
+            };
+
+            struct Host
+            {
+                Host() : open(0) {}
+
+                size_t open; // Counts the connections being opened for waiting requests, since none can be opened before them
+                std::vector<IdleConnection> idle; // The most recently used is last
+                std::deque<Waiter> waiting;
+            };
+
+            bool hasRoom(const Host &host) const {return max_per_host_ == 0 || host.open < max_per_host_;}
+
+            // Takes the first waiting request for `host`, which is about to open a new connection
+            Waiter openFor(Host &host)
+            {
+                Waiter waiter = host.waiting.front();
+                host.waiting.pop_front();
+                ++host.open;
+                return waiter;
+            }
+
+            mutable std::mutex mutex_;
+            std::map<std::string, Host> hosts_;
+            size_t max_per_host_;
+            boost::posix_time::time_duration idle_timeout_;
+            Statistics stats_;
+        };
+
+        /* EventLoop class - An io_service shared by connections that are driven asynchronously, run on a background thread.
+         * This lets a single thread keep many requests in flight.
+         *
+         * The connections are only used on the event loop thread. When a transaction is finished,
+         * its connection is returned to the pool for the next request to the same server if it is still connected.
+         */
+        class EventLoop : public boost::noncopyable, public std::enable_shared_from_this<EventLoop>
+        {
+            struct Transaction
+            {
+                Transaction(Connection::ResponseHandler handler) : handler(handler), done(false) {}
+
+                Connection::ResponseHandler handler;
+                bool done;
+            };
+
+            struct BusyConnection
+            {
+                ConnectionPtr c;
+                std::string key; // The server it is pooled by
+            };
+
+        public:
+            typedef boost::function<void (Connection &c)> SetupHandler;
+
+            explicit EventLoop(std::shared_ptr<ConnectionPool> pool)
+                : work_(new boost::asio::io_service::work(io_serv_))
+                , pool_(pool)
+                , evict_timer_(io_serv_)
+                , evicting_(false)
+            {}
+            ~EventLoop()
+            {
+                if (thread_.joinable())
+                    thread_.detach();
+            }
+
+            boost::asio::io_service &io_service() {return io_serv_;}
+
+            // Returns true if called on the event loop thread
+            bool runningInThisThread()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return thread_.get_id() == std::this_thread::get_id();
+            }
+
+            // Starts running `loop` on a background thread, if it is not running yet
+            // The thread keeps `loop` alive until it is shut down
+            static void start(const std::shared_ptr<EventLoop> &loop)
+            {
+                std::lock_guard<std::mutex> lock(loop->mutex_);
+                if (!loop->thread_.joinable() && loop->work_)
+                    loop->thread_ = std::thread(boost::bind(&EventLoop::run, loop));
+            }
+
+            // Stops the event loop, abandoning the transactions in progress without calling their handlers
+            // Waits for the event loop thread to finish, unless called on it
+            void shutdown()
+            {
+                std::thread thread;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    work_.reset();
+                    thread.swap(thread_);
+                }
+
+                io_serv_.stop();
+                if (!thread.joinable())
+                    return;
+                else if (thread.get_id() == std::this_thread::get_id())
+                {
+                    thread.detach();
+                    return;
+                }
+
+                thread.join();
+                for (auto it = busy_.begin(); it != busy_.end(); ++it)
+                    clearHandlers(*it->second.c);
+                busy_.clear();
+            }
+
+            // Sends `request` with `method` on `c`, an idle connection to the server `key` from the pool, or on a new connection
+            // prepared by `setup` if `c` is null, and calls `handler` once with the response, or with the error that ended the
+            // transaction. The connection is returned to the pool afterward
+            // `prepare`, if set, is called with the connection before the request is sent, and may set handlers that only last
+            // for this transaction, such as a partial response handler
+            // `handler` and `prepare` are called on the event loop thread, and must not block it
+            void asyncRequest(ConnectionPtr c,
+                              const std::string &key,
+                              const Request &request,
+                              const std::string &method,
+                              const boost::posix_time::time_duration &timeout,
+                              Connection::TimeoutMode mode,
+                              Connection::ResponseHandler handler,
+                              SetupHandler setup = SetupHandler(),
+                              SetupHandler prepare = SetupHandler())
+            {
+                std::shared_ptr<EventLoop> self = shared_from_this();
+                io_serv_.post([=] {self->begin(c, key, request, method, timeout, mode, handler, setup, prepare);});
+            }
+
+        private:
+            static void run(std::shared_ptr<EventLoop> loop) {loop->io_serv_.run();}
+
+            // Restores the handlers and settings a transaction may change to their defaults
+            static void clearHandlers(Connection &c)
+            {
+                c.setConnectHandler(Connection::DefaultConnectHandler);
+                c.setDisconnectHandler(Connection::DisconnectHandler());
+                c.setResponseHandler(Connection::ResponseHandler());
+                c.setHeadersHandler(Connection::ResponseHandler());
+                c.setPartialResponseHandler(Connection::ResponseHandler());
+                c.setPartialResponseType(Connection::ResponseWhole);
+                c.setBufferResponseBody(true);
+            }
+
+            // Closes a connection that is not in a transaction, and keeps it until the handlers that closing it cancelled have run
+            void close(ConnectionPtr c)
+            {
+                c->disconnectImmediately();
+                io_serv_.post(boost::bind(&EventLoop::keep, c));
+            }
+            static void keep(ConnectionPtr) {}
+
+            void begin(ConnectionPtr c,
+                       const std::string &key,
+                       const Request &request,
+                       const std::string &method,
+                       const boost::posix_time::time_duration &timeout,
+                       Connection::TimeoutMode mode,
+                       Connection::ResponseHandler handler,
+                       SetupHandler setup,
+                       SetupHandler prepare)
+            {
+                const bool hit = c && c->reusable(), replaced = c && !hit;
+                pool_->started(hit, replaced);
+
+                if (replaced)
+                {
+                    close(c);
+                    c.reset();
+                }
+
+                if (!c)
+                {
+                    c = std::make_shared<Connection>(io_serv_);
+                    c->reconnectOnConnAborted();
+                    if (!setup.empty())
+                        setup(*c);
+                }
+
+                std::shared_ptr<Transaction> t = std::make_shared<Transaction>(handler);
+                BusyConnection &busy = busy_[c.get()];
+                busy.c = c;
+                busy.key = key;
+
+                c->setTimeout(timeout);
+                c->setTimeoutMode(mode);
+                c->setRequest(request, method);
+                c->setConnectHandler(boost::bind(&EventLoop::handleConnect, this, t, _1, _2));
+                c->setDisconnectHandler(boost::bind(&EventLoop::handleDisconnect, this, t, _1, _2));
+                c->setResponseHandler(boost::bind(&EventLoop::finish, this, t, _1, _2, _3));
+                if (!prepare.empty())
+                    prepare(*c);
+
+                if (c->disconnected()? !c->connect(): !c->sendRequest())
+                    finish(t, *c, c->response(), c->error());
+            }
+
+            void handleConnect(std::shared_ptr<Transaction> t, Connection &c, const boost::system::error_code &err)
+            {
+                if (err)
+                    finish(t, c, c.response(), err);
+                else if (!c.sendRequest())
+                    finish(t, c, c.response(), c.error());
+            }
+
+            // The connection was closed before the response arrived, for example by a timeout
+            void handleDisconnect(std::shared_ptr<Transaction> t, Connection &c, const boost::system::error_code &err)
+            {
+                finish(t, c, c.response(), err? err: boost::system::error_code(boost::asio::error::not_connected));
+            }
+
+            void finish(std::shared_ptr<Transaction> t, Connection &c, const Response &response, const boost::system::error_code &err)
+            {
+                if (t->done)
+                    return;
+                t->done = true;
+
+                // The connection is still handling the event that ended the transaction, so it is released afterward.
+                // Any handlers it cancelled have already been queued, and run first
+                io_serv_.post(boost::bind(&EventLoop::release, this, &c));
+
+                Connection::ResponseHandler handler;
+                handler.swap(t->handler);
+                handler(c, response, err);
+            }
+
+            void release(Connection *c)
+            {
+                auto it = busy_.find(c);
+                if (it == busy_.end())
+                    return;
+
+                BusyConnection busy = it->second;
+                busy_.erase(it);
+
+                clearHandlers(*busy.c);
+                if (busy.c->connected() && !busy.c->busy())
+                {
+                    if (pool_->checkin(busy.key, shared_from_this(), busy.c))
+                        scheduleEviction();
+                }
+                else
+                {
+                    close(busy.c);
+                    pool_->discard(busy.key);
+                }
+            }
+
+            // Closes the idle connections of this event loop once they time out
+            // The timer is brought forward if the idle timeout was lowered since it was set
+            void scheduleEviction()
+            {
+                const boost::posix_time::time_duration timeout = pool_->idleTimeout();
+                if (timeout.is_special())
+                    return;
+                if (evicting_ && evict_timer_.expires_from_now() <= timeout)
+                    return;
+
+                // Rearming cancels the pending wait, whose handler then leaves evicting_ set
+                evicting_ = true;
+                evict_timer_.expires_from_now(timeout);
+                evict_timer_.async_wait(boost::bind(&EventLoop::evict, this, boost::asio::placeholders::error));
+            }
+
+            void evict(const boost::system::error_code &err)
+            {
+                if (err)
+                    return;
+                evicting_ = false;
+
+                boost::posix_time::time_duration next;
+                std::vector<ConnectionPtr> expired = pool_->takeExpired(this, next);
+                for (size_t i = 0; i < expired.size(); ++i)
+                    close(expired[i]);
+
+                if (!next.is_special())
+                {
+                    evicting_ = true;
+                    evict_timer_.expires_from_now(next);
+                    evict_timer_.async_wait(boost::bind(&EventLoop::evict, this, boost::asio::placeholders::error));
+                }
+            }
+
+            boost::asio::io_service io_serv_;
+            std::unique_ptr<boost::asio::io_service::work> work_;
+            std::mutex mutex_; // Guards work_ and thread_
+            std::thread thread_;
+
+            std::shared_ptr<ConnectionPool> pool_;
+            std::map<Connection *, BusyConnection> busy_; // In a transaction
+            boost::asio::deadline_timer evict_timer_;
+            bool evicting_; // Whether evict_timer_ is waiting
+        };
+
+        /* ConnectionManager class - Creates and tracks connections, and sends requests on a pool of event loops.
+         *
+         * Requests sent with asyncRequest() or syncRequest() are spread over the event loops, each an io_service run by a thread
+         * of its own, so that many requests from many callers share a few threads. A connection stays on the loop that
+         * created it, which keeps its handlers on one thread without a strand. The connections of the event loops are kept
+         * in a ConnectionPool between requests, whose limits may be set with setMaxConnectionsPerHost() and setIdleTimeout().
+         */
         class ConnectionManager : public boost::noncopyable
         {
             struct ConnectionObject
@@ -3300,6 +3967,7 @@ namespace CppHttp
 
             void destructor_handler(Connection &c)
             {
+                std::lock_guard<std::recursive_mutex> lock(mutex_);
                 for (size_t i = 0; i < async_connections_.size(); ++i)
                     if (async_connections_[i].c.get() == &c)
                     {
@@ -3312,11 +3980,13 @@ namespace CppHttp
 
             void registerConnection(ConnectionPtr conn)
             {
+                std::lock_guard<std::recursive_mutex> lock(mutex_);
                 async_connections_.push_back(ConnectionObject(conn));
             }
 
             void unregisterConnection(ConnectionPtr conn)
             {
+                std::lock_guard<std::recursive_mutex> lock(mutex_);
                 for (size_t i = 0; i < async_connections_.size(); ++i)
                     if (async_connections_[i].c == conn)
                     {
@@ -3326,13 +3996,20 @@ namespace CppHttp
             }
 
         public:
+            // `threads` is the number of event loop threads, or zero for one per hardware thread
+            // The threads are started as they are first needed
 #ifdef ENABLE_SSL
-            ConnectionManager() : polling_(false), ctx() {setSslContext();}
+            explicit ConnectionManager(size_t threads = 1)
+                : polling_(false), pool_(std::make_shared<ConnectionPool>()), next_loop_(0), ctx() {createLoops(threads); setSslContext();}
 #else
-            ConnectionManager() : polling_(false) {}
+            explicit ConnectionManager(size_t threads = 1)
+                : polling_(false), pool_(std::make_shared<ConnectionPool>()), next_loop_(0) {createLoops(threads);}
 #endif
             ~ConnectionManager()
             {
+                for (size_t i = 0; i < loops_.size(); ++i)
+                    loops_[i]->shutdown();
+                pool_->clear();
                 for (size_t i = 0; i < async_connections_.size(); ++i)
                 {
                     async_connections_[i].c->setDestructorHandler(async_connections_[i].destructor);
@@ -3342,6 +4019,7 @@ namespace CppHttp
 
             ConnectionPtr createConnection()
             {
+                std::lock_guard<std::recursive_mutex> lock(mutex_);
                 ConnectionPtr connection = std::make_shared<Connection>();
 #ifdef ENABLE_SSL
                 connection->setSslContext(ctx);
@@ -3352,12 +4030,96 @@ namespace CppHttp
                 return connection;
             }
 
+            // Sends `request` with `method` asynchronously on the next event loop, which is started by its first request,
+            // and calls `handler` once with the response, or with the error that ended the transaction
+            // `prepare`, if set, is called with the connection before the request is sent (see EventLoop::asyncRequest())
+            // `handler` and `prepare` are called on the event loop thread, and must not block it
+            void asyncRequest(const Request &request,
+                              const std::string &method,
+                              const boost::posix_time::time_duration &timeout,
+                              Connection::TimeoutMode mode,
+                              Connection::ResponseHandler handler,
+                              EventLoop::SetupHandler prepare = EventLoop::SetupHandler())
+            {
+                const std::string key = ConnectionPool::key(request.url());
+#ifdef ENABLE_SSL
+                const EventLoop::SetupHandler setup = boost::bind(&ConnectionManager::setupSecureConnection, ctx, verify_callback, _1);
+#else
+                const EventLoop::SetupHandler setup;
+#endif
+
+                pool_->checkout(key, loops_[next_loop_++ % loops_.size()], [=](const std::shared_ptr<EventLoop> &loop, ConnectionPtr c)
+                {
+                    EventLoop::start(loop);
+                    loop->asyncRequest(c, key, request, method, timeout, mode, handler, setup, prepare);
+                });
+            }
+
+            // Sends `request` with `method` on an event loop, and waits for the response
+            // `err` is set to the error that ended the transaction, if any
+            // This must not be called on an event loop thread (see onEventLoopThread()), which would wait for itself
+            Response syncRequest(const Request &request,
+                             const std::string &method,
+                             const boost::posix_time::time_duration &timeout,
+                             Connection::TimeoutMode mode,
+                             boost::system::error_code &err)
+            {
+                typedef std::pair<Response, boost::system::error_code> Result;
+                std::shared_ptr<std::promise<Result>> promise = std::make_shared<std::promise<Result>>();
+                std::future<Result> future = promise->get_future();
+
+                asyncRequest(request, method, timeout, mode, [promise](Connection &, const Response &response, const boost::system::error_code &ec)
+                {
+                    promise->set_value(Result(response, ec));
+                });
+
+                try
+                {
+                    Result result = future.get();
+                    err = result.second;
+                    return result.first;
+                }
+                catch (const std::future_error &)
+                {
+                    // The event loop was shut down before the transaction finished
+                    err = boost::asio::error::operation_aborted;
+                    return Response();
+                }
+            }
+
+            // Returns true if called on one of the event loop threads
+            bool onEventLoopThread() const
+            {
+                for (size_t i = 0; i < loops_.size(); ++i)
+                    if (loops_[i]->runningInThisThread())
+                        return true;
+                return false;
+            }
+
+            // Returns the number of event loop threads
+            size_t threadCount() const {return loops_.size();}
+
+            // Limits the number of pooled connections to each server (by scheme, host, and port), or removes the limit if zero
+            // (the default). Requests beyond the limit wait for a connection to the server to be returned
+            void setMaxConnectionsPerHost(size_t max) {pool_->setMaxConnectionsPerHost(max);}
+            size_t maxConnectionsPerHost() const {return pool_->maxConnectionsPerHost();}
+
+            // Sets how long a pooled connection may stay idle before it is closed, or pos_infin to keep idle connections open
+            // The default is 30 seconds
+            void setIdleTimeout(const boost::posix_time::time_duration &timeout) {pool_->setIdleTimeout(timeout);}
+            boost::posix_time::time_duration idleTimeout() const {return pool_->idleTimeout();}
+
+            // Returns the hits, misses, and waits of the connection pool so far, and the connections open now
+            ConnectionPool::Statistics poolStatistics() const {return pool_->statistics();}
+
             ConnectionPtr createConnection(const Request &request) {return createConnection(request.url());}
             ConnectionPtr createConnection(const Uri &url)
             {
+                std::lock_guard<std::recursive_mutex> lock(mutex_);
+                const std::string key = ConnectionPool::key(url);
                 for (size_t i = 0; i < async_connections_.size(); ++i)
                 {
-                    if (async_connections_[i].free && async_connections_[i].c->topLevelDomain() == url.topLevel())
+                    if (async_connections_[i].free && ConnectionPool::key(Uri(async_connections_[i].c->topLevelDomain())) == key)
                     {
                         async_connections_[i].free = false;
                         async_connections_[i].c->reconnectOnConnAborted();
@@ -3369,6 +4131,7 @@ namespace CppHttp
 
             void freeConnection(ConnectionPtr c)
             {
+                std::lock_guard<std::recursive_mutex> lock(mutex_);
                 for (size_t i = 0; i < async_connections_.size(); ++i)
                     if (async_connections_[i].c == c)
                     {
@@ -3580,6 +4343,25 @@ namespace CppHttp
         private:
             static void null() {}
 
+            void createLoops(size_t threads)
+            {
+                if (threads == 0)
+                    threads = std::max(1u, std::thread::hardware_concurrency());
+
+                for (size_t i = 0; i < threads; ++i)
+                    loops_.push_back(std::make_shared<EventLoop>(pool_));
+            }
+
+#ifdef ENABLE_SSL
+            static void setupSecureConnection(std::shared_ptr<boost::asio::ssl::context> context,
+                                              Connection::VerifyHandler handler,
+                                              Connection &c)
+            {
+                c.setSslContext(context);
+                c.setVerifyHandler(handler);
+            }
+#endif
+
             size_t findConnection(ConnectionPtr c)
             {
                 for (size_t i = 0; i < async_connections_.size(); ++i)
@@ -3590,6 +4372,10 @@ namespace CppHttp
 
             size_t polling_;
             std::vector<ConnectionObject> async_connections_;
+            std::recursive_mutex mutex_; // Guards async_connections_ when creating and freeing connections, which destroying one may recurse into
+            std::shared_ptr<ConnectionPool> pool_; // Keeps the connections of the event loops between requests
+            std::vector<std::shared_ptr<EventLoop>> loops_; // Drive the connections of asyncRequest() and syncRequest()
+            std::atomic<size_t> next_loop_; // The event loop of the next request, modulo the number of loops
 #ifdef ENABLE_SSL
             std::shared_ptr<boost::asio::ssl::context> ctx;
             Connection::VerifyHandler verify_callback;
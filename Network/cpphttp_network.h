@@ -6,6 +6,10 @@
 
 #include "CppHttp/cpphttp.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
 
 namespace couchdb
@@ -52,26 +56,168 @@ namespace couchdb
         }
     };
 
-    struct asio_http_response_handle
+    /* asio_http_response_stream class - The body of a response sent on an event loop, read piece by piece on another thread.
+     *
+     * The event loop appends each piece of the body to a queue as soon as it is read, without buffering the whole body,
+     * and the reading thread takes the pieces in order. If the event loop is shut down before the response ends,
+     * the stream ends with an error. A stream may be cancelled from any thread, which closes its connection.
+     */
+    class asio_http_response_stream : public std::enable_shared_from_this<asio_http_response_stream>
     {
-        void add_response(CppHttp::Http::Connection &,
-                          const CppHttp::Http::Response &response,
-                          const boost::system::error_code &ec)
+    public:
+        asio_http_response_stream() : connection_(NULL), headers_(false), done_(false), cancelled_(false) {}
+
+        // Sends `request` on an event loop of `manager`, with the body passed back in pieces of `type` (lines or anything)
+        void start(CppHttp::Http::ConnectionManager &manager,
+                   const CppHttp::Http::Request &request,
+                   const std::string &method,
+                   const boost::posix_time::time_duration &timeout,
+                   CppHttp::Http::Connection::TimeoutMode timeout_mode,
+                   CppHttp::Http::Connection::ResponseType type)
         {
-            if (!ec)
-                responses.push_back(response.body());
+            // The handlers share `watched`, which ends the stream once they are all destroyed, even if the transaction was abandoned
+            std::shared_ptr<asio_http_response_stream> self = shared_from_this();
+            std::shared_ptr<asio_http_response_stream> watched(this, [self](asio_http_response_stream *) {self->abandon();});
+
+            manager.asyncRequest(request, method, timeout, timeout_mode,
+                                 boost::bind(&asio_http_response_stream::finish, watched, _1, _2, _3),
+                                 [watched, type](CppHttp::Http::Connection &c)
+            {
+                watched->attach(c);
+                c.setHeadersHandler(boost::bind(&asio_http_response_stream::headers, watched, _1, _2, _3));
+                c.setPartialResponseHandler(boost::bind(&asio_http_response_stream::add, watched, _1, _2, _3));
+                c.setPartialResponseType(type);
+                c.setBufferResponseBody(false);
+            });
         }
 
-        std::shared_ptr<CppHttp::Http::Connection> connection;
-        std::deque<std::string> responses;
+        // Takes the next piece of the body into `piece`, first waiting for one to arrive if `wait` is set
+        // Returns false if there is no piece, and, when waiting, the response has ended
+        bool next(std::string &piece, bool wait)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (wait)
+                changed_.wait(lock, [this] {return !pieces_.empty() || done_;});
+            if (pieces_.empty())
+                return false;
+
+            piece.swap(pieces_.front());
+            pieces_.pop_front();
+            return true;
+        }
+
+        // Returns true until the response has ended and all of its pieces have been taken
+        bool active() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return !done_ || !pieces_.empty();
+        }
+
+        // Waits for the headers of the response, or for it to end without them, and returns its status and headers
+        CppHttp::Http::Response wait_for_headers() const
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] {return headers_ || done_;});
+            return response_;
+        }
+
+        // Waits for the response to end, and returns its status and headers
+        CppHttp::Http::Response wait() const
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] {return done_;});
+            return response_;
+        }
+
+        // Ends the response early by closing its connection on the event loop, which then discards the connection
+        void cancel()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cancelled_ = true;
+            if (connection_ && !done_)
+                post_disconnect();
+        }
+
+    private:
+        void attach(CppHttp::Http::Connection &c)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connection_ = &c;
+            if (cancelled_)
+                post_disconnect();
+        }
+
+        // Requires `mutex_` to be locked
+        void post_disconnect()
+        {
+            connection_->io_service().post(boost::bind(&asio_http_response_stream::disconnect, shared_from_this()));
+        }
+
+        // Runs on the event loop, which is the only thread that ends the transaction, so it cannot end while this runs
+        // The connection is only valid until then
+        void disconnect()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (done_)
+                    return;
+            }
+
+            connection_->disconnectImmediately();
+        }
+
+        void headers(CppHttp::Http::Connection &, const CppHttp::Http::Response &response, const boost::system::error_code &)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            response_ = response;
+            headers_ = true;
+            changed_.notify_all();
+        }
+
+        void add(CppHttp::Http::Connection &, const CppHttp::Http::Response &response, const boost::system::error_code &ec)
+        {
+            if (ec || response.body().empty())
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            pieces_.push_back(response.body());
+            changed_.notify_all();
+        }
+
+        void finish(CppHttp::Http::Connection &, const CppHttp::Http::Response &response, const boost::system::error_code &)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            response_ = response;
+            done_ = true;
+            changed_.notify_all();
+        }
+
+        void abandon()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+            changed_.notify_all();
+        }
+
+        mutable std::mutex mutex_;
+        mutable std::condition_variable changed_;
+        std::deque<std::string> pieces_;
+        CppHttp::Http::Connection *connection_; // The connection the request was sent on, while it is in progress
+        CppHttp::Http::Response response_; // The status and headers, once they have arrived
+        bool headers_;
+        bool done_;
+        bool cancelled_;
     };
 
+    typedef asio_http_response_stream asio_http_response_handle;
+
     template<bool allow_caching = true, bool blocking_response_handle = true>
     struct asio_http_impl : public http_client_base<asio_url_impl, /* URL implementation */
                                                boost::posix_time::time_duration, /* Timeout duration */
                                                CppHttp::Http::Connection::TimeoutMode, /* Timeout mode */
                                                std::shared_ptr<asio_http_response_handle> /* Response handle */>
     {
+        // Requests are sent on the event loop threads of `manager`, which may be shared with other clients
         asio_http_impl(std::shared_ptr<CppHttp::Http::ConnectionManager> manager = std::make_shared<CppHttp::Http::ConnectionManager>())
             : client(manager) {}
 
@@ -79,16 +225,20 @@ namespace couchdb
 
         response_handle_type invalid_handle() const {return response_handle_type();}
 
-        bool is_active_handle(response_handle_type handle) const
-        {
-            return handle && handle->connection && handle->connection->connected() && handle->connection->success();
-        }
+        bool is_active_handle(response_handle_type handle) const {return handle && handle->active();}
 
         bool is_response_handle_blocking() const {return blocking_response_handle;}
 
         bool allow_cached_responses() const {return allow_caching;}
 
-        void reset() {client->stop();}
+        // Cancels the response handles opened by this object, without affecting other requests on the shared event loops
+        void reset()
+        {
+            for (auto it = handles.begin(); it != handles.end(); ++it)
+                if (response_handle_type handle = it->lock())
+                    handle->cancel();
+            handles.clear();
+        }
 
         /*          url       (IN): The URL to visit.
          *      timeout       (IN): The length of time before timeout should occur.
@@ -117,18 +267,13 @@ namespace couchdb
             CppHttp::Http::Request request(url, headers);
             request.setBody(data);
 
-            auto connection = client->createConnection(request);
-            connection->setTimeout(timeout);
-            connection->setTimeoutMode(timeout_mode);
-            connection->setRequest(request, method);
-            if (connection->disconnected())
-                connection->connect();
-            else
-                connection->sendRequest();
-            connection->wait_for_transaction();
-            client->freeConnection(connection);
-
-            CppHttp::Http::Response response = connection->response();
+            if (client->onEventLoopThread())
+                return refuse_on_event_loop(network_error, error_description);
+
+            // Wait on the event loops of the connection manager, which callers on every thread share
+            boost::system::error_code ec;
+            const CppHttp::Http::Response response = client->syncRequest(request, method, timeout, timeout_mode, ec);
+
             response_buffer = response.body();
 
             int status = static_cast<int>(response.code());
@@ -149,6 +294,84 @@ namespace couchdb
             return status;
         }
 
+        /* Identical to operator(), except that each piece of the response body is passed to `body_handler`
+         * as soon as it is read, and the body is not buffered. The request is sent on an event loop of the
+         * connection manager, and `body_handler` is called on this thread.
+         */
+        virtual int stream_response(const std::string &url,
+                                    duration_type timeout,
+                                    mode_type timeout_mode,
+                                    std::map<std::string, std::string> &headers,
+                                    const std::string &method,
+                                    const std::string &data,
+                                    const body_handler_type &body_handler,
+                                    bool &network_error,
+                                    std::string &error_description)
+        {
+            if (client->onEventLoopThread())
+                return refuse_on_event_loop(network_error, error_description);
+
+            CppHttp::Http::Request request(url, headers);
+            request.setBody(data);
+
+            std::shared_ptr<asio_http_response_stream> stream = std::make_shared<asio_http_response_stream>();
+            stream->start(*client, request, method, timeout, timeout_mode, CppHttp::Http::Connection::ResponseAny);
+
+            std::string piece;
+            while (stream->next(piece, true))
+                body_handler(piece.data(), piece.size());
+
+            // The body was not buffered, so this only holds the status and headers
+            const CppHttp::Http::Response response = stream->wait();
+
+            int status = static_cast<int>(response.code());
+            network_error = status / 100 != 2;
+            error_description = response.message();
+
+            headers.clear();
+            for (auto it = response.headers().begin(); it != response.headers().end(); ++it)
+                headers[ascii_string_tools::to_lower_copy(it->first)] = it->second;
+
+#ifdef CPPCOUCH_FULL_DEBUG
+            std::cout << method << " " << url << " (streamed)" << std::endl;
+            for (auto it = response.headers().begin(); it != response.headers().end(); ++it)
+                std::cout << it->first << ": " << it->second << std::endl;
+#endif
+
+            return status;
+        }
+
+        /* Identical to operator(), except that the request is sent on the event loop of the connection manager,
+         * and its outputs are passed to `handler` on the event loop thread once the response has arrived
+         */
+        virtual void async_request(const std::string &url,
+                                   duration_type timeout,
+                                   mode_type timeout_mode,
+                                   const std::map<std::string, std::string> &headers,
+                                   const std::string &method,
+                                   const std::string &data,
+                                   const completion_handler_type &handler)
+        {
+            CppHttp::Http::Request request(url, headers);
+            request.setBody(data);
+
+            client->asyncRequest(request, method, timeout, timeout_mode, [handler](CppHttp::Http::Connection &,
+                                                                                   const CppHttp::Http::Response &response,
+                                                                                   const boost::system::error_code &)
+            {
+                std::map<std::string, std::string> headers;
+                std::string response_buffer = response.body();
+
+                int status = static_cast<int>(response.code());
+                bool network_error = status / 100 != 2;
+
+                for (auto it = response.headers().begin(); it != response.headers().end(); ++it)
+                    headers[ascii_string_tools::to_lower_copy(it->first)] = it->second;
+
+                handler(status, headers, response_buffer, network_error, response.message());
+            });
+        }
+
         /*          url       (IN): The URL to visit.
          *      timeout       (IN): The length of time before timeout should occur.
          * timeout_mode       (IN): Implementation-specific choice of how to timeout.
@@ -163,7 +386,8 @@ namespace couchdb
          *
          * Return value: Must return the HTTP status code, or zero if an error occured before the response arrived
          *
-         * NOTE: the response_buffer must be completely read before reusing this http_impl object, or reset() must be called
+         * The response is read on an event loop of the connection manager, through the connection pool, and its lines
+         * are queued on the handle until read. Open handles may be closed early with reset()
          */
         virtual int get_response_handle(const std::string &url,
                                         duration_type timeout,
@@ -175,27 +399,16 @@ namespace couchdb
                                         bool &network_error,
                                         std::string &error_description)
         {
-            response_handle_type response_handle = std::make_shared<asio_http_response_handle>();
+            if (client->onEventLoopThread())
+                return refuse_on_event_loop(network_error, error_description);
 
             CppHttp::Http::Request request(url, headers);
             request.setBody(data);
 
-            auto connection = client->createConnection(request);
-            response_handle->connection = connection;
-            connection->setTimeout(timeout);
-            connection->setTimeoutMode(timeout_mode);
-            connection->setPartialResponseHandler(boost::bind(&asio_http_response_handle::add_response, response_handle.get(), _1, _2, _3));
-            connection->setPartialResponseType(CppHttp::Http::Connection::ResponseLine);
-            connection->setRequest(request, method);
-            if (connection->disconnected())
-                connection->connect();
-            else
-                connection->sendRequest();
-
-            while (connection->response().code() == CppHttp::Http::Invalid && connection->run_one())
-                ;
+            response_handle_type response_handle = std::make_shared<asio_http_response_handle>();
+            response_handle->start(*client, request, method, timeout, timeout_mode, CppHttp::Http::Connection::ResponseLine);
 
-            CppHttp::Http::Response response = connection->response();
+            const CppHttp::Http::Response response = response_handle->wait_for_headers();
 
             int status = static_cast<int>(response.code());
             network_error = status / 100 != 2;
@@ -211,35 +424,29 @@ namespace couchdb
                 std::cout << it->first << ": " << it->second << std::endl;
 #endif
 
-            response_buffer = network_error? response_handle_type(): response_handle;
+            if (network_error)
+            {
+                // The rest of the error response is read and discarded on the event loop
+                response_buffer = response_handle_type();
+                return status;
+            }
+
+            handles.erase(std::remove_if(handles.begin(), handles.end(),
+                                         [](const std::weak_ptr<asio_http_response_handle> &h) {return h.expired();}),
+                          handles.end());
+            handles.push_back(response_handle);
+            response_buffer = response_handle;
             return status;
         }
 
         /* Read a line from a response handle.
-         * Blocks until a line is available
+         * Blocks until a line is available, unless the handle is non-blocking
          */
         virtual std::string read_line_from_response_handle(response_handle_type handle)
         {
             std::string line;
-            if (handle && handle->connection)
-            {
-                if (handle->connection->connected())
-                {
-                    if (blocking_response_handle)
-                    {
-                        while (handle->responses.empty() && handle->connection->run_one())
-                            ;
-                    }
-                    else
-                        handle->connection->poll();
-                }
-
-                if (!handle->responses.empty())
-                {
-                    line = handle->responses.front();
-                    handle->responses.pop_front();
-                }
-            }
+            if (handle)
+                handle->next(line, blocking_response_handle);
 
             while (!line.empty() && strchr("\r\n", line.back()))
                 line.pop_back();
@@ -248,7 +455,16 @@ namespace couchdb
         }
 
     private:
+        // Fails a request made on an event loop thread, which cannot wait for a response that the same thread has to read
+        static int refuse_on_event_loop(bool &network_error, std::string &error_description)
+        {
+            network_error = true;
+            error_description = "Synchronous request made on an event loop thread, which would wait for itself (use async_request() instead)";
+            return 0;
+        }
+
         std::shared_ptr<CppHttp::Http::ConnectionManager> client;
+        std::vector<std::weak_ptr<asio_http_response_handle>> handles; // The open response handles, for reset()
     };
 }
 
@@ -1,15 +1,79 @@
 #ifndef JSON_H
 #define JSON_H
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <iostream>
 #include <sstream>
-#include <codecvt>
 #include <locale>
 #include <type_traits>
+#include <utility>
+#include <tuple>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <functional>
+#include <initializer_list>
+#include <algorithm>
+#include <cmath>
 #include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <clocale>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+// Define JSON_PMR to allocate arrays and objects from a std::pmr::memory_resource (requires C++17)
+#ifdef JSON_PMR
+#if __cplusplus < 201703L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#error JSON_PMR requires C++17
+#endif
+#include <memory_resource>
+#endif
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define JSON_FLOAT_CHARCONV
+#endif
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<string_view>)
+#include <string_view>
+#define JSON_STRING_VIEW
+#endif
+#endif
+
+// Define JSON_FLAT_OBJECT or JSON_ORDERED_OBJECT to store object members in a vector instead of a std::map
+#if defined(JSON_FLAT_OBJECT) && defined(JSON_ORDERED_OBJECT)
+#error Only one of JSON_FLAT_OBJECT and JSON_ORDERED_OBJECT may be defined
+#endif
+
+// Define JSON_INTERNED_KEYS to name object members with interned json::atom values (implies JSON_FLAT_OBJECT, unless JSON_ORDERED_OBJECT is defined)
+#if defined(JSON_INTERNED_KEYS) && !defined(JSON_ORDERED_OBJECT) && !defined(JSON_FLAT_OBJECT)
+#define JSON_FLAT_OBJECT
+#endif
+
+#ifndef JSON_ATOM_MAX_LENGTH
+#define JSON_ATOM_MAX_LENGTH 64
+#endif
+
+#ifndef JSON_ATOM_TABLE_CAPACITY
+#define JSON_ATOM_TABLE_CAPACITY 65536
+#endif
+
+// Define JSON_VALIDATE_UTF8 to have parsers reject strings that are not valid UTF-8, unless told otherwise with validate_utf8(false)
+
+#if !defined(JSON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JSON_WRITER_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace json
 {
@@ -31,531 +95,4043 @@ namespace json
     typedef double real_t;
     typedef const char *cstring_t;
     typedef std::string string_t;
-    typedef std::vector<value> array_t;
-    typedef std::map<string_t, value> object_t;
 
-    struct error
+    /* string_ref class - A non-owning reference to a run of characters, such as a string borrowed from a parsed buffer.
+     *
+     * The characters are not required to be null-terminated, and must outlive the reference.
+     */
+    class string_ref
     {
-        error(cstring_t reason) : what_(reason) {}
+    public:
+        string_ref() : data_(""), size_(0) {}
+        string_ref(const char *data, size_t size) : data_(data), size_(size) {}
+        string_ref(cstring_t str) : data_(str), size_(strlen(str)) {}
+        string_ref(const string_t &str) : data_(str.data()), size_(str.size()) {}
 
-        cstring_t what() const {return what_;}
+        const char *data() const {return data_;}
+        size_t size() const {return size_;}
+        bool empty() const {return size_ == 0;}
+
+        const char *begin() const {return data_;}
+        const char *end() const {return data_ + size_;}
+        char operator[](size_t pos) const {return data_[pos];}
+
+        string_t str() const {return string_t(data_, size_);}
+        operator string_t() const {return str();}
+#ifdef JSON_STRING_VIEW
+        operator std::string_view() const {return std::string_view(data_, size_);}
+#endif
+
+        bool starts_with(string_ref prefix) const {return size_ >= prefix.size_ && memcmp(data_, prefix.data_, prefix.size_) == 0;}
+
+        int compare(string_ref other) const
+        {
+            int result = memcmp(data_, other.data_, std::min(size_, other.size_));
+            return result? result: size_ < other.size_? -1: size_ > other.size_;
+        }
+
+        friend bool operator==(string_ref lhs, string_ref rhs) {return lhs.size_ == rhs.size_ && memcmp(lhs.data_, rhs.data_, lhs.size_) == 0;}
+        friend bool operator!=(string_ref lhs, string_ref rhs) {return !(lhs == rhs);}
+        friend bool operator<(string_ref lhs, string_ref rhs) {return lhs.compare(rhs) < 0;}
+
+        friend std::ostream &operator<<(std::ostream &stream, string_ref s) {return stream.write(s.data_, s.size_);}
 
     private:
-        cstring_t what_;
+        const char *data_;
+        size_t size_;
     };
 
-    class value
+    /* atom class - An immutable, interned string, used for object member names when JSON_INTERNED_KEYS is defined.
+     *
+     * CouchDB responses repeat the same few member names ("_id", "_rev", "id", "key", "value", "rows", ...)
+     * in every row. Atoms share a single, permanent copy of each name from a process-wide table, so
+     * repeating a name costs neither an allocation nor a copy, and two atoms are equal exactly when they
+     * point to the same copy. Lookups of recently seen names are served from a small per-thread cache
+     * without locking the table.
+     *
+     * Names longer than JSON_ATOM_MAX_LENGTH, or seen once the table holds JSON_ATOM_TABLE_CAPACITY names,
+     * are not interned. Each such atom has its own reference-counted copy instead, so documents with
+     * arbitrary member names cannot grow the table without bound.
+     */
+    class atom
     {
+        struct shared_string
+        {
+            shared_string(const char *str, size_t length) : text(str, length), refs(1) {}
+
+            string_t text;
+            std::atomic<size_t> refs;
+        };
+
     public:
-        value() : type_(null) {}
-        value(bool_t v) : type_(boolean), bool_(v) {}
-        value(int_t v) : type_(integer), int_(v) {}
-        value(real_t v) : type_(real), real_(v) {}
-        value(cstring_t v) : type_(string), str_(v) {}
-        value(const string_t &v) : type_(string), str_(v) {}
-        value(const array_t &v) : type_(array), arr_(v) {}
-        value(const object_t &v) : type_(object), obj_(v) {}
-        template<typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
-        value(T v) : type_(integer), int_(v) {}
-        template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
-        value(T v) : type_(real), real_(v) {}
+        atom() : str_(&empty_name()), shared_(NULL) {}
+        explicit atom(cstring_t str) {init(str, strlen(str));}
+        atom(const char *str, size_t length) {init(str, length);}
+        explicit atom(const string_t &str) {init(str.data(), str.size());}
+        atom(const atom &other) : str_(other.str_), shared_(other.shared_) {if (shared_) ++shared_->refs;}
+        atom(atom &&other) noexcept : str_(other.str_), shared_(other.shared_)
+        {
+            other.str_ = &empty_name();
+            other.shared_ = NULL;
+        }
+        ~atom() {release();}
 
-        type get_type() const {return type_;}
-        size_t size() const {return type_ == array? arr_.size(): type_ == object? obj_.size(): 0;}
+        atom &operator=(atom other)
+        {
+            swap(other);
+            return *this;
+        }
 
-        bool_t is_null() const {return type_ == null;}
-        bool_t is_bool() const {return type_ == boolean;}
-        bool_t is_int() const {return type_ == integer;}
-        bool_t is_real() const {return type_ == real || type_ == integer;}
-        bool_t is_string() const {return type_ == string;}
-        bool_t is_array() const {return type_ == array;}
-        bool_t is_object() const {return type_ == object;}
+        void swap(atom &other)
+        {
+            std::swap(str_, other.str_);
+            std::swap(shared_, other.shared_);
+        }
 
-        bool_t get_bool() const {return bool_;}
-        int_t get_int() const {return int_;}
-        real_t get_real() const {return type_ == integer? int_: real_;}
-        cstring_t get_cstring() const {return str_.c_str();}
-        const string_t &get_string() const {return str_;}
-        const array_t &get_array() const {return arr_;}
-        const object_t &get_object() const {return obj_;}
+        const string_t &str() const {return *str_;}
+        operator const string_t &() const {return *str_;}
 
-        bool_t &get_bool() {clear(boolean); return bool_;}
-        int_t &get_int() {clear(integer); return int_;}
-        real_t &get_real() {clear(real); return real_;}
-        string_t &get_string() {clear(string); return str_;}
-        array_t &get_array() {clear(array); return arr_;}
-        object_t &get_object() {clear(object); return obj_;}
+        const char *data() const {return str_->data();}
+        cstring_t c_str() const {return str_->c_str();}
+        size_t size() const {return str_->size();}
+        bool empty() const {return str_->empty();}
 
-        void set_null() {clear(null);}
-        void set_bool(bool_t v) {clear(boolean); bool_ = v;}
-        void set_int(int_t v) {clear(integer); int_ = v;}
-        void set_real(real_t v) {clear(real); real_ = v;}
-        void set_string(cstring_t v) {clear(string); str_ = v;}
-        void set_string(const string_t &v) {clear(string); str_ = v;}
-        void set_array(const array_t &v) {clear(array); arr_ = v;}
-        void set_object(const object_t &v) {clear(object); obj_ = v;}
+        // Returns true if this atom refers to the shared copy of its name
+        bool interned() const {return shared_ == NULL;}
 
-        value operator[](const string_t &key) const
+        // A name is either always interned or never, so interned atoms can be compared by pointer alone
+        friend bool operator==(const atom &lhs, const atom &rhs)
         {
-            auto it = obj_.find(key);
-            if (it != obj_.end())
-                return it->second;
-            return value();
+            return lhs.str_ == rhs.str_ || (!lhs.interned() && !rhs.interned() && *lhs.str_ == *rhs.str_);
         }
-        value &operator[](const string_t &key) {clear(object); return obj_[key];}
-        bool_t is_member(cstring_t key) const {return obj_.find(key) != obj_.end();}
-        bool_t is_member(const string_t &key) const {return obj_.find(key) != obj_.end();}
-        void erase(const string_t &key) {obj_.erase(key);}
+        friend bool operator!=(const atom &lhs, const atom &rhs) {return !(lhs == rhs);}
+        friend bool operator<(const atom &lhs, const atom &rhs) {return lhs.str_ != rhs.str_ && *lhs.str_ < *rhs.str_;}
 
-        void push_back(const value &v) {clear(array); arr_.push_back(v);}
-        void push_back(value &&v) {clear(array); arr_.push_back(v);}
-        const value &operator[](size_t pos) const {return arr_[pos];}
-        value &operator[](size_t pos) {return arr_[pos];}
-        void erase(int_t pos) {arr_.erase(arr_.begin() + pos);}
-
-        // The following are convenience conversion functions
-        bool_t get_bool(bool_t default_) const {return is_bool()? bool_: default_;}
-        int_t get_int(int_t default_) const {return is_int()? int_: default_;}
-        real_t get_real(real_t default_) const {return is_real()? real_: default_;}
-        cstring_t get_string(cstring_t default_) const {return is_string()? str_.c_str(): default_;}
-        string_t get_string(const string_t &default_) const {return is_string()? str_: default_;}
-        array_t get_array(const array_t &default_) const {return is_array()? arr_: default_;}
-        object_t get_object(const object_t &default_) const {return is_object()? obj_: default_;}
+        friend bool operator==(const atom &lhs, const string_t &rhs) {return lhs.str() == rhs;}
+        friend bool operator==(const string_t &lhs, const atom &rhs) {return lhs == rhs.str();}
+        friend bool operator==(const atom &lhs, cstring_t rhs) {return lhs.str() == rhs;}
+        friend bool operator==(cstring_t lhs, const atom &rhs) {return lhs == rhs.str();}
+        friend bool operator!=(const atom &lhs, const string_t &rhs) {return lhs.str() != rhs;}
+        friend bool operator!=(const string_t &lhs, const atom &rhs) {return lhs != rhs.str();}
+        friend bool operator!=(const atom &lhs, cstring_t rhs) {return lhs.str() != rhs;}
+        friend bool operator!=(cstring_t lhs, const atom &rhs) {return lhs != rhs.str();}
+        friend bool operator<(const atom &lhs, const string_t &rhs) {return lhs.str() < rhs;}
+        friend bool operator<(const string_t &lhs, const atom &rhs) {return lhs < rhs.str();}
 
-        bool_t as_bool(bool_t default_ = false) const {return value(*this).convert_to(boolean, default_).bool_;}
-        int_t as_int(int_t default_ = 0) const {return value(*this).convert_to(integer, default_).int_;}
-        real_t as_real(real_t default_ = 0.0) const {return value(*this).convert_to(real, default_).real_;}
-        string_t as_string(const string_t &default_ = string_t()) const {return value(*this).convert_to(string, default_).str_;}
-        array_t as_array(const array_t &default_ = array_t()) const {return value(*this).convert_to(array, default_).arr_;}
-        object_t as_object(const object_t &default_ = object_t()) const {return value(*this).convert_to(object, default_).obj_;}
+        friend string_t operator+(const atom &lhs, const string_t &rhs) {return lhs.str() + rhs;}
+        friend string_t operator+(const string_t &lhs, const atom &rhs) {return lhs + rhs.str();}
+        friend string_t operator+(const atom &lhs, cstring_t rhs) {return lhs.str() + rhs;}
+        friend string_t operator+(cstring_t lhs, const atom &rhs) {return lhs + rhs.str();}
 
-        bool_t &convert_to_bool(bool_t default_ = false) {return convert_to(boolean, default_).bool_;}
-        int_t &convert_to_int(int_t default_ = 0) {return convert_to(integer, default_).int_;}
-        real_t &convert_to_real(real_t default_ = 0.0) {return convert_to(real, default_).real_;}
-        string_t &convert_to_string(const string_t &default_ = string_t()) {return convert_to(string, default_).str_;}
-        array_t &convert_to_array(const array_t &default_ = array_t()) {return convert_to(array, default_).arr_;}
-        object_t &convert_to_object(const object_t &default_ = object_t()) {return convert_to(object, default_).obj_;}
+        friend std::ostream &operator<<(std::ostream &stream, const atom &a) {return stream << a.str();}
 
     private:
-        void clear(type new_type)
+        struct table
         {
-            if (type_ == new_type)
-                return;
+            std::mutex mutex;
+            std::unordered_set<string_t> names; // Elements are never removed, so pointers to them remain valid
+        };
 
-            str_.clear(); str_.shrink_to_fit();
-            arr_.clear(); arr_.shrink_to_fit();
-            obj_.clear();
-            type_ = new_type;
-        }
+        static table &global_table() {static table t; return t;}
+        static const string_t &empty_name() {static const string_t s; return s;}
 
-        value &convert_to(type new_type, value default_value)
+        // Returns the shared copy of the name, or NULL if it is not interned
+        static const string_t *intern(const char *str, size_t length)
         {
-            if (type_ == new_type)
-                return *this;
+            const size_t cache_size = 256;
+            static thread_local const string_t *cache[cache_size];
 
-            switch (type_)
+            if (length > JSON_ATOM_MAX_LENGTH)
+                return NULL;
+
+            uint32_t hash = 2166136261u; // FNV-1a
+            for (size_t i = 0; i < length; ++i)
+                hash = (hash ^ (str[i] & 0xff)) * 16777619u;
+
+            const string_t *&slot = cache[hash % cache_size];
+            if (slot && slot->size() == length && memcmp(slot->data(), str, length) == 0)
+                return slot;
+
+            table &t = global_table();
+            std::lock_guard<std::mutex> lock(t.mutex);
+
+            string_t name(str, length);
+            auto it = t.names.find(name);
+            if (it == t.names.end())
             {
-                case null: *this = default_value; break;
-                case boolean:
-                {
-                    clear(new_type);
-                    switch (new_type)
-                    {
-                        case integer: int_ = bool_; break;
-                        case real: real_ = bool_; break;
-                        case string: str_ = bool_? "true": "false"; break;
-                        default: *this = default_value; break;
-                    }
-                    break;
-                }
-                case integer:
-                {
-                    clear(new_type);
-                    switch (new_type)
-                    {
-                        case boolean: bool_ = int_ != 0; break;
-                        case real: real_ = int_; break;
-                        case string: str_ = std::to_string(int_); break;
-                        default: *this = default_value; break;
-                    }
-                    break;
-                }
-                case real:
-                {
-                    clear(new_type);
-                    switch (new_type)
-                    {
-                        case boolean: bool_ = real_ != 0.0; break;
-                        case integer: int_ = (real_ >= INT64_MIN && real_ <= INT64_MAX)? trunc(real_): 0; break;
-                        case string: str_ = std::to_string(real_); break;
-                        default: *this = default_value; break;
-                    }
-                    break;
-                }
-                case string:
-                {
-                    switch (new_type)
-                    {
-                        case boolean: bool_ = str_ == "true"; break;
-                        case integer:
-                        {
-                            std::istringstream str(str_);
-                            str >> int_;
-                            if (!str)
-                                int_ = 0;
-                            break;
-                        }
-                        case real:
-                        {
-                            std::istringstream str(str_);
-                            str >> real_;
-                            if (!str)
-                                real_ = 0.0;
-                            break;
-                        }
-                        default: *this = default_value; break;
-                    }
-                    clear(new_type);
-                    break;
-                }
-                default: break;
+                if (t.names.size() >= JSON_ATOM_TABLE_CAPACITY)
+                    return NULL;
+                it = t.names.insert(std::move(name)).first;
             }
 
-            return *this;
+            return slot = &*it;
         }
 
-        type type_;
-        union
+        void init(const char *str, size_t length)
         {
-            bool_t bool_;
-            int_t int_;
-            real_t real_;
-        };
-        string_t str_;
-        array_t arr_;
-        object_t obj_;
+            shared_ = NULL;
+            if (length == 0)
+                str_ = &empty_name();
+            else if ((str_ = intern(str, length)) == NULL)
+            {
+                shared_ = new shared_string(str, length);
+                str_ = &shared_->text;
+            }
+        }
+
+        void release()
+        {
+            if (shared_ && --shared_->refs == 0)
+                delete shared_;
+        }
+
+        const string_t *str_;
+        shared_string *shared_; // Owned copy of a name that is not interned, or NULL
     };
 
-    inline bool operator==(const value &lhs, const value &rhs)
+    /* flat_object class - An object that keeps its members in a single contiguous vector.
+     *
+     * CouchDB documents and rows are mostly small objects, for which a vector is both smaller and
+     * faster to search than the separately allocated nodes of a std::map. With `sorted` set, members
+     * are kept ordered by name and found with a binary search, and iterate in the same order as
+     * std::map. Parsers append members unordered and sort them once the object is complete (see
+     * append_member()), as should code that builds a large object, since each operator[] that adds
+     * a member moves the members after it. Otherwise members keep their insertion order and are
+     * found with a linear search, which is the fastest choice for objects with only a handful of
+     * members, while objects with more than `index_threshold` members also keep a hash table of
+     * member positions.
+     *
+     * Define JSON_FLAT_OBJECT (sorted) or JSON_ORDERED_OBJECT (insertion order) to use it as object_t.
+     * Members can be looked up by pointer and length, without constructing a string_t first.
+     * Member names are stored as `Key`, which is either string_t or atom, and must not be modified through iterators.
+     */
+    template<bool sorted, typename Key = string_t, typename Allocator = std::allocator<std::pair<Key, value>>>
+    class flat_object
     {
-        if (lhs.get_type() != rhs.get_type())
-            return false;
+        typedef std::vector<std::pair<Key, value>, Allocator> container;
 
-        switch (lhs.get_type())
+    public:
+        typedef Key key_type;
+        typedef value mapped_type;
+        typedef typename container::value_type value_type;
+        typedef typename container::size_type size_type;
+        typedef typename container::iterator iterator;
+        typedef typename container::const_iterator const_iterator;
+        typedef Allocator allocator_type;
+
+        // Insertion-ordered objects with more members than this are indexed by a hash table
+        static const size_type index_threshold = 32;
+
+        flat_object() {}
+        explicit flat_object(const allocator_type &alloc) : members_(alloc), index_(alloc) {}
+        flat_object(const flat_object &other, const allocator_type &alloc) : members_(other.members_, alloc), index_(other.index_, alloc) {}
+        flat_object(flat_object &&other, const allocator_type &alloc) : members_(std::move(other.members_), alloc), index_(std::move(other.index_), alloc) {}
+
+        allocator_type get_allocator() const {return members_.get_allocator();}
+
+        iterator begin() {return members_.begin();}
+        iterator end() {return members_.end();}
+        const_iterator begin() const {return members_.begin();}
+        const_iterator end() const {return members_.end();}
+
+        bool empty() const {return members_.empty();}
+        size_type size() const {return members_.size();}
+        void clear() {members_.clear(); index_.clear();}
+        void reserve(size_type count) {members_.reserve(count);}
+        void swap(flat_object &other) {members_.swap(other.members_); index_.swap(other.index_);}
+
+        // Returns the member named by the `length` bytes at `key`, or end() if there is no such member
+        iterator find(const char *key, size_t length)
         {
-            case null: return true;
-            case boolean: return lhs.get_bool() == rhs.get_bool();
-            case integer: return lhs.get_int() == rhs.get_int();
-            case real: return lhs.get_real() == rhs.get_real();
-            case string: return lhs.get_string() == rhs.get_string();
-            case array: return lhs.get_array() == rhs.get_array();
-            case object: return lhs.get_object() == rhs.get_object();
-            default: return false;
+            iterator it = position(key, length);
+            return it != end() && compare_key(it->first, key, length) == 0? it: end();
         }
-    }
+        const_iterator find(const char *key, size_t length) const {return const_cast<flat_object *>(this)->find(key, length);}
+        iterator find(const string_t &key) {return find(key.data(), key.size());}
+        const_iterator find(const string_t &key) const {return find(key.data(), key.size());}
+        iterator find(cstring_t key) {return find(key, strlen(key));}
+        const_iterator find(cstring_t key) const {return find(key, strlen(key));}
+#ifdef JSON_STRING_VIEW
+        iterator find(std::string_view key) {return find(key.data(), key.size());}
+        const_iterator find(std::string_view key) const {return find(key.data(), key.size());}
+#endif
+        // Interned names of an insertion-ordered object are compared by pointer, unless the object is indexed
+        iterator find(const atom &key)
+        {
+            if (sorted || !index_.empty())
+                return find(key.data(), key.size());
 
-    inline bool operator!=(const value &lhs, const value &rhs)
-    {
-        return !(lhs == rhs);
-    }
+            iterator it = begin();
+            for (; it != end(); ++it)
+                if (it->first == key)
+                    break;
+            return it;
+        }
+        const_iterator find(const atom &key) const {return const_cast<flat_object *>(this)->find(key);}
 
-    inline bool stream_starts_with(std::istream &stream, const char *str)
-    {
-        int c;
-        while (*str)
+        template<typename Name>
+        size_type count(const Name &key) const {return find(key) != end();}
+
+        // Returns the member named `key`, adding a null member if there is none
+        value &operator[](const string_t &key) {return emplace_key(key).first->second;}
+        value &operator[](string_t &&key) {return emplace_key(std::move(key)).first->second;}
+        value &operator[](const atom &key) {return emplace_key(key).first->second;}
+
+        // Adds `member`, unless a member with the same name already exists
+        std::pair<iterator, bool> insert(const value_type &member) {return emplace_key(member.first, member.second);}
+        std::pair<iterator, bool> insert(value_type &&member) {return emplace_key(std::move(member.first), std::move(member.second));}
+
+        // Adds a member named `key` and returns its value, like operator[], except that a sorted object does not look
+        // for an existing member or keep its order until finish_members() is called
+        // Parsers call this for every member of an object they read, and then finish_members() once the object is complete,
+        // which costs one sort instead of an insertion into the middle of the vector for each member
+        // The object must not be used in any other way before it is finished
+        template<typename Name>
+        value &append_member(Name &&key)
         {
-            c = stream.get();
-            if ((*str++ & 0xff) != c) return false;
+            if (!sorted)
+                return emplace_key(std::forward<Name>(key)).first->second;
+
+            members_.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<Name>(key)), std::forward_as_tuple());
+            return members_.back().second;
         }
-        return true;
-    }
 
-    inline std::istream &read_string(std::istream &stream, std::string &str)
-    {
-        static const std::string hex = "0123456789ABCDEF";
-        int c;
+        // Orders the members added by append_member(), keeping the value of the last member with each name, as operator[] would
+        void finish_members()
+        {
+            if (!sorted)
+                return;
 
-        c = stream.get();
-        if (c != '"') throw error("expected string");
+            auto less = [](const value_type &lhs, const value_type &rhs) {return compare_key(lhs.first, rhs.first.data(), rhs.first.size()) < 0;};
+            if (std::adjacent_find(begin(), end(), [&less](const value_type &lhs, const value_type &rhs) {return !less(lhs, rhs);}) == end())
+                return; // Already in order without duplicates
 
-        str.clear();
-        while (c = stream.get(), c != '"')
-        {
-            if (c == EOF) throw error("unexpected end of string");
+            std::stable_sort(begin(), end(), less);
 
-            if (c == '\\')
+            iterator last = begin();
+            for (iterator it = begin() + 1; it != end(); ++it)
             {
-                c = stream.get();
-                if (c == EOF) throw error("unexpected end of string");
+                if (!less(*last, *it))
+                    last->second = std::move(it->second);
+                else if (++last != it)
+                    *last = std::move(*it);
+            }
+            members_.erase(last + 1, end());
+        }
 
-                switch (c)
-                {
-                    case 'b': str.push_back('\b'); break;
-                    case 'f': str.push_back('\f'); break;
-                    case 'n': str.push_back('\n'); break;
-                    case 'r': str.push_back('\r'); break;
-                    case 't': str.push_back('\t'); break;
-                    case 'u':
-                    {
-                        uint32_t code = 0;
-                        for (int i = 0; i < 4; ++i)
-                        {
-                            c = stream.get();
-                            if (c == EOF) throw error("unexpected end of string");
-                            size_t pos = hex.find(toupper(c));
-                            if (pos == std::string::npos) throw error("invalid character escape sequence");
-                            code = (code << 4) | pos;
-                        }
+        iterator erase(const_iterator pos)
+        {
+            iterator it = members_.erase(pos);
+            rebuild_index();
+            return it;
+        }
+        template<typename Name>
+        size_type erase(const Name &key)
+        {
+            iterator it = find(key);
+            if (it == end())
+                return 0;
 
-                        std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> utf8;
-                        str += utf8.to_bytes(code);
+            erase(const_iterator(it));
+            return 1;
+        }
 
-                        break;
-                    }
-                    default:
-                        str.push_back(c); break;
-                }
+        friend bool operator==(const flat_object &lhs, const flat_object &rhs)
+        {
+            if (lhs.size() != rhs.size())
+                return false;
+            else if (sorted)
+                return lhs.members_ == rhs.members_;
+
+            // Insertion order does not take part in comparison
+            for (const value_type &member: lhs)
+            {
+                const_iterator it = rhs.find(member.first);
+                if (it == rhs.end() || !(it->second == member.second))
+                    return false;
             }
-            else
-                str.push_back(c);
+            return true;
         }
+        friend bool operator!=(const flat_object &lhs, const flat_object &rhs) {return !(lhs == rhs);}
 
-        return stream;
-    }
+    private:
+        static int compare_key(const key_type &name, const char *key, size_t length)
+        {
+            int result = memcmp(name.data(), key, std::min(name.size(), length));
+            return result? result: name.size() < length? -1: name.size() > length;
+        }
 
-    inline std::ostream &write_string(std::ostream &stream, const std::string &str)
-    {
-        static const char hex[] = "0123456789ABCDEF";
-        stream << '"';
-        for (size_t i = 0; i < str.size(); ++i)
+        // FNV-1a hash of a member name
+        static size_t hash_key(const char *key, size_t length)
         {
-            int c = str[i] & 0xff;
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < length; ++i)
+                hash = (hash ^ static_cast<unsigned char>(key[i])) * 1099511628211ull;
+            return static_cast<size_t>(hash);
+        }
 
-            if (c == '"' || c == '\\')
-                stream << '\\' << static_cast<char>(c);
-            else
+        // Adds the member at `pos` to the hash table, rebuilding the table instead if it is more than half full
+        void index_member(size_type pos)
+        {
+            if (sorted || size() <= index_threshold)
+                return;
+            if (size() * 2 > index_.size())
             {
-                switch (c)
-                {
-                    case '"':
-                    case '\\': stream << '\\' << static_cast<char>(c); break;
-                    case '\b': stream << "\\b"; break;
-                    case '\f': stream << "\\f"; break;
-                    case '\n': stream << "\\n"; break;
-                    case '\r': stream << "\\r"; break;
-                    case '\t': stream << "\\t"; break;
-                    default:
-                        if (iscntrl(c))
-                            stream << "\\u00" << hex[c >> 4] << hex[c & 0xf];
-                        else
-                            stream << str[i];
-                        break;
-                }
+                rebuild_index();
+                return;
             }
+
+            const key_type &name = members_[pos].first;
+            const size_type mask = index_.size() - 1;
+            size_type bucket = hash_key(name.data(), name.size()) & mask;
+            while (index_[bucket])
+                bucket = (bucket + 1) & mask;
+            index_[bucket] = pos + 1;
         }
 
-        return stream << '"';
-    }
+        // Rebuilds the hash table of an insertion-ordered object from scratch, or drops it if the object is small enough
+        void rebuild_index()
+        {
+            index_.clear();
+            if (sorted || size() <= index_threshold)
+                return;
 
-    inline std::istream &operator>>(std::istream &stream, value &v)
-    {
-        char chr;
+            size_type buckets = 1;
+            while (buckets < size() * 4)
+                buckets *= 2;
+            index_.resize(buckets);
 
-        stream >> std::skipws >> chr, stream.unget(); // Peek at next character past whitespace
+            const size_type mask = buckets - 1;
+            for (size_type pos = 0; pos < size(); ++pos)
+            {
+                const key_type &name = members_[pos].first;
+                size_type bucket = hash_key(name.data(), name.size()) & mask;
+                while (index_[bucket])
+                    bucket = (bucket + 1) & mask;
+                index_[bucket] = pos + 1;
+            }
+        }
 
-        if (stream.good())
+        // Returns where a member named `key` is or would be inserted
+        // For unsorted objects, this is end() if there is no such member
+        iterator position(const atom &key) {return sorted || !index_.empty()? position(key.data(), key.size()): find(key);}
+        iterator position(const string_t &key) {return position(key.data(), key.size());}
+        iterator position(const char *key, size_t length)
         {
-            switch (chr)
+            if (!sorted && !index_.empty())
             {
-                case 'n':
-                    if (!stream_starts_with(stream, "null")) throw error("expected 'null' value");
-                    v.set_null();
-                    return stream;
-                case 't':
-                    if (!stream_starts_with(stream, "true")) throw error("expected 'true' value");
-                    v.set_bool(true);
-                    return stream;
-                case 'f':
-                    if (!stream_starts_with(stream, "false")) throw error("expected 'false' value");
-                    v.set_bool(false);
-                    return stream;
-                case '"':
+                const size_type mask = index_.size() - 1;
+                for (size_type bucket = hash_key(key, length) & mask; index_[bucket]; bucket = (bucket + 1) & mask)
                 {
-                    std::string str;
-                    read_string(stream, str);
-                    v.set_string(str);
-                    return stream;
+                    iterator it = begin() + (index_[bucket] - 1);
+                    if (it->first.size() == length && memcmp(it->first.data(), key, length) == 0)
+                        return it;
                 }
-                case '[':
-                    stream >> chr; // Eat '['
-                    v.set_array(array_t());
-
-                    // Peek at next character past whitespace
-                    stream >> chr;
+                return end();
+            }
+            else if (!sorted)
+            {
+                iterator it = begin();
+                for (; it != end(); ++it)
+                    if (it->first.size() == length && memcmp(it->first.data(), key, length) == 0)
+                        break;
+                return it;
+            }
+
+            iterator first = begin();
+            size_type count = size();
+            while (count > 0)
+            {
+                size_type half = count / 2;
+                if (compare_key(first[half].first, key, length) < 0)
+                {
+                    first += half + 1;
+                    count -= half + 1;
+                }
+                else
+                    count = half;
+            }
+            return first;
+        }
+
+        template<typename Name, typename... Args>
+        std::pair<iterator, bool> emplace_key(Name &&key, Args &&... args)
+        {
+            iterator it = position(key);
+            if (it != end() && (!sorted || compare_key(it->first, key.data(), key.size()) == 0))
+                return std::make_pair(it, false);
+
+            it = members_.emplace(it, std::piecewise_construct,
+                                  std::forward_as_tuple(std::forward<Name>(key)),
+                                  std::forward_as_tuple(std::forward<Args>(args)...));
+            if (!sorted)
+                index_member(it - begin());
+            return std::make_pair(it, true);
+        }
+
+        container members_;
+        // Hash table of an insertion-ordered object with more than index_threshold members, holding one more than
+        // the position of a member in each used bucket, and zero in each empty bucket. Empty if the object is not indexed
+        std::vector<size_type, typename std::allocator_traits<Allocator>::template rebind_alloc<size_type>> index_;
+    };
+
+    // Adds the member named `key` to the object `obj` that a parser is reading, and returns its value
+    // Once all members are added, the parser calls finish_members(), so that a sorted flat_object is ordered only once
+    template<typename Object, typename Name>
+    value &parse_member(Object &obj, Name &&key) {return obj[std::forward<Name>(key)];}
+    template<typename Object>
+    void finish_members(Object &) {}
+
+    template<bool sorted, typename Key, typename Allocator, typename Name>
+    value &parse_member(flat_object<sorted, Key, Allocator> &obj, Name &&key) {return obj.append_member(std::forward<Name>(key));}
+    template<bool sorted, typename Key, typename Allocator>
+    void finish_members(flat_object<sorted, Key, Allocator> &obj) {obj.finish_members();}
+
+#ifdef JSON_INTERNED_KEYS
+    typedef atom object_key_t;
+#else
+    typedef string_t object_key_t;
+#endif
+
+#ifdef JSON_PMR
+    typedef std::pmr::memory_resource memory_resource;
+    typedef std::pmr::vector<value> array_t;
+#if defined(JSON_ORDERED_OBJECT)
+    typedef flat_object<false, object_key_t, std::pmr::polymorphic_allocator<std::pair<object_key_t, value>>> object_t;
+#elif defined(JSON_FLAT_OBJECT)
+    typedef flat_object<true, object_key_t, std::pmr::polymorphic_allocator<std::pair<object_key_t, value>>> object_t;
+#else
+    typedef std::pmr::map<string_t, value, std::less<>> object_t;
+#endif
+#else
+    typedef std::vector<value> array_t;
+#if defined(JSON_ORDERED_OBJECT)
+    typedef flat_object<false, object_key_t> object_t;
+#elif defined(JSON_FLAT_OBJECT)
+    typedef flat_object<true, object_key_t> object_t;
+#elif __cplusplus >= 201402L
+    typedef std::map<string_t, value, std::less<>> object_t; // Transparent comparison allows lookup without a string_t
+#else
+    typedef std::map<string_t, value> object_t;
+#endif
+#endif
+
+    struct error
+    {
+        error(cstring_t reason, size_t offset = npos) : what_(reason), offset_(offset) {}
+
+        cstring_t what() const {return what_;}
+
+        // Byte offset into the input at which a parse error occured, or `npos` if not known
+        size_t offset() const {return offset_;}
+
+        static const size_t npos = static_cast<size_t>(-1);
+
+    private:
+        cstring_t what_;
+        size_t offset_;
+    };
+
+    // Thrown by parsers that validate UTF-8 (see utf8_validator) for a string that is not valid UTF-8,
+    // so that text in the wrong encoding can be told apart from malformed JSON
+    struct utf8_error : error
+    {
+        utf8_error(size_t offset = npos) : error("invalid UTF-8 in string", offset) {}
+    };
+
+    // Size of a buffer large enough for any number written by write_int() or write_real()
+    static const size_t max_number_length = 32;
+
+    // Writes `v` in decimal to `buf`, returning a pointer past the last character written
+    inline char *write_int(char *buf, int_t v)
+    {
+        char digits[20];
+        char *p = digits + sizeof(digits);
+        uint64_t u = v < 0? 0 - static_cast<uint64_t>(v): static_cast<uint64_t>(v);
+
+        do
+        {
+            *--p = '0' + u % 10;
+            u /= 10;
+        } while (u);
+
+        if (v < 0)
+            *buf++ = '-';
+
+        memcpy(buf, p, digits + sizeof(digits) - p);
+        return buf + (digits + sizeof(digits) - p);
+    }
+
+    // Parses an optional '-' followed by decimal digits in [begin, end)
+    // Returns false if the range is not an integer or does not fit in int_t
+    inline bool parse_int(const char *begin, const char *end, int_t &v)
+    {
+        const bool negative = begin != end && *begin == '-';
+        uint64_t u = 0;
+
+        if (negative)
+            ++begin;
+        if (begin == end)
+            return false;
+
+        for (; begin != end; ++begin)
+        {
+            const unsigned digit = static_cast<unsigned char>(*begin) - '0';
+            if (digit > 9 || u > (UINT64_MAX - digit) / 10)
+                return false;
+            u = u * 10 + digit;
+        }
+
+        if (u > static_cast<uint64_t>(INT64_MAX) + negative)
+            return false;
+
+        v = negative? (u == static_cast<uint64_t>(INT64_MAX) + 1? INT64_MIN: -static_cast<int_t>(u)): static_cast<int_t>(u);
+        return true;
+    }
+
+    // Parses a number in [begin, end) without regard to the current locale
+    // Returns false if the whole range is not a number, or it is out of range
+    inline bool parse_real(const char *begin, const char *end, real_t &r)
+    {
+#ifdef JSON_FLOAT_CHARCONV
+        const std::from_chars_result result = std::from_chars(begin, end, r);
+        return result.ec == std::errc() && result.ptr == end;
+#else
+        // Fast path: the result is exact if the significand and the power of ten are both exactly representable
+        static const real_t powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        const char *p = begin;
+        const bool negative = p != end && *p == '-';
+        uint64_t significand = 0;
+        int significant_digits = 0, exponent = 0, digits = 0;
+        bool exact = true;
+
+        if (negative)
+            ++p;
+
+        for (; p != end && isdigit(*p & 0xff); ++p, ++digits)
+        {
+            if (significand || *p != '0')
+                exact &= ++significant_digits <= 19;
+            significand = significand * 10 + (*p - '0');
+        }
+
+        if (p != end && *p == '.')
+            for (++p; p != end && isdigit(*p & 0xff); ++p, ++digits, --exponent)
+            {
+                if (significand || *p != '0')
+                    exact &= ++significant_digits <= 19;
+                significand = significand * 10 + (*p - '0');
+            }
+
+        if (digits && p != end && (*p == 'e' || *p == 'E'))
+        {
+            int_t e = 0;
+            const char *exp_begin = ++p;
+
+            if (p != end && *p == '+')
+                exp_begin = ++p;
+            while (p != end && isdigit(*p & 0xff))
+                ++p;
+
+            exact &= p - exp_begin < 6 && parse_int(exp_begin, p, e);
+            exponent += static_cast<int>(e);
+        }
+
+        if (exact && digits && p == end && significand <= (uint64_t(1) << DBL_MANT_DIG) &&
+                exponent >= -22 && exponent <= 22 && FLT_EVAL_METHOD == 0)
+        {
+            r = exponent < 0? significand / powers[-exponent]: significand * powers[exponent];
+            if (negative)
+                r = -r;
+            return true;
+        }
+
+        // Slow path: the number is copied out because the buffer is not required to be null-terminated
+        std::istringstream stream(std::string(begin, end));
+        stream.imbue(std::locale::classic());
+        stream >> r;
+        return !stream.fail() && stream.peek() == EOF;
+#endif
+    }
+
+    // Writes `v` to `buf`, returning a pointer past the last character written
+    // The result always reads back as exactly `v`. Infinities and NaN have no JSON representation and are written as null
+    inline char *write_real(char *buf, real_t v)
+    {
+        if (!std::isfinite(v))
+        {
+            memcpy(buf, "null", 4);
+            return buf + 4;
+        }
+
+#ifdef JSON_FLOAT_CHARCONV
+        return std::to_chars(buf, buf + max_number_length, v).ptr;
+#else
+        // Use the fewest significant digits (between 15 and 17) that round-trip
+        const char point = *localeconv()->decimal_point;
+        char *end = buf;
+        for (int precision = 15; precision <= 17; ++precision)
+        {
+            end = buf + snprintf(buf, max_number_length, "%.*g", precision, v);
+            if (point != '.')
+                std::replace(buf, end, point, '.');
+
+            real_t r;
+            if (parse_real(buf, end, r) && r == v)
+                break;
+        }
+        return end;
+#endif
+    }
+
+    /* value class - A single JSON value of any type.
+     *
+     * Only one member is active at a time. Scalars are stored inline, while strings, arrays,
+     * and objects are held through a pointer so that a value stays the size of its largest
+     * scalar plus the type tag, regardless of which container types it could hold.
+     *
+     * With JSON_PMR defined, each value also records the memory resource its containers are
+     * allocated from, and values are allocator-aware, so arrays and objects pass their resource
+     * on to the values they hold. A tree parsed into a std::pmr::monotonic_buffer_resource then
+     * needs no heap allocations beyond the characters of long strings, and the resource
+     * frees everything at once when released. Copies use the default resource, while moves
+     * keep the source's resource. A monotonic_buffer_resource is not thread-safe, so a tree using
+     * one is only ever built by one thread (see structural_index::parse_parallel()).
+     *
+     * Inside a borrowed_value, a string may also be borrowed, referring to characters in the parsed
+     * buffer instead of holding a copy. Such values are only reachable through borrowed_value::ref,
+     * which reads strings as string_ref, and copying one out with borrowed_value::ref::get_value()
+     * copies its strings, so a value obtained through the public interface always owns its strings.
+     */
+    class value
+    {
+    public:
+        value() : type_(null) {}
+        value(bool_t v) : type_(boolean) {bool_ = v;}
+        value(int_t v) : type_(integer) {int_ = v;}
+        value(real_t v) : type_(real) {real_ = v;}
+        value(cstring_t v) : type_(string) {str_ = create<string_t>(v);}
+        value(const string_t &v) : type_(string) {str_ = create<string_t>(v);}
+        value(const array_t &v) : type_(array) {arr_ = create<array_t>(v);}
+        value(const object_t &v) : type_(object) {obj_ = create<object_t>(v);}
+        value(string_t &&v) : type_(string) {str_ = create<string_t>(std::move(v));}
+        value(array_t &&v) : type_(array) {arr_ = create<array_t>(std::move(v));}
+        value(object_t &&v) : type_(object) {obj_ = create<object_t>(std::move(v));}
+        template<typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+        value(T v) : type_(integer) {int_ = v;}
+        template<typename T, typename std::enable_if<std::is_floating_point<T>::value, int>::type = 0>
+        value(T v) : type_(real) {real_ = v;}
+
+        value(const value &other) : type_(null) {copy_from(other);}
+        // Moves never allocate, since the new value takes over the source's resource, so containers can move values when they grow
+#ifdef JSON_PMR
+        value(value &&other) noexcept : type_(null), resource_(other.resource_) {move_from(other);}
+#else
+        value(value &&other) noexcept : type_(null) {move_from(other);}
+#endif
+        ~value() {destroy();}
+
+#ifdef JSON_PMR
+        typedef std::pmr::polymorphic_allocator<value> allocator_type;
+
+        explicit value(memory_resource *resource) : type_(null), resource_(resource) {}
+        value(std::allocator_arg_t, const allocator_type &alloc) : type_(null), resource_(alloc.resource()) {}
+        value(std::allocator_arg_t, const allocator_type &alloc, const value &other) : type_(null), resource_(alloc.resource()) {copy_from(other);}
+        value(std::allocator_arg_t, const allocator_type &alloc, value &&other) : type_(null), resource_(alloc.resource()) {move_from(other);}
+
+        allocator_type get_allocator() const {return resource_;}
+        memory_resource *get_resource() const {return resource_;}
+#endif
+
+        value &operator=(const value &other)
+        {
+            if (this != &other)
+            {
+#ifdef JSON_PMR
+                value copy(std::allocator_arg, resource_, other);
+#else
+                value copy(other);
+#endif
+                swap(copy);
+            }
+            return *this;
+        }
+        value &operator=(value &&other)
+        {
+            if (this != &other)
+            {
+                value temp(std::move(other)); // `other` may be owned by this value, as in `v = std::move(v["key"])`
+                destroy();
+                type_ = null;
+                move_from(temp);
+            }
+            return *this;
+        }
+
+        void swap(value &other)
+        {
+            value temp(std::move(other));
+            other = std::move(*this);
+            *this = std::move(temp);
+        }
+
+        type get_type() const {return type_;}
+        size_t size() const {return type_ == array? arr_->size(): type_ == object? obj_->size(): 0;}
+
+        bool_t is_null() const {return type_ == null;}
+        bool_t is_bool() const {return type_ == boolean;}
+        bool_t is_int() const {return type_ == integer;}
+        bool_t is_real() const {return type_ == real || type_ == integer;}
+        bool_t is_string() const {return type_ == string;}
+        bool_t is_array() const {return type_ == array;}
+        bool_t is_object() const {return type_ == object;}
+
+        bool_t get_bool() const {return type_ == boolean? bool_: false;}
+        int_t get_int() const {return type_ == integer? int_: 0;}
+        real_t get_real() const {return type_ == integer? int_: type_ == real? real_: 0.0;}
+        cstring_t get_cstring() const {return get_string().c_str();}
+        const string_t &get_string() const {return type_ == string? *str_: empty_string();}
+        string_ref get_string_ref() const {return type_ != string? string_ref(): is_borrowed()? string_ref(view_, view_size_): string_ref(*str_);}
+        const array_t &get_array() const {return type_ == array? *arr_: empty_array();}
+        const object_t &get_object() const {return type_ == object? *obj_: empty_object();}
+
+        bool_t &get_bool() {clear(boolean); return bool_;}
+        int_t &get_int() {clear(integer); return int_;}
+        real_t &get_real() {clear(real); return real_;}
+        string_t &get_string() {clear(string); return *str_;}
+        array_t &get_array() {clear(array); return *arr_;}
+        object_t &get_object() {clear(object); return *obj_;}
+
+        void set_null() {clear(null);}
+        void set_bool(bool_t v) {clear(boolean); bool_ = v;}
+        void set_int(int_t v) {clear(integer); int_ = v;}
+        void set_real(real_t v) {clear(real); real_ = v;}
+        void set_string(cstring_t v) {clear(string); *str_ = v;}
+        void set_string(const string_t &v) {clear(string); *str_ = v;}
+        void set_array(const array_t &v) {clear(array); *arr_ = v;}
+        void set_object(const object_t &v) {clear(object); *obj_ = v;}
+        void set_string(string_t &&v) {clear(string); *str_ = std::move(v);}
+        void set_array(array_t &&v) {clear(array); *arr_ = std::move(v);}
+        void set_object(object_t &&v) {clear(object); *obj_ = std::move(v);}
+
+
+        // Returns a pointer to the member named `key`, or NULL if this is not an object or has no such member
+        // Depending on object_t, the lookup may not need to construct a string_t from `key`
+        const value *find(const string_t &key) const {return find_member(key);}
+        const value *find(cstring_t key) const {return find_member(key);}
+        value *find(const string_t &key) {return const_cast<value *>(find_member(key));}
+        value *find(cstring_t key) {return const_cast<value *>(find_member(key));}
+        const value *find(const atom &key) const {return find_member(key);}
+        value *find(const atom &key) {return const_cast<value *>(find_member(key));}
+#ifdef JSON_STRING_VIEW
+        const value *find(std::string_view key) const {return find_member(key);}
+        value *find(std::string_view key) {return const_cast<value *>(find_member(key));}
+#endif
+
+        // Returns the member named `key`, or a shared null value if this is not an object or has no such member
+        const value &operator[](const string_t &key) const
+        {
+            const value *v = find(key);
+            return v? *v: null_value();
+        }
+        value &operator[](const string_t &key) {clear(object); return (*obj_)[key];}
+        value &operator[](const atom &key) {clear(object); return (*obj_)[key];}
+        bool_t is_member(cstring_t key) const {return find_member(key) != NULL;}
+        bool_t is_member(const string_t &key) const {return find_member(key) != NULL;}
+        bool_t is_member(const atom &key) const {return find_member(key) != NULL;}
+#ifdef JSON_STRING_VIEW
+        bool_t is_member(std::string_view key) const {return find_member(key) != NULL;}
+#endif
+        void erase(const string_t &key) {if (type_ == object) obj_->erase(key);}
+
+        void push_back(const value &v) {clear(array); arr_->push_back(v);}
+        void push_back(value &&v) {clear(array); arr_->push_back(std::move(v));}
+        const value &operator[](size_t pos) const {return (*arr_)[pos];}
+        value &operator[](size_t pos) {return (*arr_)[pos];}
+        void erase(int_t pos) {if (type_ == array) arr_->erase(arr_->begin() + pos);}
+
+        // The following are convenience conversion functions
+        bool_t get_bool(bool_t default_) const {return is_bool()? bool_: default_;}
+        int_t get_int(int_t default_) const {return is_int()? int_: default_;}
+        real_t get_real(real_t default_) const {return is_real()? get_real(): default_;}
+        cstring_t get_string(cstring_t default_) const {return is_string()? get_string().c_str(): default_;}
+        string_t get_string(const string_t &default_) const {return is_string()? get_string_ref().str(): default_;}
+        array_t get_array(const array_t &default_) const {return is_array()? *arr_: default_;}
+        object_t get_object(const object_t &default_) const {return is_object()? *obj_: default_;}
+
+        bool_t as_bool(bool_t default_ = false) const {return value(*this).convert_to(boolean, default_).bool_;}
+        int_t as_int(int_t default_ = 0) const {return value(*this).convert_to(integer, default_).int_;}
+        real_t as_real(real_t default_ = 0.0) const {return value(*this).convert_to(real, default_).real_;}
+        string_t as_string(const string_t &default_ = string_t()) const {return *value(*this).convert_to(string, default_).str_;}
+        array_t as_array(const array_t &default_ = array_t()) const {return *value(*this).convert_to(array, default_).arr_;}
+        object_t as_object(const object_t &default_ = object_t()) const {return *value(*this).convert_to(object, default_).obj_;}
+
+        bool_t &convert_to_bool(bool_t default_ = false) {return convert_to(boolean, default_).bool_;}
+        int_t &convert_to_int(int_t default_ = 0) {return convert_to(integer, default_).int_;}
+        real_t &convert_to_real(real_t default_ = 0.0) {return convert_to(real, default_).real_;}
+        string_t &convert_to_string(const string_t &default_ = string_t()) {return *convert_to(string, default_).str_;}
+        array_t &convert_to_array(const array_t &default_ = array_t()) {return *convert_to(array, default_).arr_;}
+        object_t &convert_to_object(const object_t &default_ = object_t()) {return *convert_to(object, default_).obj_;}
+
+    private:
+        static const value &null_value() {static const value v; return v;}
+        static const string_t &empty_string() {static const string_t s; return s;}
+        static const array_t &empty_array() {static const array_t a; return a;}
+        static const object_t &empty_object() {static const object_t o; return o;}
+
+        friend class parser;
+        friend class cbor_parser;
+
+        // Value of view_size_ for a string that is not borrowed
+        static const uint32_t owned_string = UINT32_MAX;
+
+        bool_t is_borrowed() const {return type_ == string && view_size_ != owned_string;}
+
+        // Makes this a string that refers to the `length` characters at `data` without copying them
+        // The characters must outlive this value, or at least its borrowed strings
+        void borrow_string(const char *data, size_t length)
+        {
+            if (length >= owned_string)
+            {
+                set_string(string_t(data, length));
+                return;
+            }
+
+            destroy();
+            type_ = string;
+            view_ = data;
+            view_size_ = static_cast<uint32_t>(length);
+        }
+
+        // Replaces a borrowed string with an owned copy of its characters, and returns the owned string
+        string_t *own_string()
+        {
+            if (is_borrowed())
+            {
+                string_t *str = create<string_t>(view_, view_size_);
+                view_size_ = owned_string;
+                str_ = str;
+            }
+            return str_;
+        }
+
+        template<typename Key>
+        const value *find_member(const Key &key) const
+        {
+            if (type_ != object)
+                return NULL;
+
+            auto it = obj_->find(key);
+            return it != obj_->end()? &it->second: NULL;
+        }
+
+        // Allocates a container from this value's memory resource
+        template<typename T, typename... Args>
+        T *create(Args &&... args)
+        {
+#ifdef JSON_PMR
+            std::pmr::polymorphic_allocator<T> alloc(resource_);
+            T *p = alloc.allocate(1);
+            try {alloc.construct(p, std::forward<Args>(args)...);}
+            catch (...) {alloc.deallocate(p, 1); throw;}
+            return p;
+#else
+            return new T(std::forward<Args>(args)...);
+#endif
+        }
+
+        // Frees a container allocated with create()
+        template<typename T>
+        void dispose(T *p)
+        {
+#ifdef JSON_PMR
+            p->~T();
+            std::pmr::polymorphic_allocator<T>(resource_).deallocate(p, 1);
+#else
+            delete p;
+#endif
+        }
+
+        // Releases the active member, leaving the value in an unspecified state that must be reassigned
+        void destroy()
+        {
+            switch (type_)
+            {
+                case string: if (view_size_ == owned_string) dispose(str_); break;
+                case array: dispose(arr_); break;
+                case object: dispose(obj_); break;
+                default: break;
+            }
+            view_size_ = owned_string;
+        }
+
+        // Assumes this value holds no active container
+        void copy_from(const value &other)
+        {
+            switch (other.type_)
+            {
+                case boolean: bool_ = other.bool_; break;
+                case integer: int_ = other.int_; break;
+                case real: real_ = other.real_; break;
+                case string: str_ = other.is_borrowed()? create<string_t>(other.view_, other.view_size_): create<string_t>(*other.str_); break;
+                case array: arr_ = create<array_t>(*other.arr_); break;
+                case object: obj_ = create<object_t>(*other.obj_); break;
+                default: break;
+            }
+            type_ = other.type_;
+        }
+
+        // Assumes this value holds no active container, and leaves `other` null unless its containers had to be copied
+        void move_from(value &other)
+        {
+#ifdef JSON_PMR
+            // Containers can only be taken over if they were allocated from the same resource
+            if (resource_ != other.resource_ && *resource_ != *other.resource_)
+            {
+                copy_from(other);
+                return;
+            }
+#endif
+            switch (other.type_)
+            {
+                case boolean: bool_ = other.bool_; break;
+                case integer: int_ = other.int_; break;
+                case real: real_ = other.real_; break;
+                case string:
+                    if (other.is_borrowed())
+                        view_ = other.view_;
+                    else
+                        str_ = other.str_;
+                    view_size_ = other.view_size_;
+                    break;
+                case array: arr_ = other.arr_; break;
+                case object: obj_ = other.obj_; break;
+                default: break;
+            }
+            type_ = other.type_;
+            other.type_ = null;
+            other.view_size_ = owned_string;
+        }
+
+        void clear(type new_type)
+        {
+            if (type_ == new_type)
+            {
+                if (new_type == string)
+                    own_string();
+                return;
+            }
+
+            destroy();
+            type_ = null;
+            switch (new_type)
+            {
+                case boolean: bool_ = false; break;
+                case integer: int_ = 0; break;
+                case real: real_ = 0.0; break;
+                case string: str_ = create<string_t>(); break;
+                case array: arr_ = create<array_t>(); break;
+                case object: obj_ = create<object_t>(); break;
+                default: break;
+            }
+            type_ = new_type;
+        }
+
+        value &convert_to(type new_type, value default_value)
+        {
+            own_string();
+            if (type_ == new_type)
+                return *this;
+
+            switch (type_)
+            {
+                case null: *this = std::move(default_value); break;
+                case boolean:
+                {
+                    bool_t b = bool_;
+                    switch (new_type)
+                    {
+                        case integer: set_int(b); break;
+                        case real: set_real(b); break;
+                        case string: set_string(b? "true": "false"); break;
+                        default: *this = std::move(default_value); break;
+                    }
+                    break;
+                }
+                case integer:
+                {
+                    int_t i = int_;
+                    switch (new_type)
+                    {
+                        case boolean: set_bool(i != 0); break;
+                        case real: set_real(static_cast<real_t>(i)); break;
+                        case string:
+                        {
+                            char buf[max_number_length];
+                            set_string(std::string(buf, write_int(buf, i)));
+                            break;
+                        }
+                        default: *this = std::move(default_value); break;
+                    }
+                    break;
+                }
+                case real:
+                {
+                    real_t r = real_;
+                    switch (new_type)
+                    {
+                        case boolean: set_bool(r != 0.0); break;
+                        case integer: set_int((r >= -9223372036854775808.0 && r < 9223372036854775808.0)? static_cast<int_t>(trunc(r)): 0); break;
+                        case string:
+                        {
+                            char buf[max_number_length];
+                            set_string(std::string(buf, write_real(buf, r)));
+                            break;
+                        }
+                        default: *this = std::move(default_value); break;
+                    }
+                    break;
+                }
+                case string:
+                {
+                    switch (new_type)
+                    {
+                        case boolean: set_bool(*str_ == "true"); break;
+                        case integer:
+                        {
+                            std::istringstream str(*str_);
+                            int_t i;
+                            str >> i;
+                            set_int(str? i: 0);
+                            break;
+                        }
+                        case real:
+                        {
+                            std::istringstream str(*str_);
+                            real_t r;
+                            str >> r;
+                            set_real(str? r: 0.0);
+                            break;
+                        }
+                        default: *this = std::move(default_value); break;
+                    }
+                    break;
+                }
+                default: *this = std::move(default_value); break;
+            }
+
+            // A default value of the wrong type must still leave the requested member active
+            if (type_ != new_type)
+                clear(new_type);
+
+            return *this;
+        }
+
+        type type_;
+        uint32_t view_size_ = owned_string; // Length of a borrowed string, which fits beside the type tag
+        union
+        {
+            bool_t bool_;
+            int_t int_;
+            real_t real_;
+            string_t *str_;
+            const char *view_; // Characters of a borrowed string
+            array_t *arr_;
+            object_t *obj_;
+        };
+#ifdef JSON_PMR
+        memory_resource *resource_ = std::pmr::get_default_resource();
+#endif
+    };
+
+    inline bool operator==(const value &lhs, const value &rhs)
+    {
+        if (lhs.get_type() != rhs.get_type())
+            return false;
+
+        switch (lhs.get_type())
+        {
+            case null: return true;
+            case boolean: return lhs.get_bool() == rhs.get_bool();
+            case integer: return lhs.get_int() == rhs.get_int();
+            case real: return lhs.get_real() == rhs.get_real();
+            case string: return lhs.get_string_ref() == rhs.get_string_ref();
+            case array: return lhs.get_array() == rhs.get_array();
+            case object: return lhs.get_object() == rhs.get_object();
+            default: return false;
+        }
+    }
+
+    inline bool operator!=(const value &lhs, const value &rhs)
+    {
+        return !(lhs == rhs);
+    }
+
+    // Returns the 64-bit XXH64 hash of the `length` bytes at `data`
+    inline uint64_t hash_bytes(const char *data, size_t length, uint64_t seed = 0)
+    {
+        static const uint64_t p1 = 11400714785074694791ull, p2 = 14029467366897019727ull, p3 = 1609587929392839161ull,
+                              p4 = 9650029242287828579ull, p5 = 2870177450012600261ull;
+
+        struct impl
+        {
+            static uint64_t rotl(uint64_t x, int r) {return (x << r) | (x >> (64 - r));}
+            static uint64_t round(uint64_t acc, uint64_t input) {return rotl(acc + input * p2, 31) * p1;}
+            static uint64_t merge(uint64_t acc, uint64_t v) {return (acc ^ round(0, v)) * p1 + p4;}
+
+            // Reads little-endian, so hashes are the same on every platform
+            static uint64_t read(const unsigned char *p, size_t bytes)
+            {
+                uint64_t v = 0;
+                for (size_t i = bytes; i > 0; --i)
+                    v = (v << 8) | p[i-1];
+                return v;
+            }
+        };
+
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data), *end = p + length;
+        uint64_t h;
+
+        if (length >= 32)
+        {
+            uint64_t v1 = seed + p1 + p2, v2 = seed + p2, v3 = seed, v4 = seed - p1;
+            for (; end - p >= 32; p += 32)
+            {
+                v1 = impl::round(v1, impl::read(p, 8));
+                v2 = impl::round(v2, impl::read(p + 8, 8));
+                v3 = impl::round(v3, impl::read(p + 16, 8));
+                v4 = impl::round(v4, impl::read(p + 24, 8));
+            }
+
+            h = impl::rotl(v1, 1) + impl::rotl(v2, 7) + impl::rotl(v3, 12) + impl::rotl(v4, 18);
+            h = impl::merge(impl::merge(impl::merge(impl::merge(h, v1), v2), v3), v4);
+        }
+        else
+            h = seed + p5;
+
+        h += length;
+        for (; end - p >= 8; p += 8)
+            h = impl::rotl(h ^ impl::round(0, impl::read(p, 8)), 27) * p1 + p4;
+        if (end - p >= 4)
+        {
+            h = impl::rotl(h ^ (impl::read(p, 4) * p1), 23) * p2 + p3;
+            p += 4;
+        }
+        for (; p != end; ++p)
+            h = impl::rotl(h ^ (*p * p5), 11) * p1;
+
+        h ^= h >> 33;
+        h *= p2;
+        h ^= h >> 29;
+        h *= p3;
+        return h ^ (h >> 32);
+    }
+
+    // Returns a 64-bit hash of `v` that is equal for equal values, whatever the order of their object members
+    // Strings are hashed with XXH64, and the member hashes of an object are combined by addition, so
+    // objects with members in a different order (as with JSON_ORDERED_OBJECT) hash the same.
+    // Comparing hashes is a cheap way to find out whether a document changed since it was read
+    inline uint64_t canonical_hash(const value &v, uint64_t seed = 0)
+    {
+        struct impl
+        {
+            // Hashes a fixed-size item, using the XXH64 code path for 8 bytes of input
+            static uint64_t mix(uint64_t seed, type t, uint64_t bits)
+            {
+                char buf[8];
+                for (size_t i = 0; i < 8; ++i, bits >>= 8)
+                    buf[i] = static_cast<char>(bits & 0xff);
+                return hash_bytes(buf, 8, seed + t);
+            }
+        };
+
+        switch (v.get_type())
+        {
+            case boolean: return impl::mix(seed, boolean, v.get_bool());
+            case integer: return impl::mix(seed, integer, static_cast<uint64_t>(v.get_int()));
+            case real:
+            {
+                real_t r = v.get_real();
+                uint64_t bits;
+                if (r == 0.0)
+                    r = 0.0; // -0.0 compares equal to 0.0
+                memcpy(&bits, &r, sizeof(bits));
+                return impl::mix(seed, real, bits);
+            }
+            case string:
+            {
+                const string_ref str = v.get_string_ref();
+                return hash_bytes(str.data(), str.size(), seed + string);
+            }
+            case array:
+            {
+                uint64_t h = impl::mix(seed, array, v.size());
+                for (const value &item: v.get_array())
+                    h = impl::mix(h, array, canonical_hash(item, seed));
+                return h;
+            }
+            case object:
+            {
+                uint64_t sum = 0;
+                for (auto it = v.get_object().begin(); it != v.get_object().end(); ++it)
+                {
+                    const string_t &key = it->first;
+                    sum += impl::mix(hash_bytes(key.data(), key.size(), seed), object, canonical_hash(it->second, seed));
+                }
+                return impl::mix(seed + v.size(), object, sum);
+            }
+            default: return impl::mix(seed, null, 0);
+        }
+    }
+
+    // Parses the number in [begin, end) into `v`
+    // Integers are parsed exactly when they fit in int_t. Otherwise, integral reals that fit are narrowed to int_t
+    inline bool parse_number(const char *begin, const char *end, value &v)
+    {
+        int_t i;
+        real_t r;
+
+        if (parse_int(begin, end, i))
+            v.set_int(i);
+        else if (!parse_real(begin, end, r))
+            return false;
+        else if (r == trunc(r) && r >= -9223372036854775808.0 && r < 9223372036854775808.0)
+            v.set_int(static_cast<int_t>(r));
+        else
+            v.set_real(r);
+
+        return true;
+    }
+
+    // True if parsers check that strings are valid UTF-8 unless told otherwise (see JSON_VALIDATE_UTF8)
+#ifdef JSON_VALIDATE_UTF8
+    static const bool validate_utf8_by_default = true;
+#else
+    static const bool validate_utf8_by_default = false;
+#endif
+
+    /* utf8_validator class - Checks that text is well-formed UTF-8, as defined by RFC 3629.
+     *
+     * Overlong encodings, surrogate code points, and code points above U+10FFFF are rejected. Runs
+     * of ASCII are skipped 16 bytes at a time with SSE2 where available, so validating mostly-ASCII
+     * text costs little more than reading it. Text can be checked in pieces, and a sequence may be
+     * split between two pieces.
+     */
+    class utf8_validator
+    {
+    public:
+        utf8_validator() : state_(accept) {}
+
+        void reset() {state_ = accept;}
+
+        // Checks the next piece of text, returning a pointer to the first invalid byte, or `end` if there is none
+        // After an invalid byte, the validator must be reset before checking more text
+        const char *check(const char *p, const char *end)
+        {
+            while (p != end)
+            {
+#if defined(JSON_WRITER_SSE2)
+                if (state_ == accept)
+                {
+                    while (end - p >= 16 && _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))) == 0)
+                        p += 16;
+                    if (p == end)
+                        break;
+                }
+#endif
+                const unsigned char c = static_cast<unsigned char>(*p);
+                if (c >= 0x80 || state_ != accept)
+                {
+                    state_ = next(state_, c);
+                    if (state_ == reject)
+                        return p;
+                }
+                ++p;
+            }
+
+            return end;
+        }
+
+        // Returns true if the text checked so far does not end in the middle of a sequence
+        bool complete() const {return state_ == accept;}
+
+    private:
+        // The bytes still expected, with the narrower ranges allowed after certain lead bytes
+        enum state_type
+        {
+            accept,
+            one_more,
+            two_more,
+            three_more,
+            after_e0, // A0..BF, then one more
+            after_ed, // 80..9F (no surrogates), then one more
+            after_f0, // 90..BF, then two more
+            after_f4, // 80..8F (nothing above U+10FFFF), then two more
+            reject
+        };
+
+        static state_type next(state_type state, unsigned char c)
+        {
+            switch (state)
+            {
+                case accept:
+                    if (c < 0x80) return accept;
+                    if (c < 0xc2) return reject; // Continuation byte, or overlong two-byte sequence
+                    if (c < 0xe0) return one_more;
+                    if (c == 0xe0) return after_e0;
+                    if (c == 0xed) return after_ed;
+                    if (c < 0xf0) return two_more;
+                    if (c == 0xf0) return after_f0;
+                    if (c < 0xf4) return three_more;
+                    if (c == 0xf4) return after_f4;
+                    return reject;
+                case one_more: case two_more: case three_more:
+                    return c >= 0x80 && c <= 0xbf? static_cast<state_type>(state - 1): reject;
+                case after_e0: return c >= 0xa0 && c <= 0xbf? one_more: reject;
+                case after_ed: return c >= 0x80 && c <= 0x9f? one_more: reject;
+                case after_f0: return c >= 0x90 && c <= 0xbf? two_more: reject;
+                case after_f4: return c >= 0x80 && c <= 0x8f? two_more: reject;
+                default: return reject;
+            }
+        }
+
+        state_type state_;
+    };
+
+    // Returns true if the `length` bytes at `data` are well-formed UTF-8
+    inline bool is_valid_utf8(const char *data, size_t length)
+    {
+        utf8_validator validator;
+        return validator.check(data, data + length) == data + length && validator.complete();
+    }
+
+    // Decodes the four hex digits at `p` into `unit`, returning false if any of them is not a hex digit
+    inline bool decode_hex4(const char *p, uint32_t &unit)
+    {
+        // Value of each hex digit, or 0xff for other characters
+        static const unsigned char digits[256] = {
+#define JSON_HEX_ROW_INVALID 0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff
+            JSON_HEX_ROW_INVALID, JSON_HEX_ROW_INVALID, JSON_HEX_ROW_INVALID,
+            0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+            0xff, 10, 11, 12, 13, 14, 15, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+            JSON_HEX_ROW_INVALID,
+            0xff, 10, 11, 12, 13, 14, 15, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+            JSON_HEX_ROW_INVALID, JSON_HEX_ROW_INVALID, JSON_HEX_ROW_INVALID, JSON_HEX_ROW_INVALID,
+            JSON_HEX_ROW_INVALID, JSON_HEX_ROW_INVALID, JSON_HEX_ROW_INVALID, JSON_HEX_ROW_INVALID,
+            JSON_HEX_ROW_INVALID
+#undef JSON_HEX_ROW_INVALID
+        };
+
+        const uint32_t a = digits[static_cast<unsigned char>(p[0])], b = digits[static_cast<unsigned char>(p[1])],
+                       c = digits[static_cast<unsigned char>(p[2])], d = digits[static_cast<unsigned char>(p[3])];
+        if ((a | b | c | d) == 0xff)
+            return false;
+
+        unit = (a << 12) | (b << 8) | (c << 4) | d;
+        return true;
+    }
+
+    // Appends the UTF-8 encoding of `code` to `str`
+    inline void write_utf8(string_t &str, uint32_t code)
+    {
+        if (code < 0x80)
+            str.push_back(static_cast<char>(code));
+        else if (code < 0x800)
+        {
+            const char bytes[2] = {static_cast<char>(0xc0 | (code >> 6)), static_cast<char>(0x80 | (code & 0x3f))};
+            str.append(bytes, 2);
+        }
+        else if (code < 0x10000)
+        {
+            const char bytes[3] = {static_cast<char>(0xe0 | (code >> 12)), static_cast<char>(0x80 | ((code >> 6) & 0x3f)),
+                                   static_cast<char>(0x80 | (code & 0x3f))};
+            str.append(bytes, 3);
+        }
+        else
+        {
+            const char bytes[4] = {static_cast<char>(0xf0 | (code >> 18)), static_cast<char>(0x80 | ((code >> 12) & 0x3f)),
+                                   static_cast<char>(0x80 | ((code >> 6) & 0x3f)), static_cast<char>(0x80 | (code & 0x3f))};
+            str.append(bytes, 4);
+        }
+    }
+
+    // Appends the character for the UTF-16 code unit `unit` of a \u escape sequence to `str`
+    // A high surrogate is held in `high_surrogate` (which is zero otherwise) until the low surrogate after it
+    // completes the pair. Unpaired surrogates are replaced with U+FFFD, so the result is always valid UTF-8
+    inline void write_utf16_unit(string_t &str, uint32_t &high_surrogate, uint32_t unit)
+    {
+        if (unit >= 0xdc00 && unit <= 0xdfff && high_surrogate)
+        {
+            write_utf8(str, 0x10000 + ((high_surrogate - 0xd800) << 10) + (unit - 0xdc00));
+            high_surrogate = 0;
+            return;
+        }
+
+        if (high_surrogate)
+            write_utf8(str, 0xfffd);
+
+        high_surrogate = unit >= 0xd800 && unit <= 0xdbff? unit: 0;
+        if (!high_surrogate)
+            write_utf8(str, unit >= 0xdc00 && unit <= 0xdfff? 0xfffd: unit);
+    }
+
+    // Replaces a high surrogate left waiting by write_utf16_unit() with U+FFFD, since its pair was not completed
+    inline void end_utf16(string_t &str, uint32_t &high_surrogate)
+    {
+        if (high_surrogate)
+        {
+            write_utf8(str, 0xfffd);
+            high_surrogate = 0;
+        }
+    }
+
+    inline bool stream_starts_with(std::istream &stream, const char *str)
+    {
+        int c;
+        while (*str)
+        {
+            c = stream.get();
+            if ((*str++ & 0xff) != c) return false;
+        }
+        return true;
+    }
+
+    inline std::istream &read_string(std::istream &stream, std::string &str)
+    {
+        uint32_t high_surrogate = 0;
+        int c;
+
+        c = stream.get();
+        if (c != '"') throw error("expected string");
+
+        str.clear();
+        while (c = stream.get(), c != '"')
+        {
+            if (c == EOF) throw error("unexpected end of string");
+
+            if (c != '\\')
+            {
+                end_utf16(str, high_surrogate);
+                str.push_back(c);
+                continue;
+            }
+
+            c = stream.get();
+            if (c == EOF) throw error("unexpected end of string");
+
+            if (c == 'u')
+            {
+                char digits[4];
+                uint32_t unit;
+                if (!stream.read(digits, 4)) throw error("unexpected end of string");
+                if (!decode_hex4(digits, unit)) throw error("invalid character escape sequence");
+
+                write_utf16_unit(str, high_surrogate, unit);
+                continue;
+            }
+
+            end_utf16(str, high_surrogate);
+            switch (c)
+            {
+                case 'b': str.push_back('\b'); break;
+                case 'f': str.push_back('\f'); break;
+                case 'n': str.push_back('\n'); break;
+                case 'r': str.push_back('\r'); break;
+                case 't': str.push_back('\t'); break;
+                default:
+                    str.push_back(c); break;
+            }
+        }
+        end_utf16(str, high_surrogate);
+
+        return stream;
+    }
+
+    /* writer class - Serializes JSON values by appending to a caller-provided string.
+     *
+     * The output string is never cleared, so a single string can be reused for many values
+     * to avoid reallocating. String contents are scanned for characters that need escaping,
+     * and the runs between them are appended in one step. A nonzero indent width produces
+     * the same layout as pretty_print().
+     */
+    class writer
+    {
+    public:
+        writer(std::string &out, size_t indent_width = 0, size_t start_indent = 0)
+            : out_(out), indent_width_(indent_width), indent_(start_indent) {}
+
+        std::string &str() {return out_;}
+
+        // Reserves space in the output for at least `v`, based on estimate_size()
+        writer &reserve(const value &v)
+        {
+            out_.reserve(out_.size() + estimate_size(v));
+            return *this;
+        }
+
+        writer &write(const value &v)
+        {
+            switch (v.get_type())
+            {
+                case null: out_.append("null", 4); break;
+                case boolean: v.get_bool()? out_.append("true", 4): out_.append("false", 5); break;
+                case integer: write_int(v.get_int()); break;
+                case real: write_real(v.get_real()); break;
+                case string: write_string(v.get_string_ref()); break;
+                case array:
+                {
+                    const array_t &arr = v.get_array();
+                    if (arr.empty())
+                    {
+                        out_.append("[]", 2);
+                        break;
+                    }
+
+                    out_.push_back('[');
+                    ++indent_;
+                    for (auto it = arr.begin(); it != arr.end(); ++it)
+                    {
+                        if (it != arr.begin())
+                            out_.push_back(',');
+                        newline();
+                        write(*it);
+                    }
+                    --indent_;
+                    newline();
+                    out_.push_back(']');
+                    break;
+                }
+                case object:
+                {
+                    const object_t &obj = v.get_object();
+                    if (obj.empty())
+                    {
+                        out_.append("{}", 2);
+                        break;
+                    }
+
+                    out_.push_back('{');
+                    ++indent_;
+                    for (auto it = obj.begin(); it != obj.end(); ++it)
+                    {
+                        if (it != obj.begin())
+                            out_.push_back(',');
+                        newline();
+                        write_string(it->first);
+                        indent_width_? out_.append(": ", 2): out_.append(":", 1);
+                        write(it->second);
+                    }
+                    --indent_;
+                    newline();
+                    out_.push_back('}');
+                    break;
+                }
+            }
+
+            return *this;
+        }
+
+        writer &write_int(int_t v)
+        {
+            char buf[max_number_length];
+            out_.append(buf, json::write_int(buf, v) - buf);
+            return *this;
+        }
+
+        writer &write_real(real_t v)
+        {
+            char buf[max_number_length];
+            out_.append(buf, json::write_real(buf, v) - buf);
+            return *this;
+        }
+
+        writer &write_string(const string_t &str) {return write_string(str.data(), str.size());}
+        writer &write_string(string_ref str) {return write_string(str.data(), str.size());}
+        writer &write_string(const char *str, size_t length)
+        {
+            static const char hex[] = "0123456789ABCDEF";
+            const char *end = str + length;
+
+            out_.push_back('"');
+            while (true)
+            {
+                const char *run = find_escape(str, end);
+                out_.append(str, run - str);
+                if (run == end)
+                    break;
+
+                const char c = *run;
+                switch (c)
+                {
+                    case '"': out_.append("\\\"", 2); break;
+                    case '\\': out_.append("\\\\", 2); break;
+                    case '\b': out_.append("\\b", 2); break;
+                    case '\f': out_.append("\\f", 2); break;
+                    case '\n': out_.append("\\n", 2); break;
+                    case '\r': out_.append("\\r", 2); break;
+                    case '\t': out_.append("\\t", 2); break;
+                    default:
+                    {
+                        const char escape[6] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0xf], hex[c & 0xf]};
+                        out_.append(escape, 6);
+                        break;
+                    }
+                }
+                str = run + 1;
+            }
+            out_.push_back('"');
+
+            return *this;
+        }
+
+        // Returns an estimate of the serialized size of `v`, intended for reserving output space
+        // Strings are assumed to need no escaping, so the estimate is not an upper bound
+        static size_t estimate_size(const value &v)
+        {
+            switch (v.get_type())
+            {
+                default: return 5;
+                case integer: return 20;
+                case real: return 24;
+                case string: return v.get_string_ref().size() + 2;
+                case array:
+                {
+                    size_t size = 2;
+                    for (auto it = v.get_array().begin(); it != v.get_array().end(); ++it)
+                        size += estimate_size(*it) + 1;
+                    return size;
+                }
+                case object:
+                {
+                    size_t size = 2;
+                    for (auto it = v.get_object().begin(); it != v.get_object().end(); ++it)
+                        size += it->first.size() + estimate_size(it->second) + 4;
+                    return size;
+                }
+            }
+        }
+
+    private:
+        void newline()
+        {
+            if (indent_width_)
+            {
+                out_.push_back('\n');
+                out_.append(indent_width_ * indent_, ' ');
+            }
+        }
+
+        // Returns true if character `c` must be escaped in a JSON string (the quote, backslash, and all control characters)
+        static bool needs_escape(unsigned char c)
+        {
+            return c < 0x20 || c == '"' || c == '\\' || c == 0x7f;
+        }
+
+        // Returns a pointer to the first character in [begin, end) that must be escaped, or `end` if there is none
+        static const char *find_escape(const char *begin, const char *end)
+        {
+#if defined(JSON_WRITER_SSE2)
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i del = _mm_set1_epi8(0x7f);
+            const __m128i control = _mm_set1_epi8(0x1f);
+
+            for (; end - begin >= 16; begin += 16)
+            {
+                const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+                const __m128i found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(in, quote), _mm_cmpeq_epi8(in, backslash)),
+                                                   _mm_or_si128(_mm_cmpeq_epi8(in, del), _mm_cmpeq_epi8(_mm_max_epu8(in, control), control)));
+                const int mask = _mm_movemask_epi8(found);
+                if (mask)
+                {
+                    int bit = 0;
+                    while (!(mask & (1 << bit)))
+                        ++bit;
+                    return begin + bit;
+                }
+            }
+#else
+            // Check eight bytes at a time for any byte that is a quote, backslash, control character, or DEL
+            const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+            for (; end - begin >= 8; begin += 8)
+            {
+                uint64_t word;
+                memcpy(&word, begin, 8);
+                const uint64_t quote = word ^ (ones * '"');
+                const uint64_t backslash = word ^ (ones * '\\');
+                const uint64_t del = word ^ (ones * 0x7f);
+                const uint64_t found = ((quote - ones) & ~quote) | ((backslash - ones) & ~backslash) |
+                                       ((del - ones) & ~del) | ((word - ones * 0x20) & ~word);
+                if (found & highs)
+                    break;
+            }
+#endif
+
+            while (begin != end && !needs_escape(*begin))
+                ++begin;
+            return begin;
+        }
+
+        std::string &out_;
+        size_t indent_width_;
+        size_t indent_;
+    };
+
+    inline std::ostream &write_string(std::ostream &stream, const std::string &str)
+    {
+        std::string out;
+        writer(out).write_string(str);
+        return stream.write(out.data(), out.size());
+    }
+
+    inline std::istream &operator>>(std::istream &stream, value &v)
+    {
+        char chr;
+
+        stream >> std::skipws >> chr, stream.unget(); // Peek at next character past whitespace
+
+        if (stream.good())
+        {
+            switch (chr)
+            {
+                case 'n':
+                    if (!stream_starts_with(stream, "null")) throw error("expected 'null' value");
+                    v.set_null();
+                    return stream;
+                case 't':
+                    if (!stream_starts_with(stream, "true")) throw error("expected 'true' value");
+                    v.set_bool(true);
+                    return stream;
+                case 'f':
+                    if (!stream_starts_with(stream, "false")) throw error("expected 'false' value");
+                    v.set_bool(false);
+                    return stream;
+                case '"':
+                {
+                    std::string str;
+                    read_string(stream, str);
+                    v.set_string(std::move(str));
+                    return stream;
+                }
+                case '[':
+                    stream >> chr; // Eat '['
+                    v.set_array(array_t());
+
+                    // Peek at next character past whitespace
+                    stream >> chr;
                     if (!stream || chr == ']') return stream;
 
-                    stream.unget(); // Replace character we peeked at
-                    do
+                    stream.unget(); // Replace character we peeked at
+                    do
+                    {
+                        v.push_back(value());
+                        stream >> v.get_array().back(); // Read elements in place rather than copying them in
+
+                        stream >> chr;
+                        if (!stream || (chr != ',' && chr != ']'))
+                            throw error("expected ',' separating array elements or ']' ending array");
+                    } while (stream && chr != ']');
+
+                    return stream;
+                case '{':
+                    stream >> chr; // Eat '{'
+                    v.set_object(object_t());
+
+                    // Peek at next character past whitespace
+                    stream >> chr;
+                    if (!stream || chr == '}') return stream;
+
+                    stream.unget(); // Replace character we peeked at
+                    do
+                    {
+                        std::string key;
+
+                        read_string(stream >> std::ws, key);
+                        stream >> chr;
+                        if (chr != ':') throw error("expected ':' separating key and value in object");
+                        stream >> parse_member(v.get_object(), key);
+
+                        stream >> chr;
+                        if (!stream || (chr != ',' && chr != '}'))
+                            throw error("expected ',' separating key value pairs or '}' ending object");
+                    } while (stream && chr != '}');
+
+                    finish_members(v.get_object());
+                    return stream;
+                default:
+                    if (isdigit(chr) || chr == '-')
+                    {
+                        std::string number;
+                        while (chr = stream.peek(), isdigit(chr) || chr == '-' || chr == '+' || chr == '.' || chr == 'e' || chr == 'E')
+                            number.push_back(stream.get());
+
+                        if (!parse_number(number.data(), number.data() + number.size(), v))
+                            throw error("invalid number");
+
+                        return stream;
+                    }
+                    break;
+            }
+        }
+
+        throw error("expected JSON value");
+    }
+
+    /* event_handler class - Receives a JSON document as a series of events, as an alternative to building a value.
+     *
+     * Pass a handler to parse_events() or parser::parse_events(). Every callback returns true to
+     * continue parsing or false to stop. The default implementations ignore the event.
+     * Object members are reported as key() followed by the events for the member's value.
+     */
+    class event_handler
+    {
+    public:
+        virtual ~event_handler() {}
+
+        virtual bool null_value() {return true;}
+        virtual bool bool_value(bool_t) {return true;}
+        virtual bool int_value(int_t) {return true;}
+        virtual bool real_value(real_t) {return true;}
+        virtual bool string_value(const string_t &) {return true;}
+        virtual bool key(const string_t &) {return true;}
+        virtual bool start_array() {return true;}
+        virtual bool end_array() {return true;}
+        virtual bool start_object() {return true;}
+        virtual bool end_object() {return true;}
+    };
+
+    /* value_builder class - An event handler that builds the events it receives into a value.
+     */
+    class value_builder : public event_handler
+    {
+    public:
+        value_builder(value &v) : root_(&v), started_(false) {}
+
+        // Starts building a new value into `v`
+        void reset(value &v)
+        {
+            root_ = &v;
+            started_ = false;
+            stack_.clear();
+        }
+
+        // Returns true once a complete value has been built
+        bool complete() const {return started_ && stack_.empty();}
+
+        bool null_value() {slot().set_null(); return true;}
+        bool bool_value(bool_t v) {slot().set_bool(v); return true;}
+        bool int_value(int_t v) {slot().set_int(v); return true;}
+        bool real_value(real_t v) {slot().set_real(v); return true;}
+        bool string_value(const string_t &v) {slot().set_string(v); return true;}
+        bool key(const string_t &k) {key_ = object_key_t(k); return true;}
+        bool start_array() {value &v = slot(); v.set_array(array_t()); stack_.push_back(&v); return true;}
+        bool end_array() {stack_.pop_back(); return true;}
+        bool start_object() {value &v = slot(); v.set_object(object_t()); stack_.push_back(&v); return true;}
+        bool end_object() {finish_members(stack_.back()->get_object()); stack_.pop_back(); return true;}
+
+    private:
+        // Returns the value that the next event fills in
+        value &slot()
+        {
+            if (stack_.empty())
+            {
+                started_ = true;
+                return *root_;
+            }
+
+            value *top = stack_.back();
+            if (top->is_array())
+            {
+                top->push_back(value());
+                return top->get_array().back();
+            }
+
+            return parse_member(top->get_object(), key_);
+        }
+
+        value *root_;
+        bool started_;
+        object_key_t key_;
+        std::vector<value *> stack_;
+    };
+
+    /* pointer class - A JSON pointer (RFC 6901), such as "/value/rev", parsed once for repeated evaluation.
+     *
+     * Evaluating a pointer walks the value in place and returns a reference to the member it names,
+     * so it neither allocates nor copies, unlike a chain of operator[] calls. Reference tokens are
+     * stored as object_key_t, so with JSON_INTERNED_KEYS each member lookup compares atoms.
+     * A token made of digits (without leading zeros) also selects that element of an array.
+     */
+    class pointer
+    {
+    public:
+        struct token
+        {
+            object_key_t key;
+            size_t index; // Array index named by the token, or `npos` if it is not a valid index
+
+            static const size_t npos = static_cast<size_t>(-1);
+        };
+
+        pointer() {}
+        // Parses `path`, throwing json::error if it is neither empty nor starts with '/', or contains an invalid escape sequence
+        pointer(string_ref path) {parse(path);}
+        pointer(cstring_t path) {parse(path);}
+        pointer(const string_t &path) {parse(path);}
+
+        // Returns the number of reference tokens, which is zero for the pointer to the whole value
+        size_t size() const {return tokens_.size();}
+        bool empty() const {return tokens_.empty();}
+        const token &operator[](size_t pos) const {return tokens_[pos];}
+
+        // Returns the value this pointer refers to within `v`, or NULL if there is none
+        const value *find(const value &v) const
+        {
+            const value *p = &v;
+            for (const token &t: tokens_)
+            {
+                if (p->is_object())
+                    p = p->find(t.key);
+                else if (p->is_array() && t.index < p->size())
+                    p = &(*p)[t.index];
+                else
+                    return NULL;
+
+                if (p == NULL)
+                    return NULL;
+            }
+
+            return p;
+        }
+        value *find(value &v) const {return const_cast<value *>(find(static_cast<const value &>(v)));}
+
+        // Returns the value this pointer refers to within `v`, or a shared null value if there is none
+        const value &get(const value &v) const
+        {
+            static const value null;
+            const value *p = find(v);
+            return p? *p: null;
+        }
+
+        // Returns the pointer as text, with '~' and '/' escaped again
+        string_t str() const
+        {
+            string_t result;
+            for (const token &t: tokens_)
+                append_token(result, static_cast<const string_t &>(t.key));
+            return result;
+        }
+
+        // Appends '/' and the escaped reference token `name` to the pointer text `path`
+        static void append_token(string_t &path, string_ref name)
+        {
+            path.push_back('/');
+            for (char c: name)
+            {
+                if (c == '~')
+                    path.append("~0", 2);
+                else if (c == '/')
+                    path.append("~1", 2);
+                else
+                    path.push_back(c);
+            }
+        }
+
+    private:
+        void parse(string_ref path)
+        {
+            if (path.empty())
+                return;
+            if (path[0] != '/')
+                throw error("JSON pointer must start with '/'", 0);
+
+            string_t name;
+            for (size_t i = 1; i <= path.size(); ++i)
+            {
+                if (i == path.size() || path[i] == '/')
+                {
+                    tokens_.push_back(token{object_key_t(name), array_index(name)});
+                    name.clear();
+                }
+                else if (path[i] != '~')
+                    name.push_back(path[i]);
+                else if (i + 1 < path.size() && (path[i+1] == '0' || path[i+1] == '1'))
+                    name.push_back(path[++i] == '0'? '~': '/');
+                else
+                    throw error("invalid escape sequence in JSON pointer", i);
+            }
+        }
+
+        static size_t array_index(const string_t &name)
+        {
+            if (name.empty() || name.size() > 18 || (name[0] == '0' && name.size() > 1))
+                return token::npos;
+
+            size_t index = 0;
+            for (char c: name)
+            {
+                if (c < '0' || c > '9')
+                    return token::npos;
+                index = index * 10 + (c - '0');
+            }
+            return index;
+        }
+
+        std::vector<token> tokens_;
+    };
+
+    /* projection class - A set of JSON pointers selecting the parts of a value to keep.
+     *
+     * Projecting a value keeps each selected member along with the objects and arrays on the path to it,
+     * so the pointers give the same results on the projected value as on the original. An empty
+     * projection selects nothing, but rows_handler treats it as no projection at all.
+     */
+    class projection
+    {
+    public:
+        projection() {}
+        projection(std::initializer_list<pointer> fields) : fields_(fields) {}
+        projection(const std::vector<pointer> &fields) : fields_(fields) {}
+
+        projection &add(const pointer &field)
+        {
+            fields_.push_back(field);
+            return *this;
+        }
+
+        size_t size() const {return fields_.size();}
+        bool empty() const {return fields_.empty();}
+        const pointer &operator[](size_t pos) const {return fields_[pos];}
+
+    private:
+        std::vector<pointer> fields_;
+    };
+
+    /* projection_filter class - An event handler that passes on only the events for the parts of a value selected by a projection.
+     *
+     * Members and elements that are not selected are skipped as they are parsed, so a value_builder
+     * behind the filter never builds them. Within arrays on the path to a selected element, elements
+     * that are not selected are reported as nulls, so that array indices are preserved.
+     * Call reset() before each new value.
+     */
+    class projection_filter : public event_handler
+    {
+    public:
+        projection_filter(const projection &fields, event_handler &target) : fields_(&fields), target_(&target) {reset();}
+
+        void reset()
+        {
+            stack_.clear();
+            active_.clear();
+            pass_depth_ = 0;
+            skip_depth_ = 0;
+        }
+
+        bool null_value() {return scalar(&event_handler::null_value);}
+        bool bool_value(bool_t v) {return scalar(&event_handler::bool_value, v);}
+        bool int_value(int_t v) {return scalar(&event_handler::int_value, v);}
+        bool real_value(real_t v) {return scalar(&event_handler::real_value, v);}
+        bool string_value(const string_t &v) {return scalar(&event_handler::string_value, v);}
+
+        bool key(const string_t &k)
+        {
+            if (pass_depth_)
+                return target_->key(k);
+            if (!skip_depth_)
+                key_ = k;
+            return true;
+        }
+
+        bool start_array() {return start(&event_handler::start_array, true);}
+        bool end_array() {return end(&event_handler::end_array);}
+        bool start_object() {return start(&event_handler::start_object, false);}
+        bool end_object() {return end(&event_handler::end_object);}
+
+    private:
+        enum selection
+        {
+            not_selected,
+            selected,
+            on_path // Part of the value is selected
+        };
+
+        // A container on the path to a selected value
+        struct frame
+        {
+            size_t begin; // Range of active_ holding the fields that continue through this container
+            size_t end;
+            bool array;
+            size_t index; // Index of the next element, for arrays
+        };
+
+        // Finds how the next value is selected, appending the fields that continue through it to active_
+        selection select()
+        {
+            if (stack_.empty())
+            {
+                // The whole value
+                for (size_t i = 0; i < fields_->size(); ++i)
+                {
+                    if ((*fields_)[i].empty())
+                        return selected;
+                    active_.push_back(i);
+                }
+                return active_.empty()? not_selected: on_path;
+            }
+
+            const frame &f = stack_.back();
+            const size_t depth = stack_.size() - 1, start = active_.size();
+            for (size_t i = f.begin; i < f.end; ++i)
+            {
+                const pointer &field = (*fields_)[active_[i]];
+                const pointer::token &t = field[depth];
+                if (f.array? t.index != f.index: !(t.key == key_))
+                    continue;
+
+                if (field.size() == depth + 1)
+                    return selected;
+                active_.push_back(active_[i]);
+            }
+
+            return active_.size() == start? not_selected: on_path;
+        }
+
+        // Reports the key or array position of the next value to the target
+        bool place()
+        {
+            if (stack_.empty())
+                return true;
+
+            frame &f = stack_.back();
+            if (f.array)
+                return ++f.index, true;
+            return target_->key(key_);
+        }
+
+        // Reports a skipped element of an array on the path as null, to keep later indices right
+        bool skip()
+        {
+            if (stack_.empty() || !stack_.back().array)
+                return true;
+
+            ++stack_.back().index;
+            return target_->null_value();
+        }
+
+        template<typename... Params, typename... Args>
+        bool scalar(bool (event_handler::*event)(Params...), Args &&... args)
+        {
+            if (pass_depth_)
+                return (target_->*event)(std::forward<Args>(args)...);
+            if (skip_depth_)
+                return true;
+
+            const size_t start = active_.size();
+            const selection s = select();
+            active_.resize(start);
+
+            if (s != selected)
+                return skip();
+            return place() && (target_->*event)(std::forward<Args>(args)...);
+        }
+
+        bool start(bool (event_handler::*event)(), bool array)
+        {
+            if (pass_depth_)
+                return ++pass_depth_, (target_->*event)();
+            if (skip_depth_)
+                return ++skip_depth_, true;
+
+            const size_t start = active_.size();
+            const selection s = select();
+            if (s != on_path)
+                active_.resize(start);
+
+            switch (s)
+            {
+                case selected:
+                    ++pass_depth_;
+                    return place() && (target_->*event)();
+                case on_path:
+                    if (!place())
+                        return false;
+                    stack_.push_back(frame{start, active_.size(), array, 0});
+                    return (target_->*event)();
+                default:
+                    ++skip_depth_;
+                    return skip();
+            }
+        }
+
+        bool end(bool (event_handler::*event)())
+        {
+            if (pass_depth_)
+                return --pass_depth_, (target_->*event)();
+            if (skip_depth_)
+                return --skip_depth_, true;
+
+            active_.resize(stack_.back().begin);
+            stack_.pop_back();
+            return (target_->*event)();
+        }
+
+        const projection *fields_;
+        event_handler *target_;
+        std::vector<frame> stack_;
+        std::vector<size_t> active_; // Indexes of fields, in ranges owned by the frames of stack_
+        string_t key_; // Key of the next member, if it is not being passed on yet
+        size_t pass_depth_; // Nesting depth inside a selected container, or 0 if not in one
+        size_t skip_depth_; // Nesting depth inside a container that is not selected, or 0 if not in one
+    };
+
+    /* rows_handler class - An event handler that splits a CouchDB response into individual rows.
+     *
+     * Each element of the top-level "rows" array (as returned by views, _all_docs, and similar)
+     * is built into a value by itself and passed to the callback, so the full response is never
+     * held in memory at once. All other top-level members, such as "total_rows" and "offset",
+     * are collected into header(), where "rows" itself is left as an empty array.
+     * The callback may return false to stop parsing.
+     *
+     * Given a non-empty projection, each row is projected as it is parsed (see projection_filter),
+     * so the members of a row that are not selected are never built.
+     */
+    class rows_handler : public event_handler
+    {
+    public:
+        typedef std::function<bool (value &row)> callback_type;
+
+        rows_handler(callback_type callback, const projection &fields = projection())
+            : callback_(callback)
+            , fields_(fields)
+            , header_builder_(header_)
+            , row_builder_(row_)
+            , row_filter_(fields_, row_builder_)
+            , depth_(0)
+            , rows_depth_(0)
+            , rows_key_pending_(false)
+            , count_(0)
+        {}
+
+        // The response without its rows
+        const value &header() const {return header_;}
+        value &header() {return header_;}
+
+        // The number of rows passed to the callback so far
+        size_t rows() const {return count_;}
+
+        bool null_value() {return scalar(&event_handler::null_value);}
+        bool bool_value(bool_t v) {return scalar(&event_handler::bool_value, v);}
+        bool int_value(int_t v) {return scalar(&event_handler::int_value, v);}
+        bool real_value(real_t v) {return scalar(&event_handler::real_value, v);}
+        bool string_value(const string_t &v) {return scalar(&event_handler::string_value, v);}
+
+        bool key(const string_t &k)
+        {
+            if (depth_ == 1 && !in_rows())
+            {
+                // Hold back the "rows" key until it is known whether its value is an array
+                rows_key_pending_ = k == "rows";
+                return rows_key_pending_ || header_builder_.key(k);
+            }
+
+            return target().key(k);
+        }
+
+        bool start_array()
+        {
+            if (rows_key_pending_)
+            {
+                rows_key_pending_ = false;
+                rows_depth_ = ++depth_;
+                header_builder_.key("rows");
+                header_builder_.start_array();
+                return header_builder_.end_array();
+            }
+
+            return start(&event_handler::start_array);
+        }
+
+        bool end_array()
+        {
+            if (in_rows() && depth_ == rows_depth_)
+            {
+                rows_depth_ = 0;
+                --depth_;
+                return true;
+            }
+
+            return end(&event_handler::end_array);
+        }
+
+        bool start_object() {return start(&event_handler::start_object);}
+        bool end_object() {return end(&event_handler::end_object);}
+
+    private:
+        bool in_rows() const {return rows_depth_ != 0;}
+        bool at_row_start() const {return in_rows() && depth_ == rows_depth_;}
+        event_handler &target()
+        {
+            if (!in_rows())
+                return header_builder_;
+            return fields_.empty()? static_cast<event_handler &>(row_builder_): row_filter_;
+        }
+
+        // A non-array value for "rows" is kept in the header like any other member
+        void release_rows_key()
+        {
+            if (rows_key_pending_)
+            {
+                rows_key_pending_ = false;
+                header_builder_.key("rows");
+            }
+        }
+
+        bool emit_row()
+        {
+            ++count_;
+            return callback_(row_);
+        }
+
+        // Starts building a new row, which stays null if a projection selects none of it
+        void start_row()
+        {
+            row_.set_null();
+            row_builder_.reset(row_);
+            row_filter_.reset();
+        }
+
+        template<typename... Params, typename... Args>
+        bool scalar(bool (event_handler::*event)(Params...), Args &&... args)
+        {
+            release_rows_key();
+            if (!at_row_start())
+                return (target().*event)(std::forward<Args>(args)...);
+
+            start_row();
+            return (target().*event)(std::forward<Args>(args)...) && emit_row();
+        }
+
+        bool start(bool (event_handler::*event)())
+        {
+            release_rows_key();
+            if (at_row_start())
+                start_row();
+            ++depth_;
+            return (target().*event)();
+        }
+
+        bool end(bool (event_handler::*event)())
+        {
+            if (!(target().*event)())
+                return false;
+            --depth_;
+            return at_row_start()? emit_row(): true;
+        }
+
+        callback_type callback_;
+        projection fields_;
+        value header_;
+        value row_;
+        value_builder header_builder_;
+        value_builder row_builder_;
+        projection_filter row_filter_;
+        size_t depth_;
+        size_t rows_depth_; // Nesting depth inside the rows array, or 0 if not in it
+        bool rows_key_pending_;
+        size_t count_;
+    };
+
+    /* parser class - Parses JSON from a contiguous, in-memory buffer.
+     *
+     * This is the fast path used by from_json(). Strings are copied out in whole runs
+     * between escape sequences instead of character by character, and values are
+     * parsed directly into their final place in the containing array or object.
+     * Errors are thrown as json::error, with the byte offset at which they were detected.
+     *
+     * When parsing for a borrowed_value, string values without escape sequences are borrowed from the
+     * buffer instead of copied, so the buffer must outlive the parsed value.
+     */
+    class parser
+    {
+    public:
+        parser(const char *begin, const char *end) : begin_(begin), ptr_(begin), end_(end), borrow_(false), validate_(validate_utf8_by_default) {}
+        parser(const char *data, size_t length) : begin_(data), ptr_(data), end_(data + length), borrow_(false), validate_(validate_utf8_by_default) {}
+        // Parses the range [begin, end) of a larger buffer, reporting offsets relative to `buffer`
+        parser(const char *buffer, const char *begin, const char *end) : begin_(buffer), ptr_(begin), end_(end), borrow_(false), validate_(validate_utf8_by_default) {}
+
+        // Enables or disables checking that strings are valid UTF-8 (see utf8_validator)
+        parser &validate_utf8(bool validate = true)
+        {
+            validate_ = validate;
+            return *this;
+        }
+
+        // Parses the next value in the buffer into `v`
+        // Any trailing data after the value is left unparsed
+        void parse(value &v)
+        {
+            skip_whitespace();
+            read_value(v);
+        }
+
+        value parse()
+        {
+            value v;
+            parse(v);
+            return v;
+        }
+
+        // Reads the next value in the buffer, reporting it to `handler` as events instead of building it
+        // Returns false if the handler stopped parsing early
+        template<typename Handler>
+        bool parse_events(Handler &handler)
+        {
+            skip_whitespace();
+            return read_events(handler);
+        }
+
+        // Like parse(), but the value must be the only thing in the buffer apart from whitespace
+        void parse_all(value &v)
+        {
+            parse(v);
+            if (!at_end())
+                fail("unexpected character after JSON value");
+        }
+
+        value parse_all()
+        {
+            value v;
+            parse_all(v);
+            return v;
+        }
+
+        // Like parse_events(), but the value must be the only thing in the buffer apart from whitespace
+        // Trailing data is not checked if the handler stopped parsing early
+        template<typename Handler>
+        bool parse_all_events(Handler &handler)
+        {
+            if (!parse_events(handler))
+                return false;
+            if (!at_end())
+                fail("unexpected character after JSON value");
+            return true;
+        }
+
+        // Returns the current byte offset into the buffer
+        size_t offset() const {return ptr_ - begin_;}
+
+        // Returns true if only whitespace remains in the buffer
+        bool at_end()
+        {
+            skip_whitespace();
+            return ptr_ == end_;
+        }
+
+    private:
+        friend class borrowed_value;
+
+        // Enables or disables borrowing of string values from the buffer
+        parser &borrow_strings(bool borrow = true)
+        {
+            borrow_ = borrow;
+            return *this;
+        }
+
+        void fail(cstring_t reason) const {throw error(reason, offset());}
+
+        void skip_whitespace()
+        {
+            while (ptr_ != end_ && (*ptr_ == ' ' || *ptr_ == '\n' || *ptr_ == '\r' || *ptr_ == '\t'))
+                ++ptr_;
+        }
+
+        void expect_literal(cstring_t literal, cstring_t reason)
+        {
+            const char *start = ptr_;
+            for (; *literal; ++literal, ++ptr_)
+                if (ptr_ == end_ || *ptr_ != *literal)
+                {
+                    ptr_ = start;
+                    fail(reason);
+                }
+        }
+
+        void read_value(value &v)
+        {
+            if (ptr_ == end_)
+                fail("expected JSON value");
+
+            switch (*ptr_)
+            {
+                case 'n': expect_literal("null", "expected 'null' value"); v.set_null(); break;
+                case 't': expect_literal("true", "expected 'true' value"); v.set_bool(true); break;
+                case 'f': expect_literal("false", "expected 'false' value"); v.set_bool(false); break;
+                case '"':
+                {
+                    if (borrow_ && read_borrowed_string(v))
+                        break;
+
+                    string_t &str = v.get_string();
+                    str.clear();
+                    read_string(str);
+                    break;
+                }
+                case '[': read_array(v.get_array()); break;
+                case '{': read_object(v.get_object()); break;
+                default:
+                    if (*ptr_ == '-' || isdigit(*ptr_ & 0xff))
+                        read_number(v);
+                    else
+                        fail("expected JSON value");
+                    break;
+            }
+        }
+
+        template<typename Handler>
+        bool read_events(Handler &handler)
+        {
+            if (ptr_ == end_)
+                fail("expected JSON value");
+
+            switch (*ptr_)
+            {
+                case 'n': expect_literal("null", "expected 'null' value"); return handler.null_value();
+                case 't': expect_literal("true", "expected 'true' value"); return handler.bool_value(true);
+                case 'f': expect_literal("false", "expected 'false' value"); return handler.bool_value(false);
+                case '"':
+                {
+                    string_t str;
+                    read_string(str);
+                    return handler.string_value(str);
+                }
+                case '[':
+                {
+                    ++ptr_; // Eat '['
+                    if (!handler.start_array())
+                        return false;
+
+                    skip_whitespace();
+                    if (ptr_ != end_ && *ptr_ == ']')
+                    {
+                        ++ptr_;
+                        return handler.end_array();
+                    }
+
+                    while (true)
+                    {
+                        skip_whitespace();
+                        if (!read_events(handler))
+                            return false;
+
+                        skip_whitespace();
+                        if (ptr_ == end_ || (*ptr_ != ',' && *ptr_ != ']'))
+                            fail("expected ',' separating array elements or ']' ending array");
+                        if (*ptr_++ == ']')
+                            return handler.end_array();
+                    }
+                }
+                case '{':
+                {
+                    string_t key;
+
+                    ++ptr_; // Eat '{'
+                    if (!handler.start_object())
+                        return false;
+
+                    skip_whitespace();
+                    if (ptr_ != end_ && *ptr_ == '}')
+                    {
+                        ++ptr_;
+                        return handler.end_object();
+                    }
+
+                    while (true)
+                    {
+                        skip_whitespace();
+                        if (ptr_ == end_ || *ptr_ != '"')
+                            fail("expected string");
+                        key.clear();
+                        read_string(key);
+                        if (!handler.key(key))
+                            return false;
+
+                        skip_whitespace();
+                        if (ptr_ == end_ || *ptr_ != ':')
+                            fail("expected ':' separating key and value in object");
+                        ++ptr_;
+
+                        skip_whitespace();
+                        if (!read_events(handler))
+                            return false;
+
+                        skip_whitespace();
+                        if (ptr_ == end_ || (*ptr_ != ',' && *ptr_ != '}'))
+                            fail("expected ',' separating key value pairs or '}' ending object");
+                        if (*ptr_++ == '}')
+                            return handler.end_object();
+                    }
+                }
+                default:
+                {
+                    if (*ptr_ != '-' && !isdigit(*ptr_ & 0xff))
+                        fail("expected JSON value");
+
+                    value number;
+                    read_number(number);
+                    return number.is_int()? handler.int_value(number.get_int()): handler.real_value(number.get_real());
+                }
+            }
+        }
+
+        void read_array(array_t &arr)
+        {
+            arr.clear();
+            ++ptr_; // Eat '['
+
+            skip_whitespace();
+            if (ptr_ != end_ && *ptr_ == ']')
+            {
+                ++ptr_;
+                return;
+            }
+
+            while (true)
+            {
+                skip_whitespace();
+                arr.push_back(value());
+                read_value(arr.back());
+
+                skip_whitespace();
+                if (ptr_ == end_ || (*ptr_ != ',' && *ptr_ != ']'))
+                    fail("expected ',' separating array elements or ']' ending array");
+                if (*ptr_++ == ']')
+                    return;
+            }
+        }
+
+        void read_object(object_t &obj)
+        {
+            string_t key;
+
+            obj.clear();
+            ++ptr_; // Eat '{'
+
+            skip_whitespace();
+            if (ptr_ != end_ && *ptr_ == '}')
+            {
+                ++ptr_;
+                return;
+            }
+
+            while (true)
+            {
+                skip_whitespace();
+                if (ptr_ == end_ || *ptr_ != '"')
+                    fail("expected string");
+                key.clear();
+                read_string(key);
+
+                skip_whitespace();
+                if (ptr_ == end_ || *ptr_ != ':')
+                    fail("expected ':' separating key and value in object");
+                ++ptr_;
+
+                skip_whitespace();
+#ifdef JSON_INTERNED_KEYS
+                read_value(parse_member(obj, atom(key))); // The key buffer is reused, so repeated names are never allocated
+#else
+                read_value(parse_member(obj, key));
+#endif
+
+                skip_whitespace();
+                if (ptr_ == end_ || (*ptr_ != ',' && *ptr_ != '}'))
+                    fail("expected ',' separating key value pairs or '}' ending object");
+                if (*ptr_++ == '}')
+                {
+                    finish_members(obj);
+                    return;
+                }
+            }
+        }
+
+        // Borrows the string starting at the current '"' into `v`, unless it has escape sequences that need decoding
+        // Returns false, without consuming anything, if the string cannot be borrowed
+        bool read_borrowed_string(value &v)
+        {
+            const char *start = ptr_ + 1, *p = start;
+            while (p != end_ && *p != '"' && *p != '\\')
+                ++p;
+
+            if (p == end_ || *p != '"')
+                return false;
+
+            if (validate_)
+                check_utf8(start, p);
+            v.borrow_string(start, p - start);
+            ptr_ = p + 1;
+            return true;
+        }
+
+        // Appends the string starting at the current '"' to `str`
+        void read_string(string_t &str)
+        {
+            uint32_t high_surrogate = 0;
+
+            ++ptr_; // Eat '"'
+
+            while (true)
+            {
+                const char *run = ptr_;
+                while (ptr_ != end_ && *ptr_ != '"' && *ptr_ != '\\')
+                    ++ptr_;
+                if (ptr_ != run)
+                {
+                    if (validate_)
+                        check_utf8(run, ptr_);
+                    end_utf16(str, high_surrogate);
+                    str.append(run, ptr_ - run);
+                }
+
+                if (ptr_ == end_)
+                    fail("unexpected end of string");
+                else if (*ptr_++ == '"')
+                {
+                    end_utf16(str, high_surrogate);
+                    return;
+                }
+
+                // Escape sequence
+                if (ptr_ == end_)
+                    fail("unexpected end of string");
+
+                if (*ptr_ == 'u')
+                {
+                    uint32_t unit;
+                    if (end_ - ptr_ < 5)
+                    {
+                        ptr_ = end_;
+                        fail("unexpected end of string");
+                    }
+                    if (!decode_hex4(ptr_ + 1, unit))
+                        fail("invalid character escape sequence");
+
+                    ptr_ += 5;
+                    write_utf16_unit(str, high_surrogate, unit);
+                    continue;
+                }
+
+                end_utf16(str, high_surrogate);
+                switch (*ptr_++)
+                {
+                    case '"': str.push_back('"'); break;
+                    case '\\': str.push_back('\\'); break;
+                    case '/': str.push_back('/'); break;
+                    case 'b': str.push_back('\b'); break;
+                    case 'f': str.push_back('\f'); break;
+                    case 'n': str.push_back('\n'); break;
+                    case 'r': str.push_back('\r'); break;
+                    case 't': str.push_back('\t'); break;
+                    default:
+                        --ptr_;
+                        fail("invalid character escape sequence");
+                }
+            }
+        }
+
+        // Fails at the first byte in [begin, end) that is not part of a valid UTF-8 sequence
+        void check_utf8(const char *begin, const char *end) const
+        {
+            utf8_validator validator;
+            const char *invalid = validator.check(begin, end);
+            if (invalid != end || !validator.complete())
+                throw utf8_error(invalid - begin_);
+        }
+
+        void read_number(value &v)
+        {
+            const char *start = ptr_;
+
+            if (*ptr_ == '-')
+                ++ptr_;
+
+            if (ptr_ == end_ || !isdigit(*ptr_ & 0xff))
+                fail("invalid number");
+            if (*ptr_ == '0')
+                ++ptr_;
+            else
+                while (ptr_ != end_ && isdigit(*ptr_ & 0xff))
+                    ++ptr_;
+
+            if (ptr_ != end_ && *ptr_ == '.')
+            {
+                ++ptr_;
+                if (ptr_ == end_ || !isdigit(*ptr_ & 0xff))
+                    fail("invalid number");
+                while (ptr_ != end_ && isdigit(*ptr_ & 0xff))
+                    ++ptr_;
+            }
+
+            if (ptr_ != end_ && (*ptr_ == 'e' || *ptr_ == 'E'))
+            {
+                ++ptr_;
+                if (ptr_ != end_ && (*ptr_ == '+' || *ptr_ == '-'))
+                    ++ptr_;
+                if (ptr_ == end_ || !isdigit(*ptr_ & 0xff))
+                    fail("invalid number");
+                while (ptr_ != end_ && isdigit(*ptr_ & 0xff))
+                    ++ptr_;
+            }
+
+            if (!parse_number(start, ptr_, v))
+            {
+                ptr_ = start;
+                fail("invalid number");
+            }
+        }
+
+        const char *begin_;
+        const char *ptr_;
+        const char *end_;
+        bool borrow_;
+        bool validate_;
+    };
+
+    /* push_parser class - Parses JSON that arrives in arbitrary pieces, such as a network response body.
+     *
+     * Each call to feed() consumes the whole piece and reports events to the handler as soon as they
+     * are complete. A token that is cut off at the end of a piece is suspended, and resumes with the
+     * next call, so no more than the current token is ever buffered. Like from_json(), the input must
+     * hold a single value, unless allow_multiple_values() is set, in which case top-level values may
+     * follow one another (optionally separated by whitespace), which allows newline-delimited streams
+     * to be fed through a single parser. Call finish() once the input ends.
+     *
+     * Errors are thrown as json::error, with the byte offset into the whole input at which they were
+     * detected. Call reset() before reusing a parser that threw.
+     */
+    class push_parser
+    {
+    public:
+        push_parser(event_handler &handler) : handler_(&handler), validate_(validate_utf8_by_default), multiple_(false) {reset();}
+
+        // Enables or disables checking that strings are valid UTF-8 (see utf8_validator)
+        push_parser &validate_utf8(bool validate = true)
+        {
+            validate_ = validate;
+            return *this;
+        }
+
+        // Enables or disables accepting more than one top-level value
+        push_parser &allow_multiple_values(bool allow = true)
+        {
+            multiple_ = allow;
+            return *this;
+        }
+
+        // Discards any partial input and starts over, optionally with a different handler
+        void reset()
+        {
+            state_ = expect_value;
+            stack_.clear();
+            token_.clear();
+            literal_ = NULL;
+            literal_pos_ = 0;
+            code_ = 0;
+            digits_ = 0;
+            high_surrogate_ = 0;
+            utf8_.reset();
+            string_is_key_ = false;
+            stopped_ = false;
+            consumed_ = 0;
+            values_ = 0;
+            chunk_ = NULL;
+        }
+        void reset(event_handler &handler)
+        {
+            handler_ = &handler;
+            reset();
+        }
+
+        // Parses the next piece of input
+        // Returns false if the handler stopped parsing, in which case all further input is ignored
+        bool feed(const char *data, size_t length)
+        {
+            const char *ptr = data, *end = data + length;
+
+            chunk_ = data;
+            while (ptr != end && !stopped_)
+            {
+                switch (state_)
+                {
+                    case in_string:
+                    {
+                        const char *run = ptr;
+                        while (ptr != end && *ptr != '"' && *ptr != '\\')
+                            ++ptr;
+                        if (ptr != run)
+                        {
+                            // A UTF-8 sequence may continue in the next piece, so it is only required to be complete where the run ends
+                            const char *invalid = validate_? utf8_.check(run, ptr): ptr;
+                            if (invalid != ptr)
+                                throw utf8_error(offset_at(invalid));
+                            end_utf16(token_, high_surrogate_);
+                            token_.append(run, ptr - run);
+                        }
+
+                        if (ptr == end)
+                            break;
+                        else if (!utf8_.complete())
+                            throw utf8_error(offset_at(ptr));
+                        else if (*ptr++ == '\\')
+                            state_ = in_escape;
+                        else
+                        {
+                            end_utf16(token_, high_surrogate_);
+                            if (string_is_key_)
+                            {
+                                state_ = expect_colon;
+                                stopped_ = !handler_->key(token_);
+                            }
+                            else
+                                end_value(handler_->string_value(token_));
+                        }
+                        break;
+                    }
+                    case in_escape:
+                        if (*ptr != 'u')
+                            end_utf16(token_, high_surrogate_);
+                        switch (*ptr)
+                        {
+                            case '"': token_.push_back('"'); break;
+                            case '\\': token_.push_back('\\'); break;
+                            case '/': token_.push_back('/'); break;
+                            case 'b': token_.push_back('\b'); break;
+                            case 'f': token_.push_back('\f'); break;
+                            case 'n': token_.push_back('\n'); break;
+                            case 'r': token_.push_back('\r'); break;
+                            case 't': token_.push_back('\t'); break;
+                            case 'u':
+                                digits_ = 0;
+                                state_ = in_unicode;
+                                ++ptr;
+                                continue;
+                            default: fail("invalid character escape sequence", ptr);
+                        }
+                        state_ = in_string;
+                        ++ptr;
+                        break;
+                    case in_unicode:
+                        hex_[digits_++] = *ptr;
+                        if (digits_ == 4)
+                        {
+                            if (!decode_hex4(hex_, code_))
+                                fail("invalid character escape sequence", ptr);
+                            write_utf16_unit(token_, high_surrogate_, code_);
+                            state_ = in_string;
+                        }
+                        ++ptr;
+                        break;
+                    case in_number:
+                    {
+                        const char *run = ptr;
+                        while (ptr != end && (isdigit(*ptr & 0xff) || *ptr == '.' || *ptr == 'e' || *ptr == 'E' || *ptr == '+' || *ptr == '-'))
+                            ++ptr;
+                        token_.append(run, ptr - run);
+
+                        if (ptr != end) // The number ends here, unless it runs on into the next piece
+                            end_number(ptr);
+                        break;
+                    }
+                    case in_literal:
+                        if (*ptr != literal_[literal_pos_])
+                            fail("invalid literal value", ptr);
+                        ++ptr;
+
+                        if (literal_[++literal_pos_] == 0)
+                        {
+                            if (literal_[0] == 'n')
+                                end_value(handler_->null_value());
+                            else
+                                end_value(handler_->bool_value(literal_[0] == 't'));
+                        }
+                        break;
+                    default:
+                        if (*ptr == ' ' || *ptr == '\n' || *ptr == '\r' || *ptr == '\t')
+                        {
+                            ++ptr;
+                            break;
+                        }
+
+                        ptr = read_structural(ptr);
+                        break;
+                }
+            }
+
+            consumed_ += ptr - data;
+            chunk_ = NULL;
+            return !stopped_;
+        }
+        bool feed(const std::string &data) {return feed(data.data(), data.size());}
+
+        // Signals the end of input
+        // Throws json::error if the input ends inside of a value
+        void finish()
+        {
+            if (stopped_)
+                return;
+
+            if (state_ == in_number)
+                end_number(NULL);
+
+            if (!stopped_ && (!stack_.empty() || (state_ != expect_value && state_ != after_value)))
+                fail("unexpected end of JSON input", NULL);
+        }
+
+        // Returns true if the handler stopped parsing
+        bool stopped() const {return stopped_;}
+
+        // Returns the number of bytes consumed so far
+        size_t offset() const {return consumed_;}
+
+        // Returns the number of complete top-level values parsed so far
+        size_t values() const {return values_;}
+
+    private:
+        enum state_type
+        {
+            expect_value,
+            expect_first_element, // After '[', expects a value or ']'
+            expect_first_key, // After '{', expects a key or '}'
+            expect_key,
+            expect_colon,
+            after_value, // Expects ',' or the end of the containing array or object
+            in_string,
+            in_escape,
+            in_unicode,
+            in_number,
+            in_literal
+        };
+
+        // Returns the offset into the whole input of `ptr`, which points into the piece being fed, if any
+        size_t offset_at(const char *ptr) const {return consumed_ + (chunk_ && ptr? ptr - chunk_: 0);}
+
+        void fail(cstring_t reason, const char *ptr) const {throw error(reason, offset_at(ptr));}
+
+        void end_value(bool result)
+        {
+            state_ = after_value;
+            stopped_ = !result;
+            if (stack_.empty())
+                ++values_;
+        }
+
+        void end_number(const char *ptr)
+        {
+            value number;
+            try
+            {
+                parser p(token_.data(), token_.size());
+                p.parse(number);
+                if (!p.at_end())
+                    fail("invalid number", ptr);
+            }
+            catch (const error &)
+            {
+                fail("invalid number", ptr);
+            }
+
+            end_value(number.is_int()? handler_->int_value(number.get_int()): handler_->real_value(number.get_real()));
+        }
+
+        // Handles the non-whitespace character at `ptr` between tokens, and returns the position after it
+        const char *read_structural(const char *ptr)
+        {
+            switch (state_)
+            {
+                case expect_first_key:
+                    if (*ptr == '}')
+                        return end_container(ptr);
+                    // fallthrough
+                case expect_key:
+                    if (*ptr != '"')
+                        fail("expected string", ptr);
+                    token_.clear();
+                    string_is_key_ = true;
+                    state_ = in_string;
+                    return ptr + 1;
+                case expect_colon:
+                    if (*ptr != ':')
+                        fail("expected ':' separating key and value in object", ptr);
+                    state_ = expect_value;
+                    return ptr + 1;
+                case after_value:
+                    if (stack_.empty()) // Another top-level value follows
+                    {
+                        if (!multiple_)
+                            fail("unexpected character after JSON value", ptr);
+                        state_ = expect_value;
+                        return ptr;
+                    }
+                    else if (stack_.back() == '[')
                     {
-                        value item;
-                        stream >> item;
-                        v.push_back(item);
+                        if (*ptr != ',' && *ptr != ']')
+                            fail("expected ',' separating array elements or ']' ending array", ptr);
+                    }
+                    else if (*ptr != ',' && *ptr != '}')
+                        fail("expected ',' separating key value pairs or '}' ending object", ptr);
+
+                    if (*ptr != ',')
+                        return end_container(ptr);
+                    state_ = stack_.back() == '['? expect_value: expect_key;
+                    return ptr + 1;
+                case expect_first_element:
+                    if (*ptr == ']')
+                        return end_container(ptr);
+                    // fallthrough
+                default:
+                    break;
+            }
+
+            switch (*ptr)
+            {
+                case 'n': return start_literal(ptr, "null");
+                case 't': return start_literal(ptr, "true");
+                case 'f': return start_literal(ptr, "false");
+                case '"':
+                    token_.clear();
+                    string_is_key_ = false;
+                    state_ = in_string;
+                    break;
+                case '[':
+                    stack_.push_back('[');
+                    state_ = expect_first_element;
+                    stopped_ = !handler_->start_array();
+                    break;
+                case '{':
+                    stack_.push_back('{');
+                    state_ = expect_first_key;
+                    stopped_ = !handler_->start_object();
+                    break;
+                default:
+                    if (*ptr != '-' && !isdigit(*ptr & 0xff))
+                        fail("expected JSON value", ptr);
+                    token_.clear();
+                    state_ = in_number;
+                    return ptr; // The number is read by its own state
+            }
+
+            return ptr + 1;
+        }
+
+        const char *start_literal(const char *ptr, cstring_t literal)
+        {
+            literal_ = literal;
+            literal_pos_ = 1;
+            state_ = in_literal;
+            return ptr + 1;
+        }
+
+        const char *end_container(const char *ptr)
+        {
+            bool array = stack_.back() == '[';
+            stack_.pop_back();
+            end_value(array? handler_->end_array(): handler_->end_object());
+            return ptr + 1;
+        }
+
+        event_handler *handler_;
+        state_type state_;
+        std::vector<char> stack_; // '[' or '{' for each open container
+        string_t token_; // The string or number currently being read
+        cstring_t literal_;
+        size_t literal_pos_;
+        uint32_t code_; // Code unit of the last \u escape
+        char hex_[4]; // Digits of the current \u escape
+        int digits_;
+        uint32_t high_surrogate_; // A high surrogate waiting for its pair, or 0
+        utf8_validator utf8_;
+        bool validate_;
+        bool multiple_;
+        bool string_is_key_;
+        bool stopped_;
+        size_t consumed_;
+        size_t values_;
+        const char *chunk_; // The piece being fed, for error offsets
+    };
+
+    inline std::ostream &operator<<(std::ostream &stream, const value &v)
+    {
+        std::string out;
+        writer(out).reserve(v).write(v);
+        return stream.write(out.data(), out.size());
+    }
+
+    inline std::ostream &pretty_print(std::ostream &stream, const value &v, size_t indent_width, size_t start_indent = 0)
+    {
+        std::string out;
+        writer(out, indent_width, start_indent).write(v);
+        return stream.write(out.data(), out.size());
+    }
+
+    // Parses a buffer holding exactly one JSON value, throwing json::error if it is invalid or followed by trailing data
+    inline value from_json(const char *json, size_t length)
+    {
+        return parser(json, length).parse_all();
+    }
+
+    inline value from_json(const std::string &json)
+    {
+        return from_json(json.data(), json.size());
+    }
+
+    /* borrowed_value class - A value parsed in borrowed mode, together with the buffer it borrows from.
+     *
+     * String values without escape sequences refer to their characters in the buffer instead of
+     * holding copies, so parsing a response that is mostly ids and revisions allocates almost
+     * nothing beyond the containers. The buffer is shared and immutable, and is kept alive by the
+     * borrowed_value.
+     *
+     * The parsed tree is only reachable through ref, a read-only view that reads strings as
+     * string_ref, so no json::value that borrows its strings ever escapes. Use ref::get_value()
+     * to copy a subtree out as an ordinary value. Reading never modifies the tree, so one
+     * borrowed_value may be read by several threads at once.
+     */
+    class borrowed_value
+    {
+    public:
+        typedef std::shared_ptr<const string_t> buffer_type;
+
+        /* ref class - A read-only view of one value in a borrowed_value's tree.
+         *
+         * A ref is only valid while the borrowed_value it came from is alive and unmodified.
+         */
+        class ref
+        {
+        public:
+            type get_type() const {return v_->get_type();}
+            size_t size() const {return v_->size();}
+
+            bool_t is_null() const {return v_->is_null();}
+            bool_t is_bool() const {return v_->is_bool();}
+            bool_t is_int() const {return v_->is_int();}
+            bool_t is_real() const {return v_->is_real();}
+            bool_t is_string() const {return v_->is_string();}
+            bool_t is_array() const {return v_->is_array();}
+            bool_t is_object() const {return v_->is_object();}
+
+            bool_t get_bool() const {return v_->get_bool();}
+            int_t get_int() const {return v_->get_int();}
+            real_t get_real() const {return v_->get_real();}
+            // Returns the characters of a string, which refer into the buffer, or an empty reference if this is not a string
+            string_ref get_string() const {return v_->get_string_ref();}
+
+            // Returns the member named `key`, or a null value if this is not an object or has no such member
+            ref operator[](const string_t &key) const {return find(key);}
+            ref operator[](cstring_t key) const {return find(key);}
+            bool_t is_member(const string_t &key) const {return v_->is_member(key);}
+            bool_t is_member(cstring_t key) const {return v_->is_member(key);}
+
+            // Returns the element at `pos`, or a null value if this is not an array or has no such element
+            ref operator[](size_t pos) const {return ref(is_array() && pos < v_->size()? &v_->get_array()[pos]: NULL);}
+
+            // Calls `f(key, member)` for each member of an object, in the object's iteration order
+            template<typename F>
+            void for_each_member(F f) const
+            {
+                for (const auto &member: v_->get_object())
+                    f(member.first, ref(&member.second));
+            }
+
+            // Calls `f(element)` for each element of an array
+            template<typename F>
+            void for_each_element(F f) const
+            {
+                for (const value &element: v_->get_array())
+                    f(ref(&element));
+            }
+
+            // Returns a copy of this value that owns all its strings, and so may outlive the buffer
+            value get_value() const {return *v_;}
+
+        private:
+            friend class borrowed_value;
+
+            explicit ref(const value *v) : v_(v? v: &null()) {}
+
+            template<typename Key>
+            ref find(const Key &key) const {return ref(v_->find(key));}
+
+            static const value &null() {static const value v; return v;}
+
+            const value *v_;
+        };
+
+        borrowed_value() {}
+        // Parses `buffer`, throwing json::error if it does not hold exactly one valid JSON value
+        // Strings are checked for valid UTF-8 if `validate_utf8` is set (see parser::validate_utf8())
+        explicit borrowed_value(const buffer_type &buffer, bool validate_utf8 = validate_utf8_by_default) : buffer_(buffer)
+        {
+            if (buffer_)
+                parser(buffer_->data(), buffer_->size()).borrow_strings().validate_utf8(validate_utf8).parse_all(value_);
+        }
+
+        const buffer_type &buffer() const {return buffer_;}
+
+        ref get() const {return ref(&value_);}
+        ref operator[](const string_t &key) const {return get()[key];}
+        ref operator[](cstring_t key) const {return get()[key];}
+        ref operator[](size_t pos) const {return get()[pos];}
+
+    private:
+        friend borrowed_value from_cbor_borrowed(const std::shared_ptr<const std::string> &cbor);
 
-                        stream >> chr;
-                        if (!stream || (chr != ',' && chr != ']'))
-                            throw error("expected ',' separating array elements or ']' ending array");
-                    } while (stream && chr != ']');
+        // Takes over `v`, whose borrowed strings must all refer to characters in `buffer`
+        borrowed_value(const buffer_type &buffer, value &&v) : buffer_(buffer), value_(std::move(v)) {}
 
-                    return stream;
-                case '{':
-                    stream >> chr; // Eat '{'
-                    v.set_object(object_t());
+        buffer_type buffer_;
+        value value_;
+    };
 
-                    // Peek at next character past whitespace
-                    stream >> chr;
-                    if (!stream || chr == '}') return stream;
+    // Parses a JSON buffer in borrowed mode
+    inline borrowed_value from_json_borrowed(const std::shared_ptr<const std::string> &json)
+    {
+        return borrowed_value(json);
+    }
 
-                    stream.unget(); // Replace character we peeked at
-                    do
-                    {
-                        std::string key;
-                        value item;
+    inline borrowed_value from_json_borrowed(std::string &&json)
+    {
+        return borrowed_value(std::make_shared<const std::string>(std::move(json)));
+    }
 
-                        read_string(stream, key);
-                        stream >> chr;
-                        if (chr != ':') throw error("expected ':' separating key and value in object");
-                        stream >> item;
-                        v[key] = item;
+    // Parses a buffer holding exactly one JSON value, reporting its contents to `handler` as a series of events
+    // Returns false if the handler stopped parsing early
+    template<typename Handler>
+    bool parse_events(const char *json, size_t length, Handler &handler)
+    {
+        return parser(json, length).parse_all_events(handler);
+    }
 
-                        stream >> chr;
-                        if (!stream || (chr != ',' && chr != '}'))
-                            throw error("expected ',' separating key value pairs or '}' ending object");
-                    } while (stream && chr != '}');
+    template<typename Handler>
+    bool parse_events(const std::string &json, Handler &handler)
+    {
+        return parse_events(json.data(), json.size(), handler);
+    }
 
-                    return stream;
-                default:
-                    if (isdigit(chr) || chr == '-')
-                    {
-                        real_t r;
-                        stream >> r;
-                        if (!stream) throw error("invalid number");
+#ifdef JSON_PMR
+    // Parses a JSON buffer, allocating all arrays and objects from `resource`, which must outlive the result
+    inline value from_json(const char *json, size_t length, memory_resource *resource)
+    {
+        value v(resource);
+        parser(json, length).parse_all(v);
+        return v;
+    }
 
-                        if (r == trunc(r) && r >= INT64_MIN && r <= INT64_MAX)
-                            v.set_int(static_cast<int_t>(r));
-                        else
-                            v.set_real(r);
+    inline value from_json(const std::string &json, memory_resource *resource)
+    {
+        return from_json(json.data(), json.size(), resource);
+    }
+#endif
 
-                        return stream;
-                    }
-                    break;
-            }
-        }
+    // Appends the JSON representation of `v` to `out`, returning `out`
+    inline std::string &to_json(const value &v, std::string &out)
+    {
+        return writer(out).write(v).str();
+    }
 
-        throw error("expected JSON value");
+    inline std::string to_json(const value &v)
+    {
+        std::string out;
+        return writer(out).reserve(v).write(v).str();
     }
 
-    inline std::ostream &operator<<(std::ostream &stream, const value &v)
+    inline std::string to_pretty_json(const value &v, size_t indent_width)
     {
-        switch (v.get_type())
+        std::string out;
+        return writer(out, indent_width).write(v).str();
+    }
+
+    /* cbor_writer class - Writes values in CBOR (RFC 8949), a compact binary encoding of the JSON data model.
+     *
+     * Every value maps onto CBOR exactly, so a round trip through cbor_parser gives back an equal value.
+     * Integers use the smallest head that fits, reals are written in single precision when no precision is
+     * lost and in double precision otherwise, and objects are maps with text string keys.
+     */
+    class cbor_writer
+    {
+    public:
+        cbor_writer(std::string &out) : out_(out) {}
+
+        std::string &str() {return out_;}
+
+        cbor_writer &write(const value &v)
         {
-            case null: return stream << "null";
-            case boolean: return stream << (v.get_bool()? "true": "false");
-            case integer: return stream << v.get_int();
-            case real: return stream << v.get_real();
-            case string: return write_string(stream, v.get_string());
-            case array:
+            switch (v.get_type())
             {
-                stream << '[';
-                for (auto it = v.get_array().begin(); it != v.get_array().end(); ++it)
+                case null: out_.push_back(static_cast<char>(0xf6)); break;
+                case boolean: out_.push_back(static_cast<char>(v.get_bool()? 0xf5: 0xf4)); break;
+                case integer: write_int(v.get_int()); break;
+                case real: write_real(v.get_real()); break;
+                case string: write_string(v.get_string_ref()); break;
+                case array:
+                {
+                    const array_t &arr = v.get_array();
+                    write_head(4, arr.size());
+                    for (const value &item: arr)
+                        write(item);
+                    break;
+                }
+                case object:
                 {
-                    if (it != v.get_array().begin())
-                        stream << ',';
-                    stream << *it;
+                    const object_t &obj = v.get_object();
+                    write_head(5, obj.size());
+                    for (auto it = obj.begin(); it != obj.end(); ++it)
+                    {
+                        const string_t &key = it->first;
+                        write_string(string_ref(key));
+                        write(it->second);
+                    }
+                    break;
                 }
-                return stream << ']';
             }
-            case object:
+
+            return *this;
+        }
+
+        cbor_writer &write_int(int_t v)
+        {
+            // Negative integers are encoded as -1 - n, which is the bitwise complement of v
+            if (v < 0)
+                write_head(1, ~static_cast<uint64_t>(v));
+            else
+                write_head(0, static_cast<uint64_t>(v));
+            return *this;
+        }
+
+        cbor_writer &write_real(real_t v)
+        {
+            // A finite value outside the range of float cannot be converted to one, so is always written as a float64
+            if (!std::isfinite(v) || std::fabs(v) <= FLT_MAX)
             {
-                stream << '{';
-                for (auto it = v.get_object().begin(); it != v.get_object().end(); ++it)
+                float f = static_cast<float>(v);
+                if (static_cast<real_t>(f) == v || v != v)
                 {
-                    if (it != v.get_object().begin())
-                        stream << ',';
-                    write_string(stream, it->first) << ':' << it->second;
+                    uint32_t bits;
+                    memcpy(&bits, &f, sizeof(bits));
+                    out_.push_back(static_cast<char>(0xfa));
+                    write_be(bits, 4);
+                    return *this;
                 }
-                return stream << '}';
             }
+
+            uint64_t bits;
+            memcpy(&bits, &v, sizeof(bits));
+            out_.push_back(static_cast<char>(0xfb));
+            write_be(bits, 8);
+            return *this;
         }
 
-        // Control will never get here
-        return stream;
-    }
+        cbor_writer &write_string(string_ref str)
+        {
+            write_head(3, str.size());
+            out_.append(str.data(), str.size());
+            return *this;
+        }
 
-    inline std::ostream &pretty_print(std::ostream &stream, const value &v, size_t indent_width, size_t start_indent = 0)
+    private:
+        // Writes the initial byte of an item of major type `major` with argument `n`, followed by any extended argument bytes
+        void write_head(unsigned major, uint64_t n)
+        {
+            const char type = static_cast<char>(major << 5);
+
+            if (n < 24)
+                out_.push_back(type | static_cast<char>(n));
+            else if (n <= 0xff)
+                out_.push_back(type | 24), write_be(n, 1);
+            else if (n <= 0xffff)
+                out_.push_back(type | 25), write_be(n, 2);
+            else if (n <= 0xffffffff)
+                out_.push_back(type | 26), write_be(n, 4);
+            else
+                out_.push_back(type | 27), write_be(n, 8);
+        }
+
+        void write_be(uint64_t n, size_t bytes)
+        {
+            char buf[8];
+            for (size_t i = bytes; i > 0; --i, n >>= 8)
+                buf[i-1] = static_cast<char>(n & 0xff);
+            out_.append(buf, bytes);
+        }
+
+        std::string &out_;
+    };
+
+    /* cbor_parser class - Parses CBOR from a contiguous, in-memory buffer.
+     *
+     * Accepts everything cbor_writer produces, as well as half-precision reals, indefinite-length strings,
+     * arrays, and maps, and tagged items (the tags are ignored). Items with no JSON equivalent, such as byte
+     * strings, undefined, or maps with non-string keys, are rejected. Errors are thrown as json::error, with
+     * the byte offset at which they were detected.
+     *
+     * When decoding for from_cbor_borrowed(), definite-length text strings are borrowed from the buffer instead
+     * of copied, so decoding allocates nothing but containers, and the buffer must outlive the parsed value.
+     */
+    class cbor_parser
     {
-        switch (v.get_type())
+    public:
+        cbor_parser(const char *data, size_t length) : begin_(data), ptr_(data), end_(data + length), borrow_(false) {}
+
+        // Parses the next item in the buffer into `v`
+        // Any trailing data after the item is left unparsed
+        void parse(value &v) {read_value(v);}
+
+        value parse()
         {
-            case null: return stream << "null";
-            case boolean: return stream << (v.get_bool()? "true": "false");
-            case integer: return stream << v.get_int();
-            case real: return stream << v.get_real();
-            case string: return write_string(stream, v.get_string());
-            case array:
+            value v;
+            parse(v);
+            return v;
+        }
+
+        // Returns true if the whole buffer has been parsed
+        bool at_end() const {return ptr_ == end_;}
+
+        // Returns the number of bytes parsed so far
+        size_t offset() const {return ptr_ - begin_;}
+
+    private:
+        friend borrowed_value from_cbor_borrowed(const std::shared_ptr<const std::string> &cbor);
+
+        // Argument value marking an indefinite-length item
+        static const uint64_t indefinite = UINT64_MAX;
+
+        // Enables or disables borrowing of string values from the buffer
+        cbor_parser &borrow_strings(bool borrow = true)
+        {
+            borrow_ = borrow;
+            return *this;
+        }
+
+        void fail(cstring_t reason) const {throw error(reason, offset());}
+
+        uint64_t read_be(size_t bytes)
+        {
+            if (static_cast<size_t>(end_ - ptr_) < bytes)
+                fail("unexpected end of CBOR data");
+
+            uint64_t n = 0;
+            for (size_t i = 0; i < bytes; ++i)
+                n = (n << 8) | static_cast<unsigned char>(*ptr_++);
+            return n;
+        }
+
+        // Reads the head of the next item, returning its major type, and setting `n` to its argument
+        // `info` is set to the additional information bits, which distinguish the simple values and reals of major type 7
+        unsigned read_head(uint64_t &n, unsigned &info)
+        {
+            if (ptr_ == end_)
+                fail("unexpected end of CBOR data");
+
+            const unsigned char initial = static_cast<unsigned char>(*ptr_++);
+            const unsigned major = initial >> 5;
+            info = initial & 0x1f;
+
+            if (info < 24)
+                n = info;
+            else if (info <= 27)
+                n = read_be(size_t(1) << (info - 24));
+            else if (info == 31 && major >= 2 && major != 6)
+                n = indefinite;
+            else
             {
-                if (v.get_array().empty())
-                    return stream << "[]";
+                --ptr_;
+                fail("invalid CBOR item");
+            }
 
-                stream << "[\n";
-                for (auto it = v.get_array().begin(); it != v.get_array().end(); ++it)
-                {
-                    if (it != v.get_array().begin())
-                        stream << ",\n";
-                    stream << std::string(indent_width * (start_indent + 1), ' ');
-                    pretty_print(stream, *it, indent_width, start_indent + 1);
-                }
-                return stream << '\n' << std::string(indent_width * start_indent, ' ') << "]";
+            return major;
+        }
+
+        // Fails unless at least `count` more items could fit in the rest of the buffer, so that a bad count can't cause a huge allocation
+        void check_count(uint64_t count)
+        {
+            if (count > static_cast<uint64_t>(end_ - ptr_))
+                fail("unexpected end of CBOR data");
+        }
+
+        // Returns true and eats the break code if it is next
+        bool read_break()
+        {
+            if (ptr_ == end_)
+                fail("unexpected end of CBOR data");
+            if (static_cast<unsigned char>(*ptr_) != 0xff)
+                return false;
+
+            ++ptr_;
+            return true;
+        }
+
+        // Reads the contents of a text string with argument `n` into `str`
+        void read_string(uint64_t n, string_t &str)
+        {
+            if (n != indefinite)
+            {
+                check_count(n);
+                str.append(ptr_, static_cast<size_t>(n));
+                ptr_ += n;
+                return;
             }
-            case object:
+
+            // Indefinite-length strings are a series of definite-length text strings ending with a break
+            while (!read_break())
             {
-                if (v.get_object().empty())
-                    return stream << "{}";
+                unsigned info;
+                if (read_head(n, info) != 3 || n == indefinite)
+                    fail("expected definite-length text string in indefinite-length string");
+                read_string(n, str);
+            }
+        }
 
-                stream << "{\n";
-                for (auto it = v.get_object().begin(); it != v.get_object().end(); ++it)
+        void read_value(value &v)
+        {
+            uint64_t n;
+            unsigned info;
+            unsigned major = read_head(n, info);
+
+            // Tags only add semantics to the item that follows, and the data model has no place to keep them
+            while (major == 6)
+                major = read_head(n, info);
+
+            switch (major)
+            {
+                case 0:
+                    if (n <= static_cast<uint64_t>(INT64_MAX))
+                        v.set_int(static_cast<int_t>(n));
+                    else
+                        v.set_real(static_cast<real_t>(n));
+                    break;
+                case 1:
+                    if (n <= static_cast<uint64_t>(INT64_MAX))
+                        v.set_int(-1 - static_cast<int_t>(n));
+                    else
+                        v.set_real(-1.0 - static_cast<real_t>(n));
+                    break;
+                case 2: fail("CBOR byte strings are not supported"); break;
+                case 3:
+                    if (borrow_ && n != indefinite)
+                    {
+                        check_count(n);
+                        v.borrow_string(ptr_, static_cast<size_t>(n));
+                        ptr_ += n;
+                    }
+                    else
+                    {
+                        string_t &str = v.get_string();
+                        str.clear();
+                        read_string(n, str);
+                    }
+                    break;
+                case 4: read_array(n, v.get_array()); break;
+                case 5: read_object(n, v.get_object()); break;
+                case 7:
+                    switch (info)
+                    {
+                        case 20: v.set_bool(false); break;
+                        case 21: v.set_bool(true); break;
+                        case 22: v.set_null(); break;
+                        case 25: v.set_real(half_to_real(static_cast<uint16_t>(n))); break;
+                        case 26:
+                        {
+                            const uint32_t bits = static_cast<uint32_t>(n);
+                            float f;
+                            memcpy(&f, &bits, sizeof(f));
+                            v.set_real(f);
+                            break;
+                        }
+                        case 27:
+                        {
+                            real_t r;
+                            memcpy(&r, &n, sizeof(r));
+                            v.set_real(r);
+                            break;
+                        }
+                        case 31: --ptr_; fail("unexpected CBOR break"); break;
+                        default: --ptr_; fail("unsupported CBOR simple value"); break;
+                    }
+                    break;
+            }
+        }
+
+        void read_array(uint64_t n, array_t &arr)
+        {
+            arr.clear();
+
+            if (n == indefinite)
+            {
+                while (!read_break())
                 {
-                    if (it != v.get_object().begin())
-                        stream << ",\n";
-                    stream << std::string(indent_width * (start_indent + 1), ' ');
-                    pretty_print(write_string(stream, it->first) << ": ", it->second, indent_width, start_indent + 1);
+                    arr.push_back(value());
+                    read_value(arr.back());
                 }
-                return stream << '\n' << std::string(indent_width * start_indent, ' ') << "}";
+                return;
+            }
+
+            check_count(n);
+            arr.reserve(static_cast<size_t>(n));
+            for (; n > 0; --n)
+            {
+                arr.push_back(value());
+                read_value(arr.back());
             }
         }
 
-        // Control will never get here
-        return stream;
+        void read_object(uint64_t n, object_t &obj)
+        {
+            string_t key;
+
+            obj.clear();
+            if (n != indefinite)
+                check_count(n);
+
+            while (n == indefinite? !read_break(): n-- > 0)
+            {
+                uint64_t length;
+                unsigned info;
+                if (read_head(length, info) != 3)
+                    fail("expected text string key in CBOR map");
+
+                key.clear();
+                read_string(length, key);
+#ifdef JSON_INTERNED_KEYS
+                read_value(parse_member(obj, atom(key)));
+#else
+                read_value(parse_member(obj, key));
+#endif
+            }
+
+            finish_members(obj);
+        }
+
+        static real_t half_to_real(uint16_t half)
+        {
+            const int exponent = (half >> 10) & 0x1f;
+            const int mantissa = half & 0x3ff;
+            real_t r;
+
+            if (exponent == 0)
+                r = ldexp(static_cast<real_t>(mantissa), -24);
+            else if (exponent != 31)
+                r = ldexp(static_cast<real_t>(mantissa + 1024), exponent - 25);
+            else
+                r = mantissa == 0? INFINITY: NAN;
+
+            return half & 0x8000? -r: r;
+        }
+
+        const char *begin_;
+        const char *ptr_;
+        const char *end_;
+        bool borrow_;
+    };
+
+    // Appends the CBOR encoding of `v` to `out`, returning `out`
+    inline std::string &to_cbor(const value &v, std::string &out)
+    {
+        return cbor_writer(out).write(v).str();
     }
 
-    inline value from_json(const std::string &json)
+    inline std::string to_cbor(const value &v)
     {
-        std::istringstream stream(json);
-        value v;
-        stream >> v;
+        std::string out;
+        return cbor_writer(out).write(v).str();
+    }
+
+    // Decodes a buffer holding exactly one CBOR item, throwing json::error if it is invalid or followed by trailing data
+    inline value from_cbor(const char *cbor, size_t length)
+    {
+        cbor_parser p(cbor, length);
+        value v = p.parse();
+        if (!p.at_end())
+            throw error("unexpected data after CBOR item", p.offset());
         return v;
     }
 
-    inline std::string to_json(const value &v)
+    inline value from_cbor(const std::string &cbor)
     {
-        std::ostringstream stream;
-        stream << v;
-        return stream.str();
+        return from_cbor(cbor.data(), cbor.size());
     }
 
-    inline std::string to_pretty_json(const value &v, size_t indent_width)
+    // Decodes a CBOR buffer in borrowed mode, without copying any definite-length strings
+    inline borrowed_value from_cbor_borrowed(const std::shared_ptr<const std::string> &cbor)
+    {
+        if (!cbor)
+            return borrowed_value();
+
+        cbor_parser p(cbor->data(), cbor->size());
+        value v;
+        p.borrow_strings().parse(v);
+        if (!p.at_end())
+            throw error("unexpected data after CBOR item", p.offset());
+        return borrowed_value(cbor, std::move(v));
+    }
+
+    inline borrowed_value from_cbor_borrowed(std::string &&cbor)
+    {
+        return from_cbor_borrowed(std::make_shared<const std::string>(std::move(cbor)));
+    }
+
+    // Appends a JSON Patch (RFC 6902) operation to `patch`
+    inline void add_patch_operation(value &patch, cstring_t op, const string_t &path, const value *v = NULL)
+    {
+        value operation = object_t();
+        operation["op"] = op;
+        operation["path"] = path;
+        if (v)
+            operation["value"] = *v;
+        patch.push_back(std::move(operation));
+    }
+
+    // Appends to `patch` the operations that turn `from` into `to`, with paths starting at `path`
+    // Objects and arrays are compared member by member, so only the members that differ are in the patch,
+    // and elements are only added or removed at the point where two arrays stop matching at both ends
+    inline void diff(const value &from, const value &to, value &patch, string_t &path)
+    {
+        const size_t path_length = path.size();
+
+        if (from.is_object() && to.is_object())
+        {
+            const object_t &to_obj = to.get_object();
+            for (auto it = from.get_object().begin(); it != from.get_object().end(); ++it)
+            {
+                pointer::append_token(path, static_cast<const string_t &>(it->first));
+                if (const value *member = to.find(it->first))
+                    diff(it->second, *member, patch, path);
+                else
+                    add_patch_operation(patch, "remove", path);
+                path.resize(path_length);
+            }
+
+            for (auto it = to_obj.begin(); it != to_obj.end(); ++it)
+            {
+                if (from.find(it->first))
+                    continue;
+
+                pointer::append_token(path, static_cast<const string_t &>(it->first));
+                add_patch_operation(patch, "add", path, &it->second);
+                path.resize(path_length);
+            }
+        }
+        else if (from.is_array() && to.is_array())
+        {
+            const array_t &a = from.get_array(), &b = to.get_array();
+            size_t prefix = 0, suffix = 0;
+
+            while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix])
+                ++prefix;
+            while (suffix < a.size() - prefix && suffix < b.size() - prefix && a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+                ++suffix;
+
+            const size_t a_end = a.size() - suffix, b_end = b.size() - suffix;
+            char buf[max_number_length];
+
+            for (size_t i = prefix; i < a_end && i < b_end; ++i)
+            {
+                path.push_back('/');
+                path.append(buf, json::write_int(buf, i) - buf);
+                diff(a[i], b[i], patch, path);
+                path.resize(path_length);
+            }
+
+            // Remove from the back, so the indexes of the elements still to be removed don't change
+            for (size_t i = a_end; i > b_end; --i)
+            {
+                path.push_back('/');
+                path.append(buf, json::write_int(buf, i - 1) - buf);
+                add_patch_operation(patch, "remove", path);
+                path.resize(path_length);
+            }
+
+            for (size_t i = a_end; i < b_end; ++i)
+            {
+                path.push_back('/');
+                path.append(buf, json::write_int(buf, i) - buf);
+                add_patch_operation(patch, "add", path, &b[i]);
+                path.resize(path_length);
+            }
+        }
+        else if (from != to)
+            add_patch_operation(patch, "replace", path, &to);
+    }
+
+    // Returns the JSON Patch that turns `from` into `to`, which is an empty array if they are equal
+    inline value diff(const value &from, const value &to)
+    {
+        value patch = array_t();
+        string_t path;
+        diff(from, to, patch, path);
+        return patch;
+    }
+
+    // Applies the "add", "remove", and "replace" operations of a JSON Patch to `target`, in order
+    // Throws json::error if an operation is not supported or its path does not exist, in which case `target` may be partly patched
+    inline void apply_patch(value &target, const value &patch)
     {
-        std::ostringstream stream;
-        pretty_print(stream, v, indent_width);
-        return stream.str();
+        for (const value &operation: patch.get_array())
+        {
+            const string_ref op = operation["op"].get_string_ref();
+            const bool add = op == "add", remove = op == "remove";
+            if (!add && !remove && op != "replace")
+                throw error("unsupported JSON Patch operation");
+
+            const pointer path(operation["path"].get_string_ref());
+            if (path.empty())
+            {
+                if (remove)
+                    throw error("cannot remove the whole value with a JSON Patch");
+                target = operation["value"];
+                continue;
+            }
+
+            value *parent = &target;
+            for (size_t i = 0; parent && i + 1 < path.size(); ++i)
+            {
+                if (parent->is_object())
+                    parent = parent->find(path[i].key);
+                else if (parent->is_array() && path[i].index < parent->size())
+                    parent = &(*parent)[path[i].index];
+                else
+                    parent = NULL;
+            }
+
+            const pointer::token &last = path[path.size() - 1];
+            if (parent && parent->is_object())
+            {
+                value *member = parent->find(last.key);
+                if (!add && !member)
+                    throw error("JSON Patch path does not exist");
+
+                if (remove)
+                    parent->erase(last.key);
+                else if (member)
+                    *member = operation["value"];
+                else
+                    (*parent)[last.key] = operation["value"];
+            }
+            else if (parent && parent->is_array())
+            {
+                array_t &arr = parent->get_array();
+                const size_t index = add && static_cast<const string_t &>(last.key) == "-"? arr.size(): last.index;
+                if (index > arr.size() || (!add && index == arr.size()))
+                    throw error("JSON Patch path does not exist");
+
+                if (add)
+                    arr.insert(arr.begin() + index, operation["value"]);
+                else if (remove)
+                    arr.erase(arr.begin() + index);
+                else
+                    arr[index] = operation["value"];
+            }
+            else
+                throw error("JSON Patch path does not exist");
+        }
     }
 }
 
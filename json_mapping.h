@@ -0,0 +1,627 @@
+#ifndef JSON_MAPPING_H
+#define JSON_MAPPING_H
+
+#include "json.h"
+
+#if __cplusplus < 201703L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#error json_mapping.h requires C++17
+#endif
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Typed mapping between C++ structs and JSON
+ *
+ * A struct is described by specializing json::mapping with a tuple of field descriptors, usually with
+ * the JSON_MAPPING macro at global scope:
+ *
+ *     struct person {std::optional<std::string> _id, _rev; std::string name; int age; std::vector<std::string> tags;};
+ *     JSON_MAPPING(person, _id, _rev, name, age, tags)
+ *
+ * or by hand, which allows member names that differ from the JSON names:
+ *
+ *     template<> struct json::mapping<person>
+ *     {
+ *         static constexpr auto fields = std::make_tuple(json::field("name", &person::name), ...);
+ *     };
+ *
+ * write_typed() then serializes a struct straight into a writer, and from_json_typed() fills one in
+ * straight from parser events, without building a json::value in between. Member names are looked up
+ * with a perfect hash computed at compile time.
+ *
+ * Members may be bool, arithmetic types, std::string, json::value, std::optional, std::vector,
+ * std::map with string keys, or other mapped structs. A std::optional member is omitted from the output
+ * while it is empty. When reading, unknown members are skipped, null leaves a member unchanged (or empties
+ * a std::optional), and a value of the wrong type throws a json::error.
+ */
+
+namespace json
+{
+    // Describes one member of a mapped struct, and the name it has in JSON
+    template<typename Class, typename Member>
+    struct field
+    {
+        template<size_t N>
+        constexpr field(const char (&name)[N], Member Class::*member) : name(name), length(N - 1), member(member) {}
+
+        const char *name;
+        size_t length;
+        Member Class::*member;
+    };
+
+    // Specialize with a `static constexpr` tuple of field descriptors named `fields` to map a struct
+    template<typename T>
+    struct mapping {};
+
+    template<typename T, typename = void>
+    struct is_mapped : std::false_type {};
+
+    template<typename T>
+    struct is_mapped<T, std::void_t<decltype(mapping<T>::fields)>> : std::true_type {};
+
+    namespace typed
+    {
+        template<typename T> struct is_optional : std::false_type {};
+        template<typename T> struct is_optional<std::optional<T>> : std::true_type {};
+
+        template<typename T> struct is_vector : std::false_type {};
+        template<typename T, typename Allocator> struct is_vector<std::vector<T, Allocator>> : std::true_type {};
+
+        template<typename T> struct is_string_map : std::false_type {};
+        template<typename T, typename Compare, typename Allocator> struct is_string_map<std::map<string_t, T, Compare, Allocator>> : std::true_type {};
+
+        // Hashes a member name with the given seed (FNV-1a)
+        constexpr uint32_t name_hash(const char *name, size_t length, uint32_t seed)
+        {
+            uint32_t hash = 2166136261u ^ seed;
+            for (size_t i = 0; i < length; ++i)
+            {
+                hash ^= static_cast<unsigned char>(name[i]);
+                hash *= 16777619u;
+            }
+            return hash ^ (hash >> 16);
+        }
+
+        // Returns the number of slots in the member name table for `count` fields:
+        // twice as many as there are fields, rounded up to a power of two, so a perfect hash seed is found quickly
+        constexpr size_t table_size(size_t count)
+        {
+            size_t size = 1;
+            while (size < count * 2)
+                size *= 2;
+            return size;
+        }
+
+        struct field_name
+        {
+            const char *data;
+            size_t length;
+        };
+
+        // A perfect hash table of member names
+        // Each slot holds one more than the index of the field that hashes to it, or zero if none does
+        template<size_t Size>
+        struct hash_table
+        {
+            uint32_t seed;
+            std::array<uint8_t, Size> slots;
+        };
+
+        // Finds the first seed for which no two names hash to the same slot
+        template<size_t Size, size_t Count>
+        constexpr hash_table<Size> build_hash_table(const std::array<field_name, Count> &names)
+        {
+            for (uint32_t seed = 0; seed < 65536; ++seed)
+            {
+                hash_table<Size> table{seed, {}};
+                bool collision = false;
+
+                for (size_t i = 0; i < Count && !collision; ++i)
+                {
+                    uint8_t &slot = table.slots[name_hash(names[i].data, names[i].length, seed) & (Size - 1)];
+                    if (slot)
+                        collision = true;
+                    else
+                        slot = static_cast<uint8_t>(i + 1);
+                }
+
+                if (!collision)
+                    return table;
+            }
+
+            throw "no perfect hash found for JSON mapping"; // Fails compilation, since this is only evaluated at compile time
+        }
+
+        template<typename T, size_t... I>
+        constexpr std::array<field_name, sizeof...(I)> field_names(std::index_sequence<I...>)
+        {
+            return {{field_name{std::get<I>(mapping<T>::fields).name, std::get<I>(mapping<T>::fields).length}...}};
+        }
+
+        // The member names of a mapped struct, with their perfect hash table built at compile time
+        template<typename T>
+        struct field_table
+        {
+            static constexpr size_t count = std::tuple_size<std::remove_cv_t<decltype(mapping<T>::fields)>>::value;
+            static_assert(count < 255, "too many fields in JSON mapping");
+
+            static constexpr size_t size = table_size(count);
+            static constexpr std::array<field_name, count> names = field_names<T>(std::make_index_sequence<count>());
+            static constexpr hash_table<size> lookup = build_hash_table<size>(names);
+
+            // Returns the index of the field named `key`, or `count` if there is none
+            static size_t find(const char *key, size_t length)
+            {
+                const size_t slot = lookup.slots[name_hash(key, length, lookup.seed) & (size - 1)];
+                if (slot == 0)
+                    return count;
+
+                const field_name &name = names[slot - 1];
+                return name.length == length && memcmp(name.data, key, length) == 0? slot - 1: count;
+            }
+        };
+
+        struct type_ops;
+
+        // Where the next value of a document goes: an object of a mapped type, or nowhere (the value is skipped) if `ops` is null
+        struct sink
+        {
+            void *target;
+            const type_ops *ops;
+        };
+
+        enum kind
+        {
+            scalar_kind,
+            array_kind,
+            object_kind,
+            any_kind // A json::value, built by a value_builder
+        };
+
+        // Type-erased operations to read a value into an object of one mapped type
+        struct type_ops
+        {
+            kind kind_;
+            void (*null_value)(void *target);
+            void (*bool_value)(void *target, bool_t v);
+            void (*int_value)(void *target, int_t v);
+            void (*real_value)(void *target, real_t v);
+            void (*string_value)(void *target, const string_t &v);
+            void (*start)(void *target); // Called at the start of an array or object
+            sink (*element)(void *target); // Arrays only, returns where the next element goes
+            sink (*member)(void *target, const string_t &key); // Objects only, returns where the member goes
+            value *(*as_value)(void *target); // json::value members only, returns the value to build into
+        };
+
+        [[noreturn]] inline void mismatch() {throw error("JSON value does not match the mapped type");}
+
+        // Converts `v` to the arithmetic type T, calling mismatch() if it is outside the range of T
+        // Reals may lose precision, but not magnitude
+        template<typename T, typename V>
+        T narrow(V v)
+        {
+            if constexpr (std::is_integral<T>::value)
+            {
+                if constexpr (std::is_signed<T>::value)
+                {
+                    if (v < std::numeric_limits<T>::min() || v > std::numeric_limits<T>::max())
+                        mismatch();
+                }
+                else if (v < 0 || static_cast<std::make_unsigned_t<V>>(v) > std::numeric_limits<T>::max())
+                    mismatch();
+            }
+            else if constexpr (std::is_floating_point<V>::value)
+            {
+                if (std::isfinite(v) && (v < std::numeric_limits<T>::lowest() || v > std::numeric_limits<T>::max()))
+                    mismatch();
+            }
+
+            return static_cast<T>(v);
+        }
+
+        template<typename T> const type_ops &ops_for();
+
+        template<typename T, size_t I>
+        sink member_sink(void *target)
+        {
+            auto &member = static_cast<T *>(target)->*(std::get<I>(mapping<T>::fields).member);
+            return sink{&member, &ops_for<std::remove_reference_t<decltype(member)>>()};
+        }
+
+        template<typename T, size_t... I>
+        sink find_member(void *target, const string_t &key, std::index_sequence<I...>)
+        {
+            static constexpr sink (*members[])(void *) = {&member_sink<T, I>...};
+
+            const size_t index = field_table<T>::find(key.data(), key.size());
+            return index == field_table<T>::count? sink{nullptr, nullptr}: members[index](target);
+        }
+
+        template<typename T>
+        type_ops make_ops()
+        {
+            type_ops ops = {
+                scalar_kind,
+                [](void *) {},
+                [](void *, bool_t) {mismatch();},
+                [](void *, int_t) {mismatch();},
+                [](void *, real_t) {mismatch();},
+                [](void *, const string_t &) {mismatch();},
+                [](void *) {},
+                [](void *) -> sink {mismatch();},
+                [](void *, const string_t &) -> sink {mismatch();},
+                [](void *) -> value * {mismatch();}
+            };
+
+            if constexpr (std::is_same<T, bool>::value)
+                ops.bool_value = [](void *target, bool_t v) {*static_cast<T *>(target) = v;};
+            else if constexpr (std::is_integral<T>::value)
+                ops.int_value = [](void *target, int_t v) {*static_cast<T *>(target) = narrow<T>(v);};
+            else if constexpr (std::is_floating_point<T>::value)
+            {
+                ops.int_value = [](void *target, int_t v) {*static_cast<T *>(target) = narrow<T>(v);};
+                ops.real_value = [](void *target, real_t v) {*static_cast<T *>(target) = narrow<T>(v);};
+            }
+            else if constexpr (std::is_same<T, string_t>::value)
+                ops.string_value = [](void *target, const string_t &v) {*static_cast<T *>(target) = v;};
+            else if constexpr (std::is_same<T, value>::value)
+            {
+                ops.kind_ = any_kind;
+                ops.null_value = [](void *target) {static_cast<T *>(target)->set_null();};
+                ops.bool_value = [](void *target, bool_t v) {static_cast<T *>(target)->set_bool(v);};
+                ops.int_value = [](void *target, int_t v) {static_cast<T *>(target)->set_int(v);};
+                ops.real_value = [](void *target, real_t v) {static_cast<T *>(target)->set_real(v);};
+                ops.string_value = [](void *target, const string_t &v) {static_cast<T *>(target)->set_string(v);};
+                ops.as_value = [](void *target) {return static_cast<T *>(target);};
+            }
+            else if constexpr (is_optional<T>::value)
+            {
+                // Forward everything to the contained type, creating the contained object first
+                typedef typename T::value_type U;
+
+                ops = ops_for<U>();
+                ops.null_value = [](void *target) {static_cast<T *>(target)->reset();};
+                ops.bool_value = [](void *target, bool_t v) {ops_for<U>().bool_value(&static_cast<T *>(target)->emplace(), v);};
+                ops.int_value = [](void *target, int_t v) {ops_for<U>().int_value(&static_cast<T *>(target)->emplace(), v);};
+                ops.real_value = [](void *target, real_t v) {ops_for<U>().real_value(&static_cast<T *>(target)->emplace(), v);};
+                ops.string_value = [](void *target, const string_t &v) {ops_for<U>().string_value(&static_cast<T *>(target)->emplace(), v);};
+                ops.start = [](void *target) {ops_for<U>().start(&static_cast<T *>(target)->emplace());};
+                ops.element = [](void *target) {return ops_for<U>().element(&**static_cast<T *>(target));};
+                ops.member = [](void *target, const string_t &key) {return ops_for<U>().member(&**static_cast<T *>(target), key);};
+                ops.as_value = [](void *target) {return ops_for<U>().as_value(&static_cast<T *>(target)->emplace());};
+            }
+            else if constexpr (is_vector<T>::value)
+            {
+                ops.kind_ = array_kind;
+                ops.start = [](void *target) {static_cast<T *>(target)->clear();};
+                ops.element = [](void *target)
+                {
+                    T &v = *static_cast<T *>(target);
+                    v.emplace_back();
+                    return sink{&v.back(), &ops_for<typename T::value_type>()};
+                };
+            }
+            else if constexpr (is_string_map<T>::value)
+            {
+                ops.kind_ = object_kind;
+                ops.start = [](void *target) {static_cast<T *>(target)->clear();};
+                ops.member = [](void *target, const string_t &key)
+                {
+                    return sink{&(*static_cast<T *>(target))[key], &ops_for<typename T::mapped_type>()};
+                };
+            }
+            else
+            {
+                static_assert(is_mapped<T>::value, "type has no JSON mapping");
+
+                ops.kind_ = object_kind;
+                ops.member = [](void *target, const string_t &key)
+                {
+                    return find_member<T>(target, key, std::make_index_sequence<field_table<T>::count>());
+                };
+            }
+
+            return ops;
+        }
+
+        template<typename T>
+        const type_ops &ops_for()
+        {
+            static const type_ops ops = make_ops<T>();
+            return ops;
+        }
+    }
+
+    // Serializes `v`, a mapped struct or any supported member type, without indentation
+    template<typename T>
+    writer &write_typed(writer &w, const T &v)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+            v? w.str().append("true", 4): w.str().append("false", 5);
+        else if constexpr (std::is_integral<T>::value)
+            w.write_int(static_cast<int_t>(v));
+        else if constexpr (std::is_floating_point<T>::value)
+            w.write_real(static_cast<real_t>(v));
+        else if constexpr (std::is_same<T, string_t>::value)
+            w.write_string(v);
+        else if constexpr (std::is_same<T, value>::value)
+            w.write(v);
+        else if constexpr (typed::is_optional<T>::value)
+        {
+            if (v)
+                write_typed(w, *v);
+            else
+                w.str().append("null", 4);
+        }
+        else if constexpr (typed::is_vector<T>::value)
+        {
+            w.str().push_back('[');
+            for (auto it = v.begin(); it != v.end(); ++it)
+            {
+                if (it != v.begin())
+                    w.str().push_back(',');
+                write_typed(w, *it);
+            }
+            w.str().push_back(']');
+        }
+        else if constexpr (typed::is_string_map<T>::value)
+        {
+            w.str().push_back('{');
+            for (auto it = v.begin(); it != v.end(); ++it)
+            {
+                if (it != v.begin())
+                    w.str().push_back(',');
+                w.write_string(it->first).str().push_back(':');
+                write_typed(w, it->second);
+            }
+            w.str().push_back('}');
+        }
+        else
+        {
+            static_assert(is_mapped<T>::value, "type has no JSON mapping");
+
+            bool first = true;
+            auto write_member = [&](const auto &f)
+            {
+                const auto &member = v.*(f.member);
+                if constexpr (typed::is_optional<std::decay_t<decltype(member)>>::value)
+                    if (!member)
+                        return;
+
+                if (!first)
+                    w.str().push_back(',');
+                first = false;
+
+                w.write_string(f.name, f.length).str().push_back(':');
+                write_typed(w, member);
+            };
+
+            w.str().push_back('{');
+            std::apply([&](const auto &... f) {(write_member(f), ...);}, mapping<T>::fields);
+            w.str().push_back('}');
+        }
+
+        return w;
+    }
+
+    template<typename T>
+    std::string to_json_typed(const T &v)
+    {
+        std::string out;
+        writer w(out);
+        write_typed(w, v);
+        return out;
+    }
+
+    /* typed_builder class - An event handler that reads the events it receives into a mapped struct.
+     *
+     * Members of type json::value are built by a value_builder.
+     */
+    class typed_builder : public event_handler
+    {
+    public:
+        template<typename T>
+        typed_builder(T &v) : root_{&v, &typed::ops_for<T>()}, member_{nullptr, nullptr}, started_(false), skip_(0), building_(false), builder_(root_value_) {}
+
+        bool null_value()
+        {
+            if (building_) return builder_.null_value();
+            if (skip_) return true;
+
+            const typed::sink s = next();
+            if (s.ops) s.ops->null_value(s.target);
+            return true;
+        }
+        bool bool_value(bool_t v)
+        {
+            if (building_) return builder_.bool_value(v);
+            if (skip_) return true;
+
+            const typed::sink s = next();
+            if (s.ops) s.ops->bool_value(s.target, v);
+            return true;
+        }
+        bool int_value(int_t v)
+        {
+            if (building_) return builder_.int_value(v);
+            if (skip_) return true;
+
+            const typed::sink s = next();
+            if (s.ops) s.ops->int_value(s.target, v);
+            return true;
+        }
+        bool real_value(real_t v)
+        {
+            if (building_) return builder_.real_value(v);
+            if (skip_) return true;
+
+            const typed::sink s = next();
+            if (s.ops) s.ops->real_value(s.target, v);
+            return true;
+        }
+        bool string_value(const string_t &v)
+        {
+            if (building_) return builder_.string_value(v);
+            if (skip_) return true;
+
+            const typed::sink s = next();
+            if (s.ops) s.ops->string_value(s.target, v);
+            return true;
+        }
+        bool key(const string_t &k)
+        {
+            if (building_) return builder_.key(k);
+            if (skip_) return true;
+
+            const typed::sink &top = stack_.back();
+            member_ = top.ops->member(top.target, k);
+            return true;
+        }
+
+        bool start_array() {return start(typed::array_kind, &event_handler::start_array);}
+        bool end_array() {return end(&event_handler::end_array);}
+        bool start_object() {return start(typed::object_kind, &event_handler::start_object);}
+        bool end_object() {return end(&event_handler::end_object);}
+
+    private:
+        // Returns where the next value goes
+        typed::sink next()
+        {
+            if (stack_.empty())
+            {
+                if (started_)
+                    return typed::sink{nullptr, nullptr};
+
+                started_ = true;
+                return root_;
+            }
+
+            const typed::sink &top = stack_.back();
+            return top.ops->kind_ == typed::array_kind? top.ops->element(top.target): member_;
+        }
+
+        bool start(typed::kind kind, bool (event_handler::*event)())
+        {
+            if (building_) return (builder_.*event)();
+            if (skip_) return ++skip_, true;
+
+            const typed::sink s = next();
+            if (!s.ops)
+                skip_ = 1;
+            else if (s.ops->kind_ == typed::any_kind)
+            {
+                builder_.reset(*s.ops->as_value(s.target));
+                building_ = true;
+                return (builder_.*event)();
+            }
+            else if (s.ops->kind_ != kind)
+                typed::mismatch();
+            else
+            {
+                s.ops->start(s.target);
+                stack_.push_back(s);
+            }
+
+            return true;
+        }
+
+        bool end(bool (event_handler::*event)())
+        {
+            if (building_)
+            {
+                const bool result = (builder_.*event)();
+                building_ = !builder_.complete();
+                return result;
+            }
+            if (skip_) return --skip_, true;
+
+            stack_.pop_back();
+            return true;
+        }
+
+        typed::sink root_;
+        typed::sink member_;
+        bool started_;
+        size_t skip_; // Depth of nested arrays or objects being skipped
+        std::vector<typed::sink> stack_;
+
+        bool building_;
+        value root_value_; // Placeholder, until the builder is reset to a json::value member
+        value_builder builder_;
+    };
+
+    // Reads a JSON buffer into `v`, a mapped struct or any supported member type
+    // Throws json::error if the buffer is not valid JSON or does not match the mapping
+    // Strings are checked for valid UTF-8 if `validate_utf8` is set (see parser::validate_utf8())
+    template<typename T>
+    void from_json_typed(const char *json, size_t length, T &v, bool validate_utf8 = validate_utf8_by_default)
+    {
+        typed_builder builder(v);
+        parser(json, length).validate_utf8(validate_utf8).parse_all_events(builder);
+    }
+
+    template<typename T>
+    void from_json_typed(const std::string &json, T &v, bool validate_utf8 = validate_utf8_by_default)
+    {
+        from_json_typed(json.data(), json.size(), v, validate_utf8);
+    }
+}
+
+// Maps the given members of struct `type`, which must be at global scope, to JSON members with the same names (at most 32)
+#define JSON_MAPPING(type, ...) \
+    template<> struct json::mapping<type> \
+    { \
+        static constexpr auto fields = std::make_tuple(JSON_MAPPING_EXPAND(JSON_MAPPING_CAT(JSON_MAPPING_FIELDS_, JSON_MAPPING_COUNT(__VA_ARGS__))(type, __VA_ARGS__))); \
+    };
+
+#define JSON_MAPPING_EXPAND(x) x
+#define JSON_MAPPING_CAT(a, b) JSON_MAPPING_CAT_(a, b)
+#define JSON_MAPPING_CAT_(a, b) a##b
+#define JSON_MAPPING_COUNT(...) JSON_MAPPING_EXPAND(JSON_MAPPING_COUNT_(__VA_ARGS__, \
+    32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define JSON_MAPPING_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, \
+    _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+
+#define JSON_MAPPING_FIELD(t, m) json::field<t, decltype(t::m)>(#m, &t::m)
+#define JSON_MAPPING_FIELDS_1(t, m) JSON_MAPPING_FIELD(t, m)
+#define JSON_MAPPING_FIELDS_2(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_1(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_3(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_2(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_4(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_3(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_5(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_4(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_6(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_5(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_7(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_6(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_8(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_7(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_9(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_8(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_10(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_9(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_11(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_10(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_12(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_11(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_13(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_12(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_14(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_13(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_15(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_14(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_16(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_15(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_17(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_16(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_18(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_17(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_19(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_18(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_20(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_19(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_21(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_20(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_22(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_21(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_23(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_22(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_24(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_23(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_25(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_24(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_26(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_25(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_27(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_26(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_28(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_27(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_29(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_28(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_30(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_29(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_31(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_30(t, __VA_ARGS__))
+#define JSON_MAPPING_FIELDS_32(t, m, ...) JSON_MAPPING_FIELD(t, m), JSON_MAPPING_EXPAND(JSON_MAPPING_FIELDS_31(t, __VA_ARGS__))
+
+#endif // JSON_MAPPING_H
@@ -0,0 +1,960 @@
+#ifndef JSON_SCANNER_H
+#define JSON_SCANNER_H
+
+#include "json.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#if !defined(JSON_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JSON_SCANNER_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_SCANNER_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* Two-stage parsing for large JSON documents
+ *
+ * Stage 1 (structural_index::build) classifies the input 64 bytes at a time, using SSE2 or AVX2
+ * when the CPU supports them and plain C++ otherwise, and records the offset of every structural
+ * character outside of strings ('{', '}', '[', ']', ':', ','), of both quotes around each string,
+ * and of the first character of every number or literal.
+ *
+ * Stage 2 (structural_index::parse) walks that index to build a json::value without having to
+ * look at whitespace or string contents again, except to decode them. Alternatively, lazy_value
+ * keeps the index and only decodes the values that are actually read. For responses dominated by one
+ * large array, structural_index::parse_parallel finds where each element starts from the bracket
+ * tokens alone, then runs stage 2 on slices of the elements in several threads.
+ *
+ * Define JSON_NO_SIMD to force the scalar implementation.
+ */
+
+namespace json
+{
+    namespace scanner
+    {
+        // Bit masks of character classes for one 64-byte block, bit i representing byte i
+        struct block_masks
+        {
+            uint64_t quote;
+            uint64_t backslash;
+            uint64_t op;
+            uint64_t whitespace;
+        };
+
+        typedef void (*classify_function)(const char *block, block_masks &masks);
+
+        inline void classify_scalar(const char *block, block_masks &masks)
+        {
+            masks.quote = masks.backslash = masks.op = masks.whitespace = 0;
+            for (int i = 0; i < 64; ++i)
+            {
+                const uint64_t bit = uint64_t(1) << i;
+                switch (block[i])
+                {
+                    case '"': masks.quote |= bit; break;
+                    case '\\': masks.backslash |= bit; break;
+                    case '{': case '}': case '[': case ']': case ':': case ',': masks.op |= bit; break;
+                    case ' ': case '\t': case '\n': case '\r': masks.whitespace |= bit; break;
+                    default: break;
+                }
+            }
+        }
+
+#ifdef JSON_SCANNER_SSE2
+        inline void classify_sse2(const char *block, block_masks &masks)
+        {
+            masks.quote = masks.backslash = masks.op = masks.whitespace = 0;
+            for (int i = 0; i < 64; i += 16)
+            {
+                const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i));
+                const __m128i op = _mm_or_si128(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('{')),
+                                                                          _mm_cmpeq_epi8(in, _mm_set1_epi8('}'))),
+                                                             _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('[')),
+                                                                          _mm_cmpeq_epi8(in, _mm_set1_epi8(']')))),
+                                                _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8(':')),
+                                                             _mm_cmpeq_epi8(in, _mm_set1_epi8(','))));
+                const __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8(' ')),
+                                                             _mm_cmpeq_epi8(in, _mm_set1_epi8('\t'))),
+                                                _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('\n')),
+                                                             _mm_cmpeq_epi8(in, _mm_set1_epi8('\r'))));
+
+                masks.quote |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(in, _mm_set1_epi8('"'))))) << i;
+                masks.backslash |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(in, _mm_set1_epi8('\\'))))) << i;
+                masks.op |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(op))) << i;
+                masks.whitespace |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(ws))) << i;
+            }
+        }
+#endif
+
+#ifdef JSON_SCANNER_AVX2
+        __attribute__((target("avx2")))
+        inline void classify_avx2(const char *block, block_masks &masks)
+        {
+            masks.quote = masks.backslash = masks.op = masks.whitespace = 0;
+            for (int i = 0; i < 64; i += 32)
+            {
+                const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + i));
+                const __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('{')),
+                                                                                   _mm256_cmpeq_epi8(in, _mm256_set1_epi8('}'))),
+                                                                   _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('[')),
+                                                                                   _mm256_cmpeq_epi8(in, _mm256_set1_epi8(']')))),
+                                                   _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8(':')),
+                                                                   _mm256_cmpeq_epi8(in, _mm256_set1_epi8(','))));
+                const __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8(' ')),
+                                                                   _mm256_cmpeq_epi8(in, _mm256_set1_epi8('\t'))),
+                                                   _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('\n')),
+                                                                   _mm256_cmpeq_epi8(in, _mm256_set1_epi8('\r'))));
+
+                masks.quote |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('"'))))) << i;
+                masks.backslash |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('\\'))))) << i;
+                masks.op |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << i;
+                masks.whitespace |= uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(ws))) << i;
+            }
+        }
+#endif
+
+        // Returns the best classifier supported by the running CPU
+        inline classify_function select_classifier(cstring_t *name = NULL)
+        {
+#ifdef JSON_SCANNER_AVX2
+            if (__builtin_cpu_supports("avx2"))
+            {
+                if (name) *name = "avx2";
+                return classify_avx2;
+            }
+#endif
+#ifdef JSON_SCANNER_SSE2
+            if (name) *name = "sse2";
+            return classify_sse2;
+#else
+            if (name) *name = "scalar";
+            return classify_scalar;
+#endif
+        }
+
+        inline int trailing_zeroes(uint64_t v)
+        {
+#if defined(__GNUC__)
+            return __builtin_ctzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+            unsigned long idx;
+            _BitScanForward64(&idx, v);
+            return static_cast<int>(idx);
+#else
+            int n = 0;
+            while (!(v & 1))
+                v >>= 1, ++n;
+            return n;
+#endif
+        }
+
+        // Computes the inclusive running XOR of all bits, so bits are set from an opening quote up to, but not including, its closing quote
+        inline uint64_t prefix_xor(uint64_t v)
+        {
+            v ^= v << 1;
+            v ^= v << 2;
+            v ^= v << 4;
+            v ^= v << 8;
+            v ^= v << 16;
+            v ^= v << 32;
+            return v;
+        }
+    }
+
+    /* structural_index class - The result of stage 1 scanning of a JSON buffer.
+     *
+     * The buffer must outlive the index. Buffers of 4GB or larger are not supported.
+     */
+    class structural_index
+    {
+    public:
+        structural_index() : data_(NULL), length_(0), validate_(validate_utf8_by_default) {}
+        structural_index(const char *data, size_t length) : validate_(validate_utf8_by_default) {build(data, length);}
+
+        // Enables or disables checking that strings are valid UTF-8 in stage 2 (see parser::validate_utf8())
+        structural_index &validate_utf8(bool validate = true)
+        {
+            validate_ = validate;
+            return *this;
+        }
+
+        // Returns the name of the stage 1 implementation that will be used on this CPU ("avx2", "sse2", or "scalar")
+        static cstring_t implementation()
+        {
+            cstring_t name;
+            scanner::select_classifier(&name);
+            return name;
+        }
+
+        // Scans the buffer, replacing any previously built index
+        // Throws json::error if a string is not terminated before the end of the buffer
+        void build(const char *data, size_t length)
+        {
+            if (length >= UINT32_MAX)
+                throw error("JSON buffer is too large to index");
+
+            data_ = data;
+            length_ = length;
+            positions_.clear();
+            positions_.reserve(length / 4 + 16);
+
+            const scanner::classify_function classify = scanner::select_classifier();
+            const uint64_t even_bits = 0x5555555555555555ull;
+            uint64_t prev_escaped = 0; // 1 if the first byte of the next block is escaped
+            uint64_t prev_in_string = 0; // All ones if the previous block ended inside a string
+            uint64_t prev_scalar = 0; // 1 if the previous block ended inside a number or literal
+            char tail[64];
+
+            for (size_t base = 0; base < length; base += 64)
+            {
+                const char *block = data + base;
+                scanner::block_masks masks;
+
+                if (length - base < 64)
+                {
+                    memset(tail, ' ', sizeof(tail));
+                    memcpy(tail, block, length - base);
+                    block = tail;
+                }
+
+                classify(block, masks);
+
+                // Find characters escaped by an odd-length run of backslashes
+                uint64_t backslash = masks.backslash & ~prev_escaped;
+                const uint64_t follows_escape = backslash << 1 | prev_escaped;
+                const uint64_t odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+                const uint64_t sequences_starting_on_even_bits = odd_sequence_starts + backslash;
+                prev_escaped = sequences_starting_on_even_bits < odd_sequence_starts;
+                const uint64_t escaped = (even_bits ^ (sequences_starting_on_even_bits << 1)) & follows_escape;
+
+                const uint64_t quote = masks.quote & ~escaped;
+                const uint64_t in_string = scanner::prefix_xor(quote) ^ prev_in_string;
+                prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+                const uint64_t scalar = ~(masks.op | masks.whitespace | quote | in_string);
+                const uint64_t scalar_starts = scalar & ~(scalar << 1 | prev_scalar);
+                prev_scalar = scalar >> 63;
+
+                uint64_t structurals = (masks.op & ~in_string) | quote | scalar_starts;
+                if (block == tail)
+                    structurals &= (length - base) == 64? ~uint64_t(0): (uint64_t(1) << (length - base)) - 1;
+
+                while (structurals)
+                {
+                    positions_.push_back(static_cast<uint32_t>(base + scanner::trailing_zeroes(structurals)));
+                    structurals &= structurals - 1;
+                }
+            }
+
+            if (prev_in_string)
+                throw error("unexpected end of string", length);
+        }
+
+        const std::vector<uint32_t> &positions() const {return positions_;}
+        size_t size() const {return positions_.size();}
+        const char *data() const {return data_;}
+        size_t length() const {return length_;}
+
+        // Stage 2: builds the JSON value in the indexed buffer into `v`
+        // Throws json::error if anything but whitespace follows the value, as from_json() does
+        void parse(value &v) const
+        {
+            size_t i = 0;
+            parse(v, i);
+            if (i < positions_.size())
+                fail("unexpected character after JSON value", i);
+        }
+
+        // Builds the JSON value starting at token `i` into `v`, and advances `i` to the token following it
+        void parse(value &v, size_t &i) const
+        {
+            const size_t n = positions_.size();
+            std::vector<value *> stack;
+            value *current = &v;
+
+            while (true)
+            {
+                // Parse the value starting at token i into *current
+                if (i >= n)
+                    fail("expected JSON value", i);
+
+                const char c = data_[positions_[i]];
+                if (c == '{' || c == '[')
+                {
+                    const char close = c == '{'? '}': ']';
+                    if (c == '{')
+                        current->get_object().clear();
+                    else
+                        current->get_array().clear();
+
+                    stack.push_back(current);
+                    if (++i < n && data_[positions_[i]] == close)
+                    {
+                        ++i; // Empty container, so it is already complete
+                        stack.pop_back();
+                    }
+                    else if (!next_element(stack.back(), current, i))
+                        continue;
+                }
+                else if (c == '"')
+                    parse_string(i, *current);
+                else if (c == '}' || c == ']' || c == ':' || c == ',')
+                    fail("expected JSON value", i);
+                else
+                    parse_scalar(i, *current);
+
+                // The value is complete, so continue with its parent, closing parents as necessary
+                while (true)
+                {
+                    if (stack.empty())
+                        return;
+
+                    if (i >= n)
+                        fail(stack.back()->is_array()? "expected ',' separating array elements or ']' ending array":
+                                                       "expected ',' separating key value pairs or '}' ending object", i);
+
+                    value *parent = stack.back();
+                    const char next = data_[positions_[i]];
+                    if (next == (parent->is_array()? ']': '}'))
+                    {
+                        ++i;
+                        if (parent->is_object())
+                            finish_members(parent->get_object());
+                        stack.pop_back();
+                    }
+                    else if (next == ',')
+                    {
+                        ++i;
+                        next_element(parent, current, i);
+                        break;
+                    }
+                    else
+                        fail(parent->is_array()? "expected ',' separating array elements or ']' ending array":
+                                                 "expected ',' separating key value pairs or '}' ending object", i);
+                }
+            }
+        }
+
+        value parse() const
+        {
+            value v;
+            parse(v);
+            return v;
+        }
+
+        // Stage 2, like parse(), but if the top-level value is an object, the elements of its array member `member`
+        // are parsed on `threads` threads at once (or one per hardware thread if `threads` is zero) and assembled in order
+        // Suited to large CouchDB responses, whose "rows" array holds almost all of the data
+        // With JSON_PMR, the elements allocate from the resource of `v`, so they are only parsed on several threads if that
+        // resource may be used by several threads at once: std::pmr::new_delete_resource() or a std::pmr::synchronized_pool_resource.
+        // Any other resource, such as a std::pmr::monotonic_buffer_resource, is only used by the calling thread
+        void parse_parallel(value &v, const string_t &member, size_t threads = 0) const
+        {
+            const size_t n = positions_.size();
+            size_t i = 0;
+
+            if (n == 0 || data_[positions_[0]] != '{')
+            {
+                parse(v);
+                return;
+            }
+
+            object_t &obj = v.get_object();
+            obj.clear();
+
+            if (++i < n && data_[positions_[i]] == '}')
+            {
+                if (++i < n)
+                    fail("unexpected character after JSON value", i);
+                return;
+            }
+
+            while (true)
+            {
+                string_t key;
+                if (i >= n || data_[positions_[i]] != '"')
+                    fail("expected string", i);
+                parse_string(i, key);
+
+                if (i >= n || data_[positions_[i]] != ':')
+                    fail("expected ':' separating key and value in object", i);
+                ++i;
+
+                value &child = parse_member(obj, key);
+                if (i < n && data_[positions_[i]] == '[' && key == member)
+                    parse_elements_parallel(child, i, threads);
+                else
+                    parse(child, i);
+
+                if (i >= n || (data_[positions_[i]] != ',' && data_[positions_[i]] != '}'))
+                    fail("expected ',' separating key value pairs or '}' ending object", i);
+                else if (data_[positions_[i++]] == '}')
+                    break;
+            }
+
+            finish_members(obj);
+            if (i < n)
+                fail("unexpected character after JSON value", i);
+        }
+
+    private:
+        // Arrays with fewer elements per thread than this are not worth splitting up
+        static const size_t min_parallel_elements = 1024;
+
+        // Returns the token following the value that starts at token `i`, only looking at brackets and quotes
+        size_t skip_value(size_t i) const
+        {
+            const size_t n = positions_.size();
+            size_t depth = 0;
+
+            do
+            {
+                if (i >= n)
+                    fail("expected JSON value", i);
+
+                switch (data_[positions_[i]])
+                {
+                    case '{':
+                    case '[': ++depth; ++i; break;
+                    case '}':
+                    case ']': if (depth == 0) fail("expected JSON value", i); --depth; ++i; break;
+                    case '"': i += 2; break;
+                    default: ++i; break;
+                }
+            } while (depth);
+
+            return i;
+        }
+
+        // Parses the array starting at token `i` into `v`, splitting its elements between threads, and advances `i` past it
+        void parse_elements_parallel(value &v, size_t &i, size_t threads) const
+        {
+            const size_t n = positions_.size();
+            std::vector<size_t> starts; // The first token of each element, then the closing bracket's token
+
+            // Find where every element starts by skipping over the elements, which only needs the bracket and quote tokens
+            for (++i; i < n && data_[positions_[i]] != ']'; ++i)
+            {
+                starts.push_back(i);
+                i = skip_value(i);
+                if (i >= n || data_[positions_[i]] != ',')
+                    break;
+            }
+            if (i >= n || data_[positions_[i]] != ']')
+                fail("expected ',' separating array elements or ']' ending array", i);
+            if (!starts.empty() && data_[positions_[i - 1]] == ',')
+                fail("expected JSON value", i);
+
+            const size_t count = starts.size();
+            starts.push_back(i++);
+
+            if (threads == 0)
+                threads = std::max(std::thread::hardware_concurrency(), 1u);
+            threads = std::max<size_t>(std::min(threads, count / min_parallel_elements), 1);
+#ifdef JSON_PMR
+            if (!is_thread_safe(v.get_resource()))
+                threads = 1;
+#endif
+
+            array_t &arr = v.get_array();
+            arr.clear();
+            arr.resize(count);
+
+            // Parses elements [first, last), each of which must end at the separator found above
+            auto parse_range = [&](size_t first, size_t last)
+            {
+                for (size_t e = first; e < last; ++e)
+                {
+                    size_t token = starts[e];
+                    parse(arr[e], token);
+
+                    if (token != (e + 1 == count? starts[count]: starts[e + 1] - 1))
+                        fail("expected ',' separating array elements or ']' ending array", token);
+                }
+            };
+
+            if (threads == 1)
+            {
+                parse_range(0, count);
+                return;
+            }
+
+            std::vector<std::thread> workers;
+            std::vector<std::exception_ptr> errors(threads);
+
+            for (size_t t = 1; t < threads; ++t)
+                workers.emplace_back([&, t]()
+                {
+                    try {parse_range(count * t / threads, count * (t + 1) / threads);}
+                    catch (...) {errors[t] = std::current_exception();}
+                });
+
+            try {parse_range(0, count / threads);}
+            catch (...) {errors[0] = std::current_exception();}
+
+            for (std::thread &worker: workers)
+                worker.join();
+
+            for (const std::exception_ptr &e: errors)
+                if (e)
+                    std::rethrow_exception(e);
+        }
+
+#ifdef JSON_PMR
+        // Returns true if `resource` is one of the standard resources that may be used by several threads at once
+        static bool is_thread_safe(memory_resource *resource)
+        {
+            return resource == std::pmr::new_delete_resource() ||
+                   dynamic_cast<std::pmr::synchronized_pool_resource *>(resource) != nullptr;
+        }
+#endif
+
+        void fail(cstring_t reason, size_t token) const
+        {
+            throw error(reason, token < positions_.size()? positions_[token]: length_);
+        }
+
+        // Prepares `current` to receive the next element of `parent`, whose opening token or separating comma has been consumed
+        // Always returns false, so it can be used to restart value parsing
+        bool next_element(value *parent, value *&current, size_t &i) const
+        {
+            if (parent->is_array())
+            {
+                array_t &arr = parent->get_array();
+                arr.push_back(value());
+                current = &arr.back();
+            }
+            else
+            {
+                string_t key;
+                if (i >= positions_.size() || data_[positions_[i]] != '"')
+                    fail("expected string", i);
+                parse_string(i, key);
+
+                if (i >= positions_.size() || data_[positions_[i]] != ':')
+                    fail("expected ':' separating key and value in object", i);
+                ++i;
+
+                current = &parse_member(parent->get_object(), key);
+            }
+
+            return false;
+        }
+
+        // Decodes the string whose opening and closing quotes are at tokens i and i + 1
+        void parse_string(size_t &i, value &out) const
+        {
+            parse_string(i, out.get_string());
+        }
+
+        void parse_string(size_t &i, string_t &out) const
+        {
+            if (i + 1 >= positions_.size() || data_[positions_[i + 1]] != '"')
+                fail("unexpected end of string", i);
+
+            const char *begin = data_ + positions_[i];
+            const char *end = data_ + positions_[i + 1] + 1;
+            if (memchr(begin + 1, '\\', end - begin - 2) == NULL && (!validate_ || is_valid_utf8(begin + 1, end - begin - 2)))
+                out.assign(begin + 1, end - 1); // Escape-free strings need no decoding, and the parser reports invalid UTF-8
+            else
+            {
+                value decoded;
+                parser(data_, begin, end).validate_utf8(validate_).parse(decoded);
+                out.swap(decoded.get_string());
+            }
+
+            i += 2;
+        }
+
+        // Parses the number or literal starting at token i, which extends to the next token or the end of the buffer
+        void parse_scalar(size_t &i, value &v) const
+        {
+            const char *begin = data_ + positions_[i];
+            const char *end = i + 1 < positions_.size()? data_ + positions_[i + 1]: data_ + length_;
+            parser p(data_, begin, end);
+
+            p.parse(v);
+            if (!p.at_end())
+                throw error("unexpected character after JSON value", p.offset());
+
+            ++i;
+        }
+
+        const char *data_;
+        size_t length_;
+        bool validate_;
+        std::vector<uint32_t> positions_;
+    };
+
+    // Parses a JSON buffer with the two-stage structural scanner
+    inline value from_json_indexed(const char *json, size_t length)
+    {
+        return structural_index(json, length).parse();
+    }
+
+    inline value from_json_indexed(const std::string &json)
+    {
+        return from_json_indexed(json.data(), json.size());
+    }
+
+    // Parses a JSON buffer with the two-stage structural scanner, parsing the elements of the top-level object's
+    // array member `member` on `threads` threads at once (or one per hardware thread if `threads` is zero)
+    // With JSON_PMR, this is only done if the default resource may be shared between threads (see structural_index::parse_parallel())
+    inline value from_json_parallel(const char *json, size_t length, const string_t &member = "rows", size_t threads = 0)
+    {
+        value v;
+        structural_index(json, length).parse_parallel(v, member, threads);
+        return v;
+    }
+
+    inline value from_json_parallel(const std::string &json, const string_t &member = "rows", size_t threads = 0)
+    {
+        return from_json_parallel(json.data(), json.size(), member, threads);
+    }
+
+    /* lazy_value class - A read-only view of one value in a JSON buffer, decoded on demand.
+     *
+     * Constructing a lazy_value only runs stage 1 of the scanner over the buffer and pairs up the
+     * brackets of every array and object. Members and elements are found by walking the index,
+     * stepping over nested arrays and objects in one step, and a number or string is only decoded
+     * when it is read. This suits responses of which only a few members are ever looked at, such as
+     * reading the revision of a whole document.
+     *
+     * A lazy_value shares ownership of the buffer and its index, so it is cheap to copy and stays
+     * valid on its own. The read-only accessors mirror those of json::value: missing members and
+     * elements are null, and strings are returned by value. Use get() to build a json::value out of
+     * any subtree. Syntax errors in the parts that are read throw json::error, but errors in parts
+     * that are never read are not detected.
+     */
+    class lazy_value
+    {
+        // The scanned buffer, shared by all lazy_values that refer to it
+        struct shared_index
+        {
+            shared_index(const std::shared_ptr<const string_t> &buffer, bool validate)
+                : buffer(buffer)
+                , index(buffer->data(), buffer->size())
+                , closes(index.size())
+                , validate(validate)
+            {
+                const std::vector<uint32_t> &pos = index.positions();
+                std::vector<uint32_t> open;
+
+                for (uint32_t i = 0; i < pos.size(); ++i)
+                {
+                    const char c = buffer->data()[pos[i]];
+                    if (c == '{' || c == '[')
+                        open.push_back(i);
+                    else if (c == '}' || c == ']')
+                    {
+                        if (open.empty())
+                            throw error("unexpected character after JSON value", pos[i]);
+                        else if (buffer->data()[pos[open.back()]] != (c == '}'? '{': '['))
+                            throw error(c == '}'? "expected ',' separating array elements or ']' ending array":
+                                                  "expected ',' separating key value pairs or '}' ending object", pos[i]);
+                        closes[open.back()] = i;
+                        open.pop_back();
+                    }
+                }
+
+                if (!open.empty())
+                    throw error("unexpected end of JSON input", buffer->size());
+            }
+
+            char at(uint32_t token) const {return buffer->data()[index.positions()[token]];}
+
+            void fail(cstring_t reason, uint32_t token) const
+            {
+                throw error(reason, token < index.size()? index.positions()[token]: buffer->size());
+            }
+
+            // Returns the token following the value that starts at `token`
+            uint32_t skip(uint32_t token) const
+            {
+                switch (at(token))
+                {
+                    case '{': case '[': return closes[token] + 1;
+                    case '"': return token + 2;
+                    default: return token + 1;
+                }
+            }
+
+            // Returns the first element or member key of the container opened at `token`, or npos if it is empty
+            uint32_t first_child(uint32_t token) const
+            {
+                return closes[token] == token + 1? npos: checked(token + 1, at(token) == '{');
+            }
+
+            // Returns the element or member key that follows the one at `token`, or npos if it is the last one
+            uint32_t next_child(uint32_t token, bool object) const
+            {
+                const uint32_t after = skip(object? value_of(token): token);
+                if (after >= index.size())
+                    fail("unexpected end of JSON input", after);
+
+                switch (at(after))
+                {
+                    case ',': return checked(after + 1, object);
+                    case '}': if (object) return npos; break;
+                    case ']': if (!object) return npos; break;
+                    default: break;
+                }
+
+                fail(object? "expected ',' separating key value pairs or '}' ending object":
+                             "expected ',' separating array elements or ']' ending array", after);
+                return npos;
+            }
+
+            // Returns the value of the member whose key is at `token`
+            uint32_t value_of(uint32_t token) const {return token + 3;}
+
+            // Checks that an element or member starts at `token`, and returns it
+            uint32_t checked(uint32_t token, bool object) const
+            {
+                if (token >= index.size())
+                    fail("expected JSON value", token);
+                else if (object && at(token) != '"')
+                    fail("expected string", token);
+                else if (object && (token + 2 >= index.size() || at(token + 2) != ':'))
+                    fail("expected ':' separating key and value in object", token + 2);
+                else if (object && token + 3 >= index.size())
+                    fail("expected JSON value", token + 3);
+                return token;
+            }
+
+            // Returns the bytes from the start of the value at `token` up to the start of the next token
+            void range(uint32_t token, const char *&begin, const char *&end) const
+            {
+                const uint32_t last = skip(token) - 1;
+                begin = buffer->data() + index.positions()[token];
+                end = at(token) == '{' || at(token) == '[' || at(token) == '"'? buffer->data() + index.positions()[last] + 1:
+                      last + 1 < index.size()? buffer->data() + index.positions()[last + 1]: buffer->data() + buffer->size();
+            }
+
+            // Decodes the string with quotes at tokens `token` and `token + 1`
+            string_t decode(uint32_t token) const
+            {
+                const char *begin, *end;
+                range(token, begin, end);
+                if (memchr(begin + 1, '\\', end - begin - 2) == NULL && (!validate || is_valid_utf8(begin + 1, end - begin - 2)))
+                    return string_t(begin + 1, end - 1);
+
+                value decoded;
+                parser(buffer->data(), begin, end).validate_utf8(validate).parse(decoded);
+                return std::move(decoded.get_string());
+            }
+
+            // Returns true if the string with quotes at tokens `token` and `token + 1` is equal to `key`
+            bool equals(uint32_t token, string_ref key) const
+            {
+                const char *begin = buffer->data() + index.positions()[token] + 1;
+                const char *end = buffer->data() + index.positions()[token + 1];
+                if (memchr(begin, '\\', end - begin) == NULL)
+                    return string_ref(begin, end - begin) == key;
+                return string_ref(decode(token)) == key;
+            }
+
+            std::shared_ptr<const string_t> buffer;
+            structural_index index;
+            std::vector<uint32_t> closes; // For each token that opens an array or object, the token that closes it
+            bool validate; // Whether strings are checked for valid UTF-8 as they are decoded
+        };
+
+    public:
+        static const uint32_t npos = UINT32_MAX;
+
+        /* const_iterator class - Iterates over the elements of an array, or the members of an object.
+         */
+        class const_iterator
+        {
+            friend class lazy_value;
+
+            const_iterator(const std::shared_ptr<const shared_index> &index, uint32_t token, bool object)
+                : index_(index), token_(token), object_(object) {}
+
+        public:
+            const_iterator() : token_(npos), object_(false) {}
+
+            // Returns the name of the current member, or an empty string for an array element
+            string_t key() const {return object_? index_->decode(token_): string_t();}
+
+            lazy_value operator*() const {return lazy_value(index_, object_? index_->value_of(token_): token_);}
+
+            const_iterator &operator++()
+            {
+                token_ = index_->next_child(token_, object_);
+                return *this;
+            }
+            const_iterator operator++(int)
+            {
+                const_iterator it(*this);
+                ++*this;
+                return it;
+            }
+
+            bool operator==(const const_iterator &other) const {return token_ == other.token_;}
+            bool operator!=(const const_iterator &other) const {return token_ != other.token_;}
+
+        private:
+            std::shared_ptr<const shared_index> index_;
+            uint32_t token_; // The element, or the key of the member, or npos at the end
+            bool object_;
+        };
+
+        lazy_value() : token_(npos) {}
+        // Indexes `buffer`, throwing json::error if its strings or brackets are unbalanced, or if anything
+        // but whitespace follows the top-level value, as from_json() does
+        // Strings are checked for valid UTF-8 as they are read if `validate_utf8` is set (see parser::validate_utf8())
+        explicit lazy_value(const std::shared_ptr<const string_t> &buffer, bool validate_utf8 = validate_utf8_by_default)
+            : index_(std::make_shared<shared_index>(buffer, validate_utf8))
+            , token_(0)
+        {
+            if (index_->index.size() == 0)
+                throw error("expected JSON value", buffer->size());
+            else if (index_->skip(0) < index_->index.size())
+                index_->fail("unexpected character after JSON value", index_->skip(0));
+            else if (!is_array() && !is_object() && !is_string())
+                scalar(); // A top-level number or literal extends to the end of the buffer, so decoding it checks what follows
+        }
+
+        type get_type() const
+        {
+            if (token_ == npos)
+                return null;
+
+            switch (index_->at(token_))
+            {
+                case '{': return object;
+                case '[': return array;
+                case '"': return string;
+                case 't': case 'f': return boolean;
+                case 'n': return null;
+                default: return scalar().get_type();
+            }
+        }
+
+        // Returns the number of elements or members, which are counted by walking the container
+        size_t size() const
+        {
+            size_t count = 0;
+            if (is_array() || is_object())
+                for (const_iterator it = begin(); it != end(); ++it)
+                    ++count;
+            return count;
+        }
+
+        bool_t is_null() const {return get_type() == null;}
+        bool_t is_bool() const {return token_ != npos && (index_->at(token_) == 't' || index_->at(token_) == 'f');}
+        bool_t is_int() const {return get_type() == integer;}
+        bool_t is_real() const {const type t = get_type(); return t == real || t == integer;}
+        bool_t is_string() const {return token_ != npos && index_->at(token_) == '"';}
+        bool_t is_array() const {return token_ != npos && index_->at(token_) == '[';}
+        bool_t is_object() const {return token_ != npos && index_->at(token_) == '{';}
+
+        bool_t get_bool() const {return scalar().get_bool();}
+        int_t get_int() const {return scalar().get_int();}
+        real_t get_real() const {return scalar().get_real();}
+        string_t get_string() const {return is_string()? index_->decode(token_): string_t();}
+
+        bool_t get_bool(bool_t default_) const {return scalar().get_bool(default_);}
+        int_t get_int(int_t default_) const {return scalar().get_int(default_);}
+        real_t get_real(real_t default_) const {return scalar().get_real(default_);}
+        string_t get_string(const string_t &default_) const {return is_string()? index_->decode(token_): default_;}
+
+        // Returns the member named `key`, or null if this is not an object or has no such member
+        lazy_value operator[](string_ref key) const
+        {
+            if (is_object())
+                for (uint32_t token = index_->first_child(token_); token != npos; token = index_->next_child(token, true))
+                    if (index_->equals(token, key))
+                        return lazy_value(index_, index_->value_of(token));
+
+            return lazy_value();
+        }
+        bool_t is_member(string_ref key) const {return !(*this)[key].is_missing();}
+
+        // Returns the element at `pos`, or null if this is not an array or has no such element
+        lazy_value operator[](size_t pos) const
+        {
+            if (is_array())
+                for (uint32_t token = index_->first_child(token_); token != npos; token = index_->next_child(token, false), --pos)
+                    if (pos == 0)
+                        return lazy_value(index_, token);
+
+            return lazy_value();
+        }
+
+        // Returns true if this refers to no value at all, such as a member that does not exist
+        bool_t is_missing() const {return token_ == npos;}
+
+        const_iterator begin() const {return is_array() || is_object()? const_iterator(index_, index_->first_child(token_), is_object()): end();}
+        const_iterator end() const {return const_iterator(index_, npos, false);}
+
+        // Builds this value, and everything it contains, as a json::value
+        value get() const
+        {
+            value v;
+            if (token_ == npos)
+                return v;
+
+            const char *begin, *end;
+            index_->range(token_, begin, end);
+
+            parser p(index_->buffer->data(), begin, end);
+            p.validate_utf8(index_->validate).parse(v);
+            if (!p.at_end())
+                throw error("unexpected character after JSON value", p.offset());
+            return v;
+        }
+
+        // Returns the byte offset of this value in the buffer, or error::npos if it is missing
+        size_t offset() const {return token_ == npos? error::npos: index_->index.positions()[token_];}
+
+    private:
+        lazy_value(const std::shared_ptr<const shared_index> &index, uint32_t token) : index_(index), token_(token) {}
+
+        // Decodes a number or literal, or returns null for any other value
+        value scalar() const
+        {
+            if (token_ == npos || is_array() || is_object() || is_string())
+                return value();
+            return get();
+        }
+
+        std::shared_ptr<const shared_index> index_;
+        uint32_t token_;
+    };
+
+    // Indexes a JSON buffer for lazy access
+    inline lazy_value from_json_lazy(const std::shared_ptr<const std::string> &json)
+    {
+        return lazy_value(json);
+    }
+
+    inline lazy_value from_json_lazy(std::string &&json)
+    {
+        return lazy_value(std::make_shared<const std::string>(std::move(json)));
+    }
+
+#ifdef JSON_PMR
+    // Parses a JSON buffer with the structural scanner, allocating all arrays and objects from `resource`
+    inline value from_json_indexed(const char *json, size_t length, memory_resource *resource)
+    {
+        value v(resource);
+        structural_index(json, length).parse(v);
+        return v;
+    }
+#endif
+}
+
+#endif // JSON_SCANNER_H